@@ -0,0 +1,162 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.0
+ *  File: BootAES.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds an AES-128 (FIPS 197) block encryption and the CTR mode (SP 800-38A) on top of it.
+ *
+ * v.1.0
+ * CTR only needs the forward cipher, so there is no decryption and no inverse S-box.
+ * Written for the M0+: no T-tables (4 kB of FLASH each), only the 256 byte S-box. The state is 4 column words, MixColumns works on a whole column at once with rotations and a multiply (single cycle on the L0).
+ * The round keys are expanded once per key, not per block.
+ *
+ */
+
+#include "BootAES.h"
+#include "string.h"
+
+static uint32_t AESSubWord(uint32_t word);
+
+static const uint8_t AES_Sbox[256] = {
+	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+	0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+	0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+	0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+	0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+	0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+	0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+	0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+	0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+	0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+	0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+	0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+//the state and the round keys are column words: byte 0 of the column in bits 0-7
+#define AES_ROR(x, n)				(((x) >> (n)) | ((x) << (32 - (n))))
+#define AES_XTIME(x)				((((x) & 0x7f7f7f7f) << 1) ^ ((((x) >> 7) & 0x01010101) * 0x1b))	//doubles the 4 bytes of a column in GF(2^8)
+#define AES_LOAD(p)					((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+
+//1)Key expansion
+static uint32_t AESSubWord(uint32_t word) {
+	return (uint32_t)AES_Sbox[word & 0xFF] | ((uint32_t)AES_Sbox[(word >> 8) & 0xFF] << 8)
+			| ((uint32_t)AES_Sbox[(word >> 16) & 0xFF] << 16) | ((uint32_t)AES_Sbox[word >> 24] << 24);
+}
+
+
+void AESKeyExpand(struct_AES_Ctx* ctx, const uint8_t* key) {
+	uint8_t rcon = 0x01;
+
+	for (uint8_t i = 0; i < 4; i++) {
+		ctx->round_key[i] = AES_LOAD(&key[4 * i]);
+	}
+	for (uint8_t i = 4; i < (4 * (AES_rounds + 1)); i++) {
+		uint32_t temp = ctx->round_key[i - 1];
+		if ((i & 3) == 0) {
+			temp = AESSubWord(AES_ROR(temp, 8)) ^ rcon;								//RotWord is a rotation by one byte in this packing
+			rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0);
+		} else {
+			//do nothing
+		}
+		ctx->round_key[i] = ctx->round_key[i - 4] ^ temp;
+	}
+}
+
+
+//2)One block
+void AESEncryptBlock(const struct_AES_Ctx* ctx, const uint8_t* in_block, uint8_t* out_block) {
+	/*
+	 * 1)AddRoundKey of round 0
+	 * 2)Rounds 1-9: SubBytes and ShiftRows in one go (byte r of column c comes from column c + r), MixColumns, AddRoundKey
+	 * 3)Round 10 has no MixColumns
+	 *
+	 * MixColumns of column a: b[i] = 2a[i] ^ 3a[i+1] ^ a[i+2] ^ a[i+3], which is xtime(a ^ ror8(a)) ^ ror8(a) ^ ror16(a) ^ ror24(a) on the column word.
+	 *
+	 * */
+
+	uint32_t s[4];
+	uint32_t t[4];
+	const uint32_t* rk = ctx->round_key;
+
+	//1)
+	for (uint8_t c = 0; c < 4; c++) {
+		s[c] = AES_LOAD(&in_block[4 * c]) ^ rk[c];
+	}
+
+	for (uint8_t round = 1; round <= AES_rounds; round++) {
+		rk += 4;
+
+		//2)
+		for (uint8_t c = 0; c < 4; c++) {
+			t[c] = (uint32_t)AES_Sbox[s[c] & 0xFF]
+					| ((uint32_t)AES_Sbox[(s[(c + 1) & 3] >> 8) & 0xFF] << 8)
+					| ((uint32_t)AES_Sbox[(s[(c + 2) & 3] >> 16) & 0xFF] << 16)
+					| ((uint32_t)AES_Sbox[s[(c + 3) & 3] >> 24] << 24);
+		}
+
+		//3)
+		if (round != AES_rounds) {
+			for (uint8_t c = 0; c < 4; c++) {
+				uint32_t r8 = AES_ROR(t[c], 8);
+				s[c] = AES_XTIME(t[c] ^ r8) ^ r8 ^ AES_ROR(t[c], 16) ^ AES_ROR(t[c], 24) ^ rk[c];
+			}
+		} else {
+			for (uint8_t c = 0; c < 4; c++) {
+				s[c] = t[c] ^ rk[c];
+			}
+		}
+	}
+
+	for (uint8_t c = 0; c < 4; c++) {
+		out_block[4 * c] = s[c];
+		out_block[(4 * c) + 1] = s[c] >> 8;
+		out_block[(4 * c) + 2] = s[c] >> 16;
+		out_block[(4 * c) + 3] = s[c] >> 24;
+	}
+}
+
+
+//3)CTR mode
+void AESCTRCrypt(const struct_AES_Ctx* ctx, const uint8_t* counter_block, uint32_t block_index, uint8_t* data_ptr, uint32_t data_len) {
+	/*
+	 * Encryption and decryption are the same: the data is XOR-ed with the encrypted counter blocks.
+	 * The counter of block n is the counter block with n added to its last 4 bytes (big endian, no carry into the first 12 bytes).
+	 * The caller gives the index of the first block, so any block aligned part of an image can be done on its own - a page, a resumed update.
+	 *
+	 * */
+
+	uint8_t counter[AES_block_size];
+	uint8_t key_stream[AES_block_size];
+
+	memcpy(counter, counter_block, AES_block_size - 4);
+	uint32_t counter_low = ((uint32_t)counter_block[12] << 24) | ((uint32_t)counter_block[13] << 16) | ((uint32_t)counter_block[14] << 8) | counter_block[15];
+	counter_low += block_index;
+
+	while (data_len != 0) {
+		counter[12] = counter_low >> 24;
+		counter[13] = counter_low >> 16;
+		counter[14] = counter_low >> 8;
+		counter[15] = counter_low;
+		AESEncryptBlock(ctx, counter, key_stream);
+		counter_low++;
+
+		uint8_t chunk_len = (data_len < AES_block_size) ? data_len : AES_block_size;
+		for (uint8_t i = 0; i < chunk_len; i++) {
+			data_ptr[i] ^= key_stream[i];
+		}
+		data_ptr += chunk_len;
+		data_len -= chunk_len;
+	}
+
+	memset(key_stream, 0, AES_block_size);											//no key stream left on the stack
+}
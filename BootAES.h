@@ -0,0 +1,37 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootAES.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Plain C, no registers touched: the host tools build the very same file for their known-answer test (see HostTools/BootCrypt.c).
+ */
+
+#ifndef INC_BOOTAES_H_
+#define INC_BOOTAES_H_
+
+#include "stdint.h"
+
+//LOCAL CONSTANT
+#define AES_block_size				16
+#define AES_key_size				16										//AES-128 only
+#define AES_rounds					10
+
+typedef struct {
+	uint32_t round_key[4 * (AES_rounds + 1)];								//expanded once per key - 176 bytes
+} struct_AES_Ctx;
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+
+//FUNCTION PROTOTYPES
+void AESKeyExpand(struct_AES_Ctx* ctx, const uint8_t* key);
+void AESEncryptBlock(const struct_AES_Ctx* ctx, const uint8_t* in_block, uint8_t* out_block);
+void AESCTRCrypt(const struct_AES_Ctx* ctx, const uint8_t* counter_block, uint32_t block_index, uint8_t* data_ptr, uint32_t data_len);
+
+#endif /* INC_BOOTAES_H_ */
@@ -3,7 +3,7 @@
  *  Author: BalazsFarkas
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
- *  Program version: 1.0
+ *  Program version: 1.11
  *  File: BootAppManager.c
  *  Modified from: N/A
  *  Change history:
@@ -13,6 +13,41 @@
  *v.1.0.
  *Below is a simple function to allow the bootloader to control/update/restart the app section.
  *
+ *v.1.1.
+ *A/B app slots. Updates go into the slot that is not running, the active slot is picked by a single word in data EEPROM.
+ *A new app is on trial until it confirms. If it does not confirm after a few boots, we roll back to the other slot.
+ *
+ *v.1.2.
+ *Update progress record in data EEPROM. An update sent with an image ID can be resumed from the last page that made it into the FLASH.
+ *
+ *v.1.3.
+ *Node address and group in data EEPROM for addressed commands on a shared bus.
+ *
+ *v.1.4.
+ *Page update times the erase and the half-page writes with TIM6 for the session statistics.
+ *
+ *v.1.5.
+ *Trace points on the page update, the erase, the half-page writes and the progress commit (boot_trace).
+ *
+ *v.1.6.
+ *Boot config record in data EEPROM: boot window, activation command, UART1 baud rate, app base and fast boot policy. The slots are set up from the app base.
+ *
+ *v.1.7.
+ *No fallback to the other slot with signed images (image_signed): it may hold an image that never got its tag.
+ *
+ *v.1.8.
+ *VTOR goes back to the FLASH before the jump (ram_update_path): the RAM copy of the vector table is overwritten by the app's variables.
+ *UpdatePageInApp stays in FLASH: it never runs while the FLASH is busy, the NVM routines only return once it is done.
+ *
+ *v.1.9.
+ *The page and half-page steps, the end of the FLASH and the stack pointer check come from the device traits (BootDeviceTraits_STM32L0xx.h) instead of L053 numbers.
+ *
+ *v.1.10.
+ *The log is drained and its DMA and IRQ are shut off before the jump (BootLogDeinit). Otherwise the app's vector table gets the log DMA IRQ.
+ *
+ *v.1.11.
+ *With signed images (image_signed), the app base can't be moved with 0xbc or by clearing the record. The slots would move onto FLASH that was never checked against a tag.
+ *
  */
 
 #include "BootAppManager.h"
@@ -35,20 +70,52 @@ void GoToApp(void)
 	uint32_t App_reset_vector_addr;																	//this is the address of the app's reset vector (which is also a function pointer!)
 	void (*Start_App_func_ptr)(void);																//the local function pointer we define
 
-	if((*(uint32_t*)App_Section_Start_Addr) == 0x20002000)											//we check, what is stored at the App_Section_Addr. It should be the very first word of the app's code.
+	uint32_t slot_record = ReadSlotRecord();
+	uint8_t boot_slot = slot_record & 0xF;
+
+	//trial boot counting and rollback
+	if (((slot_record >> 4) & 0xF) == Slot_State_Trial) {
+		uint8_t trial_boots = (slot_record >> 8) & 0xFF;
+		if (trial_boots >= Slot_Max_Trial_Boots) {													//the new app had its chances and never confirmed
+			BootLogError(LogTok_Slot_rollback, boot_slot, boot_slot ^ 1);
+			boot_slot ^= 1;
+			EEPROMUpd_Word(Slot_Record_Addr, (Slot_Record_Magic << 16) | (Slot_State_Confirmed << 4) | boot_slot);
+		} else {
+			EEPROMUpd_Word(Slot_Record_Addr, (slot_record & ~(0xFF << 8)) | ((uint32_t)(trial_boots + 1) << 8));
+		}
+	} else {
+		//do nothing
+	}
+
+#ifndef image_signed
+	if ((AppSlotValid(boot_slot) == No) && (AppSlotValid(boot_slot ^ 1) == Yes)) {					//we never jump into an empty or broken slot if the other one is fine
+		boot_slot ^= 1;
+	} else {
+		//do nothing
+	}
+#endif																								//with signed images, the other slot may hold an image that never got its tag - we only run what 0xbe has switched to
+
+	uint32_t App_Start_Addr = App_Slot_Start_Addr[boot_slot];
+
+	if(AppSlotValid(boot_slot) == Yes)																//we check, what is stored at the start of the slot. It should be the very first word of the app's code.
 																									//This value should be the reset value of the stack pointer in RAM.
-																									//Note: the exact value stored at the App_Section_Addr needs to be checked (it seems to be 0x20002000)
+																									//Note: the app's stack starts at the end of the RAM - Dev_RAM_end (0x20002000 on the L053)
 																									//Note: the memory monitor reads out the memory values upside-down! (there is an endian switch during the process)
 	{
-		printf("APP found. Starting...\r\n");
-		App_reset_vector_addr = *(uint32_t*)(App_Section_Start_Addr + 4);							//we define a pointer to APP_ADDR + 4 and then dereference it to extract the reset vector for the app
+		BootLogInfo(LogTok_App_found);
+		BootLogInfo(LogTok_Slot_booting, boot_slot, App_Start_Addr);
+		App_reset_vector_addr = *(uint32_t*)(App_Start_Addr + 4);									//we define a pointer to APP_ADDR + 4 and then dereference it to extract the reset vector for the app
 																									//JumpAddress will hold the reset vector address (which won't be the same as APP_ADDR + 4, the address is just stored there)
 		Start_App_func_ptr = App_reset_vector_addr;													//we call the local function pointer with the address of the app's reset vector
 																									//Note: for the bootloader, this address is an integer. In reality, it will be a function pointer once the app is placed.
-		__set_MSP(*(uint32_t*) App_Section_Start_Addr);												//we move the stack pointer to the APP address
+		BootLogDeinit();																			//no log after this point - the DMA and its IRQ are off
+#ifdef ram_update_path
+		SCB->VTOR = FLASH_BASE;																		//the RAM vector table of the bootloader is gone once the app starts - the app sets its own
+#endif
+		__set_MSP(*(uint32_t*) App_Start_Addr);														//we move the stack pointer to the APP address
 		Start_App_func_ptr();																		//here we call the APP reset function through the local function pointer
 	} else {
-		printf("No APP found. \r\n");
+		BootLogError(LogTok_No_app_found);
 	}
 
 }
@@ -69,19 +136,35 @@ void UpdatePageInApp (uint32_t page_addr_in_FLASH, uint8_t full_page_select_in_b
 	 * It is not possible to erase smaller section than 128 bytes.
 	 *
 	 * Note: the pointer must be properly manipulated to allow the right FLASH elements to be updated. Failing to do so will corrupt the app we intend to update.
+	 * Note: TIM6 runs on 1 MHz and wraps on 16 bits, which is plenty for a few ms of erase and write.
 	 *
 	 * */
 
+	 BootTraceEnter(TracePt_Page_update);
+	 uint16_t time_stamp = TIM6->CNT;
+	 BootTraceEnter(TracePt_FLASH_erase);
 	 FLASHErase_Page(page_addr_in_FLASH);
+	 BootTraceExit(TracePt_FLASH_erase);
+	 uint16_t erase_time = TIM6->CNT - time_stamp;
 	 //Note: we select the page, then we select the half-page within that page
 
-	 for(uint8_t half_page_select_in_buf = 0; half_page_select_in_buf < 2; half_page_select_in_buf++) {														//copying two half pages demand a loop of 2
+	 time_stamp = TIM6->CNT;
+
+	 for(uint8_t half_page_select_in_buf = 0; half_page_select_in_buf < Dev_half_pages_per_page; half_page_select_in_buf++) {								//copying two half pages demand a loop of 2
+		BootTraceEnter(TracePt_FLASH_half_page);													//Note: around the call - the RAM function itself must not call into the FLASH
 		FLASHUpd_HalfPage(page_addr_in_FLASH, full_page_select_in_buf, half_page_select_in_buf);	//unlike the word by word version where we passed the pointer value, we pass just the Rx_buffer position data - where we should read from it
-		page_addr_in_FLASH = page_addr_in_FLASH + 0x40;												//we increment the address value by half a page
+		BootTraceExit(TracePt_FLASH_half_page);
+		page_addr_in_FLASH = page_addr_in_FLASH + Dev_half_page_size;								//we increment the address value by half a page
 																									//or I can just pass addresses in there instead? well, no, not really since the data is not kept at a predefined address
 																									//After 32 steps, we have updated a full page worth of FLASH area.
 	 }
 
+	 uint16_t program_time = TIM6->CNT - time_stamp;
+	 Session_Stats.erase_time_total_us += erase_time;
+	 Session_Stats.program_time_total_us += program_time;
+	 if (erase_time > Session_Stats.erase_time_max_us) Session_Stats.erase_time_max_us = erase_time;
+	 if (program_time > Session_Stats.program_time_max_us) Session_Stats.program_time_max_us = program_time;
+	 BootTraceExit(TracePt_Page_update);
 }
 
 
@@ -98,10 +181,10 @@ void ReBoot(void)
 	uint32_t Boot_reset_vector_addr;																//this is the address of the app's reset vector (which is also a function pointer!)
 	void (*Start_Boot_func_ptr)(void);																//the local function pointer we define
 
-	if((*(uint32_t*)Boot_Section_Start_Addr) == 0x20002000)											//we check, what is stored at the Boot_Section_Addr. It should be the very first word of the app's code.
+	if((*(uint32_t*)Boot_Section_Start_Addr) == Dev_RAM_end)										//we check, what is stored at the Boot_Section_Addr. It should be the very first word of the app's code.
 																									//we do this check since we may run a device without a bootloader
 	{
-		printf("Rebooting...\r\n");
+		BootLogInfo(LogTok_Rebooting);
 		Boot_reset_vector_addr = *(uint32_t*)(Boot_Section_Start_Addr + 4);							//we define a pointer to APP_ADDR + 4 and then dereference it to extract the reset vector for the app
 																									//JumpAddress will hold the reset vector address (which won't be the same as APP_ADDR + 4, the address is just stored there)
 		Start_Boot_func_ptr = Boot_reset_vector_addr;													//we call the local function pointer with the address of the app's reset vector
@@ -109,7 +192,7 @@ void ReBoot(void)
 		__set_MSP(*(uint32_t*) Boot_Section_Start_Addr);												//we move the stack pointer to the APP address
 		Start_Boot_func_ptr();																		//here we call the APP reset function through the local function pointer
 	} else {
-		printf("Boot not found. \r\n");
+		BootLogError(LogTok_Boot_not_found);
 	}
 
 }
@@ -127,12 +210,374 @@ void ResetApp(void) {
 
 	void (*Start_App_func_ptr)(void);																//the local function pointer we define
 
-	printf("Resetting app...\r\n");
+	BootLogInfo(LogTok_Resetting_app);
+
+	uint32_t App_Start_Addr = App_Slot_Start_Addr[GetActiveSlot()];								//we reset the app in the slot we are running from
 
-	App_reset_vector_addr = *(uint32_t*)(App_Section_Start_Addr + 4);								//we define a pointer to APP_ADDR + 4 and then dereference it to extract the reset vector for the app
+	App_reset_vector_addr = *(uint32_t*)(App_Start_Addr + 4);										//we define a pointer to APP_ADDR + 4 and then dereference it to extract the reset vector for the app
 																									//JumpAddress will hold the reset vector address (which won't be the same as APP_ADDR + 4, the address is just stored there)
 	Start_App_func_ptr = App_reset_vector_addr;														//we call the local function pointer with the address of the app's reset vector
 																									//Note: for the bootloader, this address is an integer. In reality, it will be a function pointer once the app is placed.
-	__set_MSP(*(uint32_t*) App_Section_Start_Addr);													//we move the stack pointer to the APP address
+	__set_MSP(*(uint32_t*) App_Start_Addr);															//we move the stack pointer to the APP address
 	Start_App_func_ptr();																			//here we call the APP reset function through the local function pointer
 }
+
+
+
+//5) Slot record read
+/*
+ *	Reads the slot record from data EEPROM. If the record is not valid (erased EEPROM, never used), we return a confirmed slot A.
+ *
+ * */
+
+uint32_t ReadSlotRecord(void) {
+	uint32_t slot_record = *(__IO uint32_t*)Slot_Record_Addr;
+
+	if (((slot_record >> 16) != Slot_Record_Magic) || ((slot_record & 0xF) > 1)) {
+		slot_record = (Slot_Record_Magic << 16) | (Slot_State_Confirmed << 4) | 0;
+	} else {
+		//do nothing
+	}
+
+	return slot_record;
+}
+
+
+//6) Active and update slot
+/*
+ *	The active slot is the one we boot. The update slot is the other one: updates never touch the app we are running.
+ *
+ * */
+
+uint8_t GetActiveSlot(void) {
+	return ReadSlotRecord() & 0xF;
+}
+
+uint8_t GetUpdateSlot(void) {
+	return GetActiveSlot() ^ 1;
+}
+
+
+//7) Slot validity check
+/*
+ *	Same check as we always did before jumping: the first word of the app must be the reset value of the stack pointer.
+ *
+ * */
+
+enum_Yes_No_Selector AppSlotValid(uint8_t slot) {
+	if ((*(uint32_t*)App_Slot_Start_Addr[slot & 1]) == Dev_RAM_end) {
+		return Yes;
+	} else {
+		return No;
+	}
+}
+
+
+//8) Slot switch
+/*
+ *	We make the freshly written slot the active one. It starts on trial with a boot counter of 0.
+ *	This is a single word write into data EEPROM. A reset before it leaves the old slot active, a reset after it boots the new one.
+ *
+ * */
+
+void SwitchAppSlot(uint8_t new_active_slot) {
+	EEPROMUpd_Word(Slot_Record_Addr, (Slot_Record_Magic << 16) | (Slot_State_Trial << 4) | (new_active_slot & 1));
+	BootLogInfo(LogTok_Slot_switched, new_active_slot & 1);
+}
+
+
+//9) Slot confirm
+/*
+ *	The app in the active slot is confirmed: no more trial boots, no rollback.
+ *	The app itself may do the same by writing the record word ((0xB007 << 16) | active slot) into the data EEPROM.
+ *
+ * */
+
+void ConfirmAppSlot(void) {
+	uint8_t active_slot = GetActiveSlot();
+	EEPROMUpd_Word(Slot_Record_Addr, (Slot_Record_Magic << 16) | (Slot_State_Confirmed << 4) | active_slot);
+	BootLogInfo(LogTok_Slot_confirmed, active_slot);
+}
+
+
+//10) Update progress start or resume
+/*
+ *	Called when the host announces an image (ID and size). Returns the offset from which the host must send the image.
+ *
+ *	1)Check if the record in EEPROM is for the same image and the same slot
+ *	2)Check the CRC of what is already in the slot against the record. If the last commit was cut, the CRC matches one page earlier.
+ *	3)If anything does not match, we start the image from scratch with a fresh record
+ *
+ *	Note: the magic word is written last, so a half-written fresh record is not valid.
+ *
+ * */
+
+uint32_t StartUpdateProgress(uint32_t image_id, uint32_t image_size) {
+	uint8_t update_slot = GetUpdateSlot();
+	uint32_t slot_start_addr = App_Slot_Start_Addr[update_slot];
+	uint32_t progress_record = *(__IO uint32_t*)Update_Progress_Addr;
+	uint32_t next_offset = *(__IO uint32_t*)Update_Next_Offset_Addr;
+	uint32_t stored_crc = *(__IO uint32_t*)Update_CRC_Addr;
+
+	//1)
+	if ((progress_record == ((Update_Progress_Magic << 16) | update_slot))
+			&& (*(__IO uint32_t*)Update_Image_ID_Addr == image_id)
+			&& (*(__IO uint32_t*)Update_Image_Size_Addr == image_size)
+			&& (next_offset <= App_Slot_Size)
+			&& ((next_offset % Update_Page_Size) == 0)) {
+
+		//2)
+		if (next_offset == 0) {
+			if (stored_crc == CRC_seed) return 0;
+		} else {
+			uint32_t previous_crc = BootCRCCalc(CRC_seed, (uint32_t*)slot_start_addr, (next_offset - Update_Page_Size) / 4);
+			uint32_t current_crc = BootCRCCalc(previous_crc, (uint32_t*)(slot_start_addr + next_offset - Update_Page_Size), Update_Page_Size / 4);
+
+			if (current_crc == stored_crc) {
+				BootLogInfo(LogTok_Update_resumed, image_id, next_offset);
+				return next_offset;
+			} else if (previous_crc == stored_crc) {								//power was lost between the offset and the CRC writes
+				next_offset = next_offset - Update_Page_Size;
+				EEPROMUpd_Word(Update_Next_Offset_Addr, next_offset);
+				BootLogInfo(LogTok_Update_resumed, image_id, next_offset);
+				return next_offset;
+			} else {
+				//do nothing
+			}
+		}
+	} else {
+		//do nothing
+	}
+
+	//3)
+	EEPROMUpd_Word(Update_Progress_Addr, 0);
+	EEPROMUpd_Word(Update_Image_ID_Addr, image_id);
+	EEPROMUpd_Word(Update_Image_Size_Addr, image_size);
+	EEPROMUpd_Word(Update_Next_Offset_Addr, 0);
+	EEPROMUpd_Word(Update_CRC_Addr, CRC_seed);
+	EEPROMUpd_Word(Update_Progress_Addr, (Update_Progress_Magic << 16) | update_slot);
+
+	return 0;
+}
+
+
+//11) Update progress commit
+/*
+ *	Called once a page has been written into the FLASH. We add the page to the CRC and move the offset on.
+ *
+ *	Note: two EEPROM word writes per page. These go on top of the FLASH write, so they must fit in the time it takes to receive the next page.
+ *
+ * */
+
+void CommitUpdateProgress(uint32_t committed_page_addr) {
+	BootTraceEnter(TracePt_Progress_commit);
+	uint32_t updated_crc = BootCRCCalc(*(__IO uint32_t*)Update_CRC_Addr, (uint32_t*)committed_page_addr, Update_Page_Size / 4);
+	EEPROMUpd_Word(Update_Next_Offset_Addr, committed_page_addr + Update_Page_Size - App_Slot_Start_Addr[GetUpdateSlot()]);
+	EEPROMUpd_Word(Update_CRC_Addr, updated_crc);
+	BootTraceExit(TracePt_Progress_commit);
+}
+
+
+//12) Update progress clear
+/*
+ *	The image is complete (or a plain, non-resumable update started). The record is not valid anymore.
+ *
+ * */
+
+void ClearUpdateProgress(void) {
+	if (*(__IO uint32_t*)Update_Progress_Addr != 0) {
+		EEPROMUpd_Word(Update_Progress_Addr, 0);
+	} else {
+		//do nothing
+	}
+}
+
+
+//13) Node address
+/*
+ *	Node address and group of this device. Erased EEPROM means address 0, group 0.
+ *
+ * */
+
+uint32_t ReadNodeRecord(void) {
+	uint32_t node_record = *(__IO uint32_t*)Node_Record_Addr;
+
+	if ((node_record >> 16) != Node_Record_Magic) {
+		node_record = (Node_Record_Magic << 16);
+	} else {
+		//do nothing
+	}
+
+	return node_record;
+}
+
+void SetNodeRecord(uint8_t node_addr, uint8_t node_group) {
+	EEPROMUpd_Word(Node_Record_Addr, (Node_Record_Magic << 16) | (node_group << 8) | node_addr);
+}
+
+
+//14) Boot config
+/*
+ *	The boot config record holds what used to be compiled in: the boot window, the activation command, the UART1 baud rate and the app base. Plus the fast boot policy.
+ *	Without a valid record (erased EEPROM, other version, broken CRC, values we can't use), we run on the compiled defaults.
+ *
+ *	1)Start from the defaults
+ *	2)Check the header and the CRC of the record, then the values themselves - the app may write the record too
+ *
+ * */
+
+enum_Yes_No_Selector ReadBootConfig(struct_Boot_Config* config) {
+	struct_Boot_Config stored_config;
+	uint32_t config_header = *(__IO uint32_t*)Boot_Config_Addr;
+
+	//1)
+	config->boot_window_sec = Boot_Config_Default_Window_sec;
+	config->activation_cmd = Boot_Config_Default_Activation;
+	config->fast_boot_policy = Boot_Fast_Off;
+	config->reserved = 0;
+	config->baud_rate = Boot_Config_Default_Baud;
+	config->app_base_addr = App_Section_Start_Addr;
+
+	//2)
+	if (config_header != ((Boot_Config_Magic << 16) | (Boot_Config_Version << 8))) return No;
+	if (BootCRCCalc(CRC_seed, (uint32_t*)Boot_Config_Addr, 4) != *(__IO uint32_t*)(Boot_Config_Addr + 16)) return No;
+	memcpy(&stored_config, (uint8_t*)(Boot_Config_Addr + 4), sizeof(stored_config));
+	if (BootConfigValid(&stored_config) == No) return No;
+
+	*config = stored_config;
+	return Yes;
+}
+
+
+/*
+ *	Called once after reset, before the drivers are set up: the UART1 needs the baud rate, the slots need the app base.
+ *	Slot B starts halfway between the app base and the end of the FLASH.
+ *
+ *	Note: needs the CRC unit. The log is not running yet, so main.c logs the outcome.
+ *
+ * */
+
+enum_Yes_No_Selector LoadBootConfig(void) {
+	enum_Yes_No_Selector config_stored = ReadBootConfig(&Boot_Config);
+
+	App_Slot_Size = (App_Section_End_Addr - Boot_Config.app_base_addr) / 2;
+	App_Slot_Start_Addr[0] = Boot_Config.app_base_addr;
+	App_Slot_Start_Addr[1] = Boot_Config.app_base_addr + App_Slot_Size;
+
+	return config_stored;
+}
+
+
+/*
+ *	1)Boot window: at least one TIM2 IRQ, at most a minute
+ *	2)Activation command: not the start byte or the addressed frame byte, otherwise the activation could never be told apart from the framing
+ *	3)Fast boot policy: one we know
+ *	4)Baud rate: same check as for 0xbd
+ *	5)App base: within the app section, aligned, and room for two slots
+ *
+ *	Note: we don't check if the activation command is one of the other commands. In the boot window only the activation is taken, but the host should still avoid that.
+ *
+ * */
+
+enum_Yes_No_Selector BootConfigValid(const struct_Boot_Config* config) {
+	//1)
+	if ((config->boot_window_sec == 0) || (config->boot_window_sec > Boot_Window_Max_sec)) return No;
+
+	//2)
+	if ((config->activation_cmd == UART_message_start_byte) || (config->activation_cmd == 0xAD) || (config->activation_cmd == 0x00)) return No;
+
+	//3)
+	if (config->fast_boot_policy > Boot_Fast_Power_On) return No;
+
+	//4)
+	if (UART1BaudValid(config->baud_rate) == No) return No;
+
+	//5)
+	if ((config->app_base_addr < App_Section_Start_Addr) || (config->app_base_addr >= App_Section_End_Addr)
+			|| ((config->app_base_addr % App_Base_Align) != 0)
+			|| ((App_Section_End_Addr - config->app_base_addr) < (2 * App_Slot_Min_Size))) return No;
+
+	return Yes;
+}
+
+
+/*
+ *	1)Check the values
+ *	2)Write the header and the config words, then the CRC. A reset before the CRC is in leaves a broken record: we boot on the defaults then.
+ *	3)A new app base moves the slots, so an update in progress can't be resumed into them
+ *
+ *	Note: the new config is used from the next reset. Until then, we keep running on the old one.
+ *	Note: with signed images, a new app base is refused. The slots would be recomputed over whatever is in the FLASH there, and GoToApp trusts the active slot without a tag check.
+ *
+ * */
+
+enum_Yes_No_Selector SetBootConfig(const struct_Boot_Config* new_config) {
+	uint32_t config_words[4];
+
+	//1)
+	if (BootConfigValid(new_config) == No) return No;
+#ifdef image_signed
+	if (new_config->app_base_addr != Boot_Config.app_base_addr) return No;
+#endif
+
+	//2)
+	config_words[0] = (Boot_Config_Magic << 16) | (Boot_Config_Version << 8);
+	memcpy(&config_words[1], new_config, sizeof(struct_Boot_Config));
+	for (uint8_t i = 0; i < 4; i++) {
+		EEPROMUpd_Word(Boot_Config_Addr + (4 * i), config_words[i]);
+	}
+	EEPROMUpd_Word(Boot_Config_Addr + 16, BootCRCCalc(CRC_seed, config_words, 4));
+
+	//3)
+	if (new_config->app_base_addr != Boot_Config.app_base_addr) {
+		ClearUpdateProgress();
+	} else {
+		//do nothing
+	}
+
+	return Yes;
+}
+
+enum_Yes_No_Selector ClearBootConfig(void) {
+#ifdef image_signed
+	if (Boot_Config.app_base_addr != App_Section_Start_Addr) return No;			//the defaults would move the app base - same as in SetBootConfig
+#endif
+
+	EEPROMUpd_Word(Boot_Config_Addr, 0);											//no valid header: defaults from the next reset
+
+	if (Boot_Config.app_base_addr != App_Section_Start_Addr) {
+		ClearUpdateProgress();
+	} else {
+		//do nothing
+	}
+
+	return Yes;
+}
+
+
+//15) Fast boot
+/*
+ *	Decides if we skip the boot window. Only with the Boot_Fast_Power_On policy, only after a power-on reset and only if the active app is confirmed and valid.
+ *	Any other reset - pin, software (the app asking for the bootloader), watchdog - gets the boot window as before. So does an app on trial or a paused update.
+ *
+ *	Note: we clear the reset flags (RMVF), otherwise the power-on flag would stick until the next power cycle. With this policy, the app does not see the reset flags.
+ *
+ * */
+
+enum_Yes_No_Selector FastBootAllowed(void) {
+	uint32_t reset_flags = RCC->CSR;
+	uint32_t slot_record = ReadSlotRecord();
+
+	if (Boot_Config.fast_boot_policy != Boot_Fast_Power_On) return No;
+
+	RCC->CSR |= (1<<23);																		//RMVF
+
+	if (((reset_flags & (1<<27)) == (1<<27))													//PORRSTF - brown-out resets end up here too
+			&& (((slot_record >> 4) & 0xF) == Slot_State_Confirmed)
+			&& (AppSlotValid(slot_record & 0xF) == Yes)
+			&& (*(__IO uint32_t*)Update_Progress_Addr == 0)) {
+		return Yes;
+	} else {
+		return No;
+	}
+}
@@ -16,23 +16,100 @@
 #include "main.h"
 #include "stdint.h"
 #include "stdio.h"
+#include "string.h"
+#include "BootLogTokens.h"
+#include "BootCRCDriver_STM32L0x3.h"
+#include "BootTrace.h"
+#include "BootUARTDriver_STM32L0x3.h"
+#include "BootLogDriver_STM32L0x3.h"
 
 
 
 //LOCAL CONSTANT
-static const uint32_t App_Section_Start_Addr = 0x8008000;					//this is the app section's address. It is defined in the linker files.
+static const uint32_t App_Section_Start_Addr = 0x8008000;					//this is the app section's address. It is defined in the linker files. The app may start higher (boot config), never lower.
 static const uint32_t Boot_Section_Start_Addr = 0x8000000;					//this is the boot section's address. It is defined in the boot's linker file.
+static const uint32_t App_Section_End_Addr = Dev_FLASH_end;					//end of the FLASH - the app section is everything between its start and here
+
+//A/B app slots
+//Note: each slot needs its own app build - the linker file of the app must place it at the slot's address (and SystemInit must set VTOR to it)
+//Note: the slots are set up from the app base in the boot config (see LoadBootConfig) - 16 kB each at 0x8008000 and 0x800C000 by default
+static const uint32_t App_Slot_Min_Size = 0x800;							//2 kB - a smaller slot is more likely a typo than an app
+static const uint32_t App_Base_Align = 0x200;								//slot B is then on a 256 byte boundary, which VTOR needs
+
+//slot record in data EEPROM
+//[31:16] magic, [15:8] trial boot counter, [7:4] state, [3:0] active slot
+//Note: erased EEPROM reads 0, which is no valid record - we boot slot A in that case, same as before slots existed
+static const uint32_t Slot_Record_Addr = 0x08080000;						//first word of the data EEPROM
+static const uint32_t Slot_Record_Magic = 0xB007;
+static const uint8_t Slot_State_Confirmed = 0x0;							//the app in the active slot has confirmed that it runs
+static const uint8_t Slot_State_Trial = 0x1;								//the app in the active slot is new and has not confirmed yet
+static const uint8_t Slot_Max_Trial_Boots = 3;								//we roll back if the new app did not confirm after this many boots
+
+//node address record in data EEPROM
+//[31:16] magic, [15:8] group, [7:0] node address
+//Note: without a valid record, the node is address 0 in group 0
+static const uint32_t Node_Record_Addr = 0x08080010;
+static const uint32_t Node_Record_Magic = 0xB0AD;
+
+//update progress record in data EEPROM
+//[31:16] magic, [3:0] the slot being written - followed by the image ID, the image size, the next offset to write and the CRC of everything before that offset
+//Note: the next offset is always written before the CRC. If we lose power in between, the CRC is one page behind and we simply take the page again.
+static const uint32_t Update_Progress_Addr = 0x08080020;
+static const uint32_t Update_Image_ID_Addr = 0x08080024;
+static const uint32_t Update_Image_Size_Addr = 0x08080028;
+static const uint32_t Update_Next_Offset_Addr = 0x0808002C;
+static const uint32_t Update_CRC_Addr = 0x08080030;
+static const uint32_t Update_Progress_Magic = 0xB0C0;
+static const uint32_t Update_Page_Size = Dev_page_size;						//one page of FLASH - the smallest step of an update
+
+//boot config record in data EEPROM
+//[31:16] magic, [15:8] version - followed by the struct_Boot_Config (3 words) and the CRC of the four words before it
+//Note: without a valid record (erased, old version, broken CRC), we run on the compiled defaults below
+static const uint32_t Boot_Config_Addr = 0x08080040;
+static const uint32_t Boot_Config_Magic = 0xB0CF;
+static const uint8_t Boot_Config_Version = 1;								//bump this if struct_Boot_Config changes
+static const uint8_t Boot_Config_Default_Window_sec = 5;					//defines how many TIM2 IRQs we wait before leaving the bootloader
+static const uint8_t Boot_Config_Default_Activation = 0xc3;
+static const uint32_t Boot_Config_Default_Baud = 57600;					//BRR 0x116 on 16 MHz
+static const uint8_t Boot_Window_Max_sec = 60;
+static const uint8_t Boot_Config_Read = 0x00;								//boot window of a 0xbc payload: no change, only the reply
+static const uint8_t Boot_Config_Clear = 0xFF;								//boot window of a 0xbc payload: back to the defaults
+
+//fast boot policy
+static const uint8_t Boot_Fast_Off = 0;										//we always wait the boot window
+static const uint8_t Boot_Fast_Power_On = 1;								//no boot window after a power-on reset if the active app is confirmed
 
 //LOCAL VARIABLE
 
 
 //EXTERNAL VARIABLE
-extern uint32_t Rx_Message_buf [64];
+extern uint32_t Rx_Message_buf [Dev_Rx_buf_words];
+extern struct_Session_Stats Session_Stats;
+extern struct_Boot_Config Boot_Config;
+extern uint32_t App_Slot_Start_Addr[2];
+extern uint32_t App_Slot_Size;
 
 //FUNCTION PROTOTYPES
 void GoToApp(void);
 void UpdatePageInApp (uint32_t loc_var_current_flash_page_addr, uint8_t current_data_page_select);
 void ReBoot(void);
 void ResetApp(void);
+uint32_t ReadSlotRecord(void);
+uint8_t GetActiveSlot(void);
+uint8_t GetUpdateSlot(void);
+enum_Yes_No_Selector AppSlotValid(uint8_t slot);
+void SwitchAppSlot(uint8_t new_active_slot);
+void ConfirmAppSlot(void);
+uint32_t StartUpdateProgress(uint32_t image_id, uint32_t image_size);
+void CommitUpdateProgress(uint32_t committed_page_addr);
+void ClearUpdateProgress(void);
+uint32_t ReadNodeRecord(void);
+void SetNodeRecord(uint8_t node_addr, uint8_t node_group);
+enum_Yes_No_Selector ReadBootConfig(struct_Boot_Config* config);
+enum_Yes_No_Selector LoadBootConfig(void);
+enum_Yes_No_Selector BootConfigValid(const struct_Boot_Config* config);
+enum_Yes_No_Selector SetBootConfig(const struct_Boot_Config* new_config);
+enum_Yes_No_Selector ClearBootConfig(void);
+enum_Yes_No_Selector FastBootAllowed(void);
 
 #endif /* INC_APPMANAGER_CUSTOM_H_ */
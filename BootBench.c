@@ -0,0 +1,60 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.0
+ *  File: BootBench.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds the benchmark frame of the bootloader.
+ *
+ * v.1.0
+ * Taken out of BootImageAuth.c and BootImageCrypt.c, where the hash (0xb4) and the decryption (0xb2) benchmarks each had their own copy of it.
+ * A benchmark runs on the clock profile of the programming and replies with the time in us (LE32), the core clock in Hz (LE32), then whatever result the work gives back.
+ *
+ * Note: the M0+ has no cycle counter, the time comes from TIM6 (1 us). The host gets the cycles per byte from the time and the clock.
+ *
+ */
+
+#include "BootBench.h"
+
+#if defined(image_signed) || defined(image_encrypted)
+
+#include "stm32l0xx.h"
+#include "string.h"
+#include "BootLink.h"
+#include "BootClockDriver_STM32L0x3.h"
+
+
+//1)Timed run of a benchmark
+void BootBenchRun(uint8_t bench_cmd, const uint8_t* bench_payload, uint8_t (*bench_work)(uint16_t bench_len, uint8_t* result_ptr)) {
+	/*
+	 * 1)Number of bytes from the payload (LE16), capped at Bench_max_bytes
+	 * 2)Work timed on the PLL
+	 * 3)Reply: time, clock, result of the work
+	 *
+	 * */
+
+	uint16_t bench_len;
+	uint8_t bench_reply[8 + Bench_result_max];
+
+	//1)
+	memcpy(&bench_len, bench_payload, 2);
+	if (bench_len > Bench_max_bytes) bench_len = Bench_max_bytes;
+
+	//2)
+	SysClockProfile(Clock_Profile_PLL);													//we time it on the clock of the programming
+	uint16_t start_time = TIM6->CNT;
+	uint8_t result_len = bench_work(bench_len, &bench_reply[8]);
+	uint32_t bench_time_us = (uint16_t) (TIM6->CNT - start_time);
+
+	//3)
+	memcpy(&bench_reply[0], &bench_time_us, 4);
+	memcpy(&bench_reply[4], (uint32_t*)&SystemCoreClock, 4);
+	BootLinkTxReply(bench_cmd, bench_reply, 8 + result_len);
+	SysClockProfile(Clock_Profile_MSI);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootBench.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Benchmark frame of the bootloader (0xb4 with image_signed, 0xb2 with image_encrypted).
+ *
+ * The module being timed only gives the work. Clock profile, timing and the reply are done here, the same way for every benchmark.
+ * Without "image_signed" or "image_encrypted", nothing here is compiled.
+ */
+
+#ifndef INC_BOOTBENCH_H_
+#define INC_BOOTBENCH_H_
+
+#include "stdint.h"
+#include "main.h"
+
+//LOCAL CONSTANT
+#define Bench_max_bytes				4096									//TIM6 wraps after 65 ms - this is well within that on the PLL
+#define Bench_result_max			32										//the longest result a benchmark sends back (SHA-256 digest)
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+
+//FUNCTION PROTOTYPES
+#if defined(image_signed) || defined(image_encrypted)
+void BootBenchRun(uint8_t bench_cmd, const uint8_t* bench_payload, uint8_t (*bench_work)(uint16_t bench_len, uint8_t* result_ptr));
+#endif
+
+#endif /* INC_BOOTBENCH_H_ */
@@ -0,0 +1,62 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.0
+ *  File: BootCRCDriver_STM32L0x3.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds the driver for the CRC calculation unit.
+ *
+ * v.1.0
+ * CRC unit in its reset configuration: polynomial 0x04C11DB7, 32-bit words in, no bit reversal, no final XOR (CRC-32/MPEG-2).
+ * The words are fed as they are in memory, so the unit sees the bytes of a word in the order [3][2][1][0]. The host tools do the same.
+ * The start value can be set, so a CRC can be continued later from the result of an earlier calculation.
+ *
+ */
+
+#include "BootCRCDriver_STM32L0x3.h"
+
+//1)CRC unit init
+void BootCRCInit(void) {
+	/*
+	 * 1)Enable clocking
+	 * 2)Reset configuration: 32-bit polynomial, no reversal on input or output
+	 *
+	 * */
+
+	//1)
+	RCC->AHBENR |= (1<<12);																//CRCEN - the CRC unit is on the AHB
+
+	//2)
+	CRC->CR = 0x0;																		//POLYSIZE is 32 bits, REV_IN and REV_OUT are off
+	CRC->POL = 0x04C11DB7;																//reset value, written anyway
+}
+
+
+//2)CRC calculation over a block of words
+uint32_t BootCRCCalc(uint32_t crc_start_value, const uint32_t* crc_data_ptr, uint32_t crc_word_cnt) {
+	/*
+	 * 1)Load the start value and reset the unit with it
+	 * 2)Feed the words - the AHB stalls the write until the unit is ready, there is no flag to wait for
+	 * 3)Read out the result
+	 *
+	 * Note: to continue a CRC, pass the result of the previous call as start value. CRC_seed starts a new one.
+	 * Note: not re-entrant. Only the main loop calculates CRCs.
+	 *
+	 * */
+
+	//1)
+	CRC->INIT = crc_start_value;
+	CRC->CR |= (1<<0);																	//RESET - DR is loaded with INIT
+
+	//2)
+	for (uint32_t i = 0; i < crc_word_cnt; i++) {
+		CRC->DR = crc_data_ptr[i];
+	}
+
+	//3)
+	return CRC->DR;
+}
@@ -0,0 +1,30 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootCRCDriver_STM32L0x3.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ */
+
+#ifndef INC_BOOTCRCDRIVER_CUSTOM_H_
+#define INC_BOOTCRCDRIVER_CUSTOM_H_
+
+#include "main.h"
+#include "stdint.h"
+
+
+//LOCAL CONSTANT
+#define CRC_seed				0xFFFFFFFF											//starting value of every CRC we calculate
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+
+//FUNCTION PROTOTYPES
+void BootCRCInit(void);
+uint32_t BootCRCCalc(uint32_t crc_start_value, const uint32_t* crc_data_ptr, uint32_t crc_word_cnt);
+
+#endif /* INC_BOOTCRCDRIVER_CUSTOM_H_ */
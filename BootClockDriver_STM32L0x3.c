@@ -3,7 +3,7 @@
  *  Author: BalazsFarkas
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
- *  Program version: 1.0
+ *  Program version: 1.5
  *  File: BootClockDriver_STM32L0x3.c
  *  Modified from: STM32_ClockDriver/ClockDriver_STM32L0x3.c
  *  Change history:
@@ -18,10 +18,33 @@
  * Note: for simple bootloader action, only TIM6 and TIM2 (as a timer) are used only.
  * Note: TIM2 PWM is currently not planed for the bootloader. If this is to change, boot_TIM2 should be merged with TIM22.
  *
+ * v.1.1
+ * Added LPTIM1 on LSI to count seconds while in Stop mode.
+ * Added Stop mode entry that restores the system clock upon wake-up.
+ * PWR interface is clocked and taken out of reset in the clock config. Stop mode and the voltage scaling need it.
+ *
+ * v.1.2
+ * Added clock profiles (MSI, HSI16, PLL) that can be switched on the fly.
+ * The switch keeps the FLASH wait states, the TIM2/TIM6 prescalers and the UART baud rates matched to the new clocks.
+ *
+ * v.1.3
+ * TIM22 is back as the IRQ latency probe (irq_latency_probe). It only runs during programming, on the PLL.
+ *
+ * v.1.4
+ * The register definitions come from the family header (stm32l0xx.h) instead of the L053 one. The clock tree is the same on the category 3 and 5 parts.
+ *
+ * v.1.5
+ * The log is sent out before the clocks are switched, not after. What was still in the UART2 went out with the old BRR on the new PCLK1.
+ *
  */
 
 #include "BootClockDriver_STM32L0x3.h"
-#include "stm32l053xx.h"														//device specific header file for registers
+#include "stm32l0xx.h"														//device specific header file for registers
+#include "BootUARTDriver_STM32L0x3.h"
+#include "BootLogDriver_STM32L0x3.h"
+
+static uint32_t PCLK1_freq = 8000000;												//APB1 clock - TIM2, TIM6 and UART2 are on it
+static uint32_t PCLK2_freq = 16000000;												//APB2 clock - UART1 is on it
 
 //1)We set up the core clock and the peripheral prescalers/dividers
 void SysClockConfig(void) {
@@ -45,6 +68,8 @@ void SysClockConfig(void) {
 	//2)
 	//power control enabled, put to reset value
 	RCC->APB1RSTR |= (1<<28);													//reset PWR interface
+	RCC->APB1RSTR &= ~(1<<28);													//release the reset
+	RCC->APB1ENR |= (1<<28);													//clock the PWR interface
 	PWR->CR |= (1<<11);															//we put scale1 - 1.8V - becasue that is what CubeMx sets originally (should be the reset value here)
 	while ((PWR->CSR & (1<<4)));												//and wait until it becomes stable. Bit 4 should be 0.
 
@@ -89,6 +114,10 @@ void SysClockConfig(void) {
 	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);						//system clock status (set by hardware in bits [3:2]) should be matching the PLL source status set in bits [1:0]
 
 	SystemCoreClockUpdate();													//This CMSIS function must be called to update the system clock! If not done, we will remain in the original clocking (likely MSI).
+
+	Current_Clock_Profile = Clock_Profile_PLL;
+	PCLK1_freq = 8000000;
+	PCLK2_freq = 16000000;
 }
 
 //2) TIM6 setup for precise delay generation (removal of HAL_Delay)
@@ -176,3 +205,236 @@ void BootTIM2_DEINT (void) {
 	NVIC_DisableIRQ(TIM2_IRQn);													//we disable the TIM2 IRQ
 	TIM2->SR &= ~(1<<0);														//we clear the TIM2 IRQ trigger flag
 }
+
+
+//7) LPTIM1 setup for a timer trigger at every second - also running in Stop mode
+void BootLPTIM1_INT (void) {
+	/**
+	 * LPTIM1 is clocked from LSI so it keeps on counting when the mcu is in Stop mode. TIM2 stops with the APB clock.
+	 * The IRQ goes through EXTI line 29, which wakes up the mcu.
+	 *
+	 * 1)Enable LSI and wait until it becomes stable
+	 * 2)Clock LPTIM1 from LSI, set the prescaler
+	 * 3)Enable the timer, set ARR and start counting continuously
+	 *
+	 **/
+
+	//1)
+	RCC->CSR |= (1<<0);															//LSI on
+	while (!(RCC->CSR & (1<<1)));												//and wait until it becomes stable
+
+	//2)
+	RCC->CCIPR &= ~(3<<18);
+	RCC->CCIPR |= (1<<18);														//LPTIM1 clock is LSI
+	RCC->APB1ENR |= (1<<31);													//enable LPTIM1 clocking
+	LPTIM1->CFGR |= (7<<9);														//prescaler is 128
+																				//Note: CFGR can only be written while LPTIM1 is disabled
+	LPTIM1->IER |= (1<<1);														//ARR match interrupt enabled
+	EXTI->IMR |= (1<<29);														//LPTIM1 wake-up line (on by default after reset)
+
+	//3)
+	LPTIM1->CR |= (1<<0);														//enable LPTIM1
+	LPTIM1->ARR = LPTIM1_timer_interrupt;										//Note: ARR can only be written while LPTIM1 is enabled
+	LPTIM1->CR |= (1<<2);														//start in continuous mode
+}
+
+
+//8) LPTIM1 full deinit function
+void BootLPTIM1_DEINT (void) {
+	LPTIM1->CR &= ~(1<<0);														//we shut off the LPTIM1 timer
+	NVIC_DisableIRQ(LPTIM1_IRQn);												//we disable the LPTIM1 IRQ
+	LPTIM1->ICR |= (1<<1);														//we clear the ARR match flag
+}
+
+
+//9) Stop mode
+void BootStopMode (void) {
+	/**
+	 * We put the mcu into Stop mode. We return once an IRQ woke it up, running on HSI16.
+	 * Must be called with the IRQs disabled (__disable_irq). The pending IRQ is executed when the caller re-enables the IRQs.
+	 * It is up to the caller to go back to the PLL (SysClockConfig) if it needs to. We don't do it here since the PLL lock takes longer than a byte at high baud rate.
+	 *
+	 * 1)Set up Stop mode: regulator in low power, Vrefint off, fast wake-up, wake up on HSI16
+	 * 2)Enter Stop mode
+	 * 3)Back to normal sleep
+	 *
+	 * Note: the PLL is switched off by hardware in Stop mode. The prescalers and the FLASH latency are kept.
+	 * Note: wake-up from Stop on HSI16 takes a few microseconds. The USART1 and the UART2 run on HSI16 as kernel clock in this mode, so they don't care about the system clock.
+	 *
+	 **/
+
+	//1)
+	PWR->CR &= ~(1<<1);															//PDDS is 0 - Stop mode (not Standby)
+	PWR->CR |= (1<<0);															//LPSDSR - voltage regulator in low power mode during Stop
+	PWR->CR |= (1<<9);															//ULP - Vrefint off in Stop mode
+	PWR->CR |= (1<<10);															//FWU - we don't wait for Vrefint upon wake-up
+	PWR->CR |= (1<<2);															//CWUF - clear the wake-up flag
+	RCC->CFGR |= (1<<15);														//STOPWUCK - wake up on HSI16 instead of MSI
+	SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;											//deep sleep is Stop mode
+
+	//2)
+	__WFI();
+
+	//3)
+	SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;											//we go back to normal sleep for any later WFI
+}
+
+
+//10) Clock profile switch
+void SysClockProfile(enum_Clock_Profile new_clock_profile) {
+	/**
+	 * We switch the system clock to one of the three profiles and adjust everything that depends on it.
+	 * The prescalers are picked so that the timers get 16 MHz and the UART1 gets 16 MHz on both HSI16 and PLL. Only MSI needs new prescalers and a new BRR.
+	 *
+	 * Profile		SYSCLK			APB1	APB2	PCLK1		PCLK2		timers		FLASH
+	 * MSI			2.097 MHz		/1		/1		2.097 MHz	2.097 MHz	2.097 MHz	0 WS
+	 * HSI16		16 MHz			/2		/1		8 MHz		16 MHz		16 MHz		0 WS
+	 * PLL			32 MHz			/4		/2		8 MHz		16 MHz		16 MHz		1 WS
+	 *
+	 * 0)Send out the log while the UART2 still has the BRR for its clock
+	 * 1)Add FLASH wait state if we are going to the PLL
+	 * 2)Turn on the oscillator of the new profile
+	 * 3)Set the prescalers and switch the system clock
+	 * 4)Remove the FLASH wait state if we are not on the PLL anymore, turn off what we don't use
+	 * 5)Adjust the timer prescalers
+	 * 6)Adjust the UART baud rates
+	 *
+	 * Note: the voltage regulator stays at range 1 (1.8 V), which is fine for all profiles.
+	 * Note: the UARTs are briefly disabled when their BRR changes. Switching is only allowed between messages.
+	 * Note: the log drain is bounded (Log_drain_timeout_us). A log that doesn't get out in time is garbled, the switch is not held up.
+	 * Note: timers are clocked at PCLK x2 if the APB prescaler is not 1.
+	 *
+	 **/
+
+	uint32_t timer_clk_freq;
+
+	//0)
+	if ((RCC->CCIPR & (3<<2)) != (2<<2)) {
+		BootLogDrain(Log_drain_timeout_us);										//UART2 on APB1 - its baud rate changes with the switch
+	} else {
+		//do nothing															//UART2 on HSI16 (boot_wait_stop_mode) - the switch doesn't touch it
+	}
+
+	//1)
+	if (new_clock_profile == Clock_Profile_PLL) {
+		FLASH->ACR |= (1<<0);													//1 WS
+	}
+
+	//2)-3)
+	switch (new_clock_profile) {
+	case Clock_Profile_MSI:
+		RCC->ICSCR &= ~(7<<13);
+		RCC->ICSCR |= (5<<13);													//MSI range 5 - 2.097 MHz
+		RCC->CR |= (1<<8);														//we turn on MSI
+		while (!(RCC->CR & (1<<9)));											//and wait until it becomes stable
+		RCC->CFGR &= ~((7<<8) | (7<<11));										//APB1 /1, APB2 /1
+		RCC->CFGR &= ~(3<<0);													//MSI as source
+		while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_MSI);
+		PCLK1_freq = 2097152;
+		PCLK2_freq = 2097152;
+		timer_clk_freq = 2097152;
+		break;
+
+	case Clock_Profile_HSI16:
+		RCC->CR |= (1<<0);														//we turn on HSI16
+		while (!(RCC->CR & (1<<2)));
+		RCC->CFGR &= ~((7<<8) | (7<<11));
+		RCC->CFGR |= (4<<8);													//APB1 /2, APB2 /1
+		RCC->CFGR &= ~(3<<0);
+		RCC->CFGR |= (1<<0);													//HSI16 as source
+		while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSI);
+		PCLK1_freq = 8000000;
+		PCLK2_freq = 16000000;
+		timer_clk_freq = 16000000;
+		break;
+
+	case Clock_Profile_PLL:
+	default:
+		RCC->CR |= (1<<0);														//PLL runs from HSI16
+		while (!(RCC->CR & (1<<2)));
+		RCC->CR |= (1<<24);														//we turn on the PLL (multiplier and divider are set by SysClockConfig)
+		while (!(RCC->CR & (1<<25)));
+		RCC->CFGR &= ~((7<<8) | (7<<11));
+		RCC->CFGR |= (5<<8) | (4<<11);											//APB1 /4, APB2 /2
+		RCC->CFGR |= (3<<0);													//PLL as source
+		while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+		PCLK1_freq = 8000000;
+		PCLK2_freq = 16000000;
+		timer_clk_freq = 16000000;
+		new_clock_profile = Clock_Profile_PLL;
+		break;
+	}
+
+	//4)
+	if (new_clock_profile != Clock_Profile_PLL) {
+		FLASH->ACR &= ~(1<<0);													//0 WS is enough up to 16 MHz
+		RCC->CR &= ~(1<<24);													//PLL off
+	}
+	if ((new_clock_profile == Clock_Profile_MSI) && ((RCC->CCIPR & ((3<<0) | (3<<2))) == 0)) {
+		RCC->CR &= ~(1<<0);														//HSI16 off - unless a UART is using it as kernel clock
+	}
+	Current_Clock_Profile = new_clock_profile;
+	SystemCoreClockUpdate();
+
+	//5)
+	TIM6->PSC = (timer_clk_freq / 1000000) - 1;									//1 MHz for the delay function (roughly 1.05 MHz on MSI)
+	TIM6->EGR |= (1<<0);														//we load the new prescaler right away
+	TIM2->PSC = (timer_clk_freq / 1000) - 1;									//1 kHz
+	TIM2->EGR |= (1<<0);														//we load the new prescaler right away, otherwise the running second would be stretched or shrunk
+																				//Note: URS is set on TIM2, so this does not trigger the IRQ. The running second restarts though.
+
+	//6)
+	UART1BaudUpdate();
+	BootLogBaudUpdate();
+}
+
+
+//11) Clock getters
+uint32_t GetPCLK1Freq(void) {
+	return PCLK1_freq;
+}
+
+uint32_t GetPCLK2Freq(void) {
+	return PCLK2_freq;
+}
+
+
+#ifdef irq_latency_probe
+//12) TIM22 setup for the IRQ latency probe
+void BootTIM22_INT (void) {
+	/**
+	 * TIM22 counts at 1 MHz and overflows every 10 ms. Its IRQ reads the counter to see how late it came (see BootIRQ_Control.c).
+	 * Must be called after the clock profile switch: SysClockProfile does not follow up on the TIM22 prescaler.
+	 *
+	 * 1)Enable TIM22 clocking
+	 * 2)Set prescaler and ARR
+	 * 3)Enable the update IRQ and the timer
+	 *
+	 **/
+
+	//1)
+	RCC->APB2ENR |= (1<<5);														//enable TIM22 clocking
+
+	//2)
+	uint32_t timer_clk_freq = ((RCC->CFGR & (4<<11)) == (4<<11)) ? (2 * PCLK2_freq) : PCLK2_freq;		//timers are clocked at PCLK x2 if the APB prescaler is not 1
+	TIM22->PSC = (timer_clk_freq / 1000000) - 1;								//1 MHz
+	TIM22->ARR = TIM22_probe_period - 1;
+	TIM22->CR1 |= (1<<2);														//we want a trigger only when overflow happens
+	TIM22->EGR |= (1<<0);														//we load the prescaler right away - URS keeps this from triggering the IRQ
+	TIM22->SR &= ~(1<<0);
+
+	//3)
+	TIM22->DIER |= (1<<0);														//update interrupt enabled
+	NVIC_EnableIRQ(TIM22_IRQn);
+	TIM22->CR1 |= (1<<0);														//timer counter enable bit
+}
+
+
+//13) TIM22 full deinit function
+void BootTIM22_DEINT (void) {
+	TIM22->CR1 &= ~(1<<0);														//we shut off the TIM22 timer
+	NVIC_DisableIRQ(TIM22_IRQn);												//we disable the TIM22 IRQ
+	TIM22->SR &= ~(1<<0);														//we clear the TIM22 IRQ trigger flag
+	RCC->APB2ENR &= ~(1<<5);
+}
+#endif
@@ -14,16 +14,38 @@
 
 #include "stdint.h"
 
+typedef enum {
+	Clock_Profile_MSI,											//2.097 MHz MSI - idling, waiting for commands
+	Clock_Profile_HSI16,										//16 MHz HSI16 - command processing, wake-up from Stop
+	Clock_Profile_PLL											//32 MHz PLL - programming
+} enum_Clock_Profile;
+
 //LOCAL CONSTANT
 //constant for the seconds counter (sets the TIM2 IRQ)
 const static uint16_t TIM2_timer_interrupt = 0x7cf;										//currently at 1000 ms
+//constant for the seconds counter in Stop mode (sets the LPTIM1 IRQ)
+const static uint16_t LPTIM1_timer_interrupt = 289;										//LSI is roughly 37 kHz, divided by 128 it gives 289 ticks per second
+																						//Note: LSI is not precise (26 to 56 kHz over temperature and parts). The boot window is not either in Stop mode.
+//TIM22 period of the IRQ latency probe in us
+const static uint16_t TIM22_probe_period = 10000;										//10 ms - longer than any NVM operation
+
+//EXTERNAL VARIABLE
+extern enum_Clock_Profile Current_Clock_Profile;
 
 //FUNCTION PROTOTYPES
 void SysClockConfig(void);
+void SysClockProfile(enum_Clock_Profile new_clock_profile);
+uint32_t GetPCLK1Freq(void);
+uint32_t GetPCLK2Freq(void);
 void TIM6Config (void);
 void Delay_us(int micro_sec);
 void Delay_ms(int milli_sec);
 void BootTIM2_INT (void);
 void BootTIM2_DEINT (void);
+void BootLPTIM1_INT (void);
+void BootLPTIM1_DEINT (void);
+void BootTIM22_INT (void);
+void BootTIM22_DEINT (void);
+void BootStopMode (void);
 
 #endif /* BOOTRCCTIMPWMDELAY_CUSTOM_H_ */
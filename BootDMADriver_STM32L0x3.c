@@ -3,7 +3,7 @@
  *  Author: BalazsFarkas
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
- *  Program version: 1.0
+ *  Program version: 1.3
  *  File: BootDMADriver_STM32L0x3.c
  *  Modified from: STM32_DMADriver/DMADriver_STM32L0x3.c
  *  Change history:
@@ -15,6 +15,15 @@
  * It initialises the seven DMA channels according to page 263 of the refman.
  * Currently runs only the UART1 Rx on Channel3.
  *
+ * v.1.1
+ * Added UART2 Tx on Channel4 to drain the log ring buffer.
+ *
+ * v.1.2
+ * Added UART1 Tx on Channel2 for FLASH readback.
+ *
+ * v.1.3
+ * Added SPI1 Rx on Channel2 and SPI1 Tx on Channel3 for the SPI1 slave transport (spi1_transport).
+ *
  */
 
 #include "BootDMADriver_STM32L0x3.h"
@@ -34,7 +43,14 @@ void BootDMAInit(void){
 																				//clocking is directly through the AHB
 
 	//2)
+#ifdef spi1_transport
+	DMA1_CSELR->CSELR |= (1<<4);												//DMA1_Channel2: will be requested at 4'b0001 for SPI1_RX
+	DMA1_CSELR->CSELR |= (1<<8);												//DMA1_Channel3: will be requested at 4'b0001 for SPI1_TX
+#else
+	DMA1_CSELR->CSELR |= (3<<4);												//DMA1_Channel2: will be requested at 4'b0011 for UART1_TX
 	DMA1_CSELR->CSELR |= (3<<8);												//DMA1_Channel3: will be requested at 4'b0011 for UARI1_RX
+#endif
+	DMA1_CSELR->CSELR |= (4<<12);												//DMA1_Channel4: will be requested at 4'b0100 for UART2_TX
 }
 
 
@@ -75,3 +91,134 @@ void DMAChannelUART1RxConfig(uint32_t mem_addr_UART1_Rx){
 	DMA1_Channel3->CNDTR |= ((DMA_transfer_width_UART1)<<0);					//we want to have an element burst of "DMA_transfer_width_UART1"
 																				//transfer_width_UART1 is set in bytes (!)
 }
+
+
+//3)We set up a channel for the UART2 Tx
+void DMAChannelUART2TxConfig(void){
+	/* Configure the DMA channel for UART2 Tx - channel4
+	 *
+	 * 1)Ensure that the channel is disabled
+	 * 2)Configure channel parameters: transfer direction (mem-to-peri), address increment, transfer complete interrupt
+	 * 3)Provide peri address
+	 *
+	 * Note: the memory address and the transfer width change with every chunk of the log, so they are set by the log driver.
+	 *
+	 */
+	//1)
+	DMA1_Channel4->CCR &= ~(1<<0);												//we disable this DMA channel, if it is activated
+
+	//2)
+	DMA1_Channel4->CCR |= (1<<1);												//we enable the transfer complete interrupt within the DMA channel
+	DMA1_Channel4->CCR &= ~(1<<2);												//no half-transfer interrupt
+	DMA1_Channel4->CCR |= (1<<4);												//we read from the memory
+	DMA1_Channel4->CCR &= ~(1<<5);												//circular mode is off - the log driver restarts the DMA after TC
+	DMA1_Channel4->CCR &= ~(1<<6);												//peripheral increment is not used - we have just the TDR register to write to
+	DMA1_Channel4->CCR |= (1<<7);												//memory increment is used
+	DMA1_Channel4->CCR &= ~(3<<8);												//peri side data length is 8 bits
+	DMA1_Channel4->CCR &= ~(3<<10);												//mem side data length is 8 bits
+	DMA1_Channel4->CCR &= ~(3<<12);												//priority level is set as LOW - the log must never hold up the UART1 Rx
+
+	//3)
+	DMA1_Channel4->CPAR = (uint32_t) (&(USART2->TDR));							//we want the data to be loaded into the UART2's TDR register
+}
+
+
+//4)We set up a channel for the UART1 Tx
+void DMAChannelUART1TxConfig(void){
+	/* Configure the DMA channel for UART1 Tx - channel2
+	 *
+	 * 1)Ensure that the channel is disabled
+	 * 2)Configure channel parameters: transfer direction (mem-to-peri), address increment, no interrupts
+	 * 3)Provide peri address
+	 *
+	 * Note: Channel2 shares its IRQ with the UART1 Rx on Channel3, so we don't use interrupts here. The UART driver polls the TC flag.
+	 * Note: the memory address and the transfer width are set by the UART driver for every chunk.
+	 *
+	 */
+	//1)
+	DMA1_Channel2->CCR &= ~(1<<0);												//we disable this DMA channel, if it is activated
+
+	//2)
+	DMA1_Channel2->CCR &= ~((1<<1) | (1<<2) | (1<<3));							//no transfer complete, half-transfer or error interrupt
+	DMA1_Channel2->CCR |= (1<<4);												//we read from the memory
+	DMA1_Channel2->CCR &= ~(1<<5);												//circular mode is off
+	DMA1_Channel2->CCR &= ~(1<<6);												//peripheral increment is not used - we have just the TDR register to write to
+	DMA1_Channel2->CCR |= (1<<7);												//memory increment is used
+	DMA1_Channel2->CCR &= ~(3<<8);												//peri side data length is 8 bits
+	DMA1_Channel2->CCR &= ~(3<<10);												//mem side data length is 8 bits
+	DMA1_Channel2->CCR &= ~(3<<12);
+	DMA1_Channel2->CCR |= (1<<12);												//priority level is set as MEDIUM
+
+	//3)
+	DMA1_Channel2->CPAR = (uint32_t) (&(USART1->TDR));							//we want the data to be loaded into the UART1's TDR register
+}
+
+
+//5)We set up a channel for the SPI1 Rx
+void DMAChannelSPI1RxConfig(uint32_t mem_addr_SPI1_Rx, enum_Yes_No_Selector circular){
+	/* Configure the DMA channel for SPI1 Rx - channel2
+	 *
+	 * 1)Ensure that the channel is disabled
+	 * 2)Configure channel parameters: transfer direction (peri-to-mem), address increment, circular mode and IRQs for the machine code
+	 * 3)Provide peri and mem addresses
+	 * 4)Provide transfer width
+	 *
+	 * Note: commands are received in normal mode without IRQs, the NSS edge tells us when they are done. See BootSPIDriver.
+	 * Note: machine code is received in circular mode. Unlike on the UART1, we can't stop the SPI1 for a restart, the master clocks regardless.
+	 *
+	 */
+	//1)
+	DMA1_Channel2->CCR &= ~(1<<0);												//we disable this DMA channel, if it is activated
+
+	//2)
+	if (circular == Yes) {
+		DMA1_Channel2->CCR |= (1<<1) | (1<<2) | (1<<3);							//transfer complete, half-transfer and error interrupts
+		DMA1_Channel2->CCR |= (1<<5);											//circular mode
+	} else {
+		DMA1_Channel2->CCR &= ~((1<<1) | (1<<2) | (1<<3));						//no interrupts
+		DMA1_Channel2->CCR &= ~(1<<5);											//circular mode is off
+	}
+	DMA1_Channel2->CCR &= ~(1<<4);												//we read from the peripheral
+	DMA1_Channel2->CCR &= ~(1<<6);												//peripheral increment is not used - we have just the DR register to read from
+	DMA1_Channel2->CCR |= (1<<7);												//memory increment is used
+	DMA1_Channel2->CCR &= ~(3<<8);												//peri side data length is 8 bits
+	DMA1_Channel2->CCR &= ~(3<<10);												//mem side data length is 8 bits
+	DMA1_Channel2->CCR |= (3<<12);												//priority level is set as VERY HIGH - the master does not wait for us
+
+	//3)
+	DMA1_Channel2->CPAR = (uint32_t) (&(SPI1->DR));								//we want the data to be extracted from the SPI1's DR register
+	DMA1_Channel2->CMAR = mem_addr_SPI1_Rx;
+
+	//4)
+	DMA1_Channel2->CNDTR = DMA_transfer_width_UART1;							//same 2 pages as on the UART1
+}
+
+
+//6)We set up a channel for the SPI1 Tx
+void DMAChannelSPI1TxConfig(void){
+	/* Configure the DMA channel for SPI1 Tx - channel3
+	 *
+	 * 1)Ensure that the channel is disabled
+	 * 2)Configure channel parameters: transfer direction (mem-to-peri), address increment, no interrupts
+	 * 3)Provide peri address
+	 *
+	 * Note: the memory address and the transfer width are set by the SPI1 driver for every reply.
+	 *
+	 */
+	//1)
+	DMA1_Channel3->CCR &= ~(1<<0);												//we disable this DMA channel, if it is activated
+
+	//2)
+	DMA1_Channel3->CCR &= ~((1<<1) | (1<<2) | (1<<3));							//no transfer complete, half-transfer or error interrupt
+	DMA1_Channel3->CCR |= (1<<4);												//we read from the memory
+	DMA1_Channel3->CCR &= ~(1<<5);												//circular mode is off
+	DMA1_Channel3->CCR &= ~(1<<6);												//peripheral increment is not used
+	DMA1_Channel3->CCR |= (1<<7);												//memory increment is used
+	DMA1_Channel3->CCR &= ~(3<<8);												//peri side data length is 8 bits
+	DMA1_Channel3->CCR &= ~(3<<10);												//mem side data length is 8 bits
+	DMA1_Channel3->CCR &= ~(3<<12);
+	DMA1_Channel3->CCR |= (1<<12);												//priority level is set as MEDIUM
+
+	//3)
+	DMA1_Channel3->CPAR = (uint32_t) (&(SPI1->DR));								//we want the data to be loaded into the SPI1's DR register
+}
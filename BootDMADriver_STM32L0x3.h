@@ -26,5 +26,9 @@ extern uint16_t DMA_transfer_width_UART1;
 //FUNCTION PROTOTYPES
 void BootDMAInit(void);
 void DMAChannelUART1RxConfig(uint32_t mem_addr_UART1_Rx);
+void DMAChannelUART2TxConfig(void);
+void DMAChannelUART1TxConfig(void);
+void DMAChannelSPI1RxConfig(uint32_t mem_addr_SPI1_Rx, enum_Yes_No_Selector circular);
+void DMAChannelSPI1TxConfig(void);
 
 #endif /* INC_BOOTDMADRIVER_CUSTOM_H_ */
@@ -0,0 +1,99 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L0xx
+ *  Header version: 1.0
+ *  File: BootDeviceTraits_STM32L0xx.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Compile-time description of the STM32L0 part the bootloader is built for: NVM geometry, memory layout and the size of the Rx buffer.
+ * The part comes from the device define of the build (STM32L053xx, STM32L073xx...), the same one that picks the CMSIS header in stm32l0xx.h.
+ * Everything here is a constant. Buffer sizes, loop bounds and address steps are folded in by the compiler, nothing is looked up at runtime.
+ *
+ * Note: there is no category 4 in the L0 line. Categories 1 and 2 are described, but the bootloader does not fit them (see below).
+ */
+
+#ifndef INC_BOOTDEVICETRAITS_STM32L0XX_H_
+#define INC_BOOTDEVICETRAITS_STM32L0XX_H_
+
+//CATEGORY
+#if defined(STM32L010x4) || defined(STM32L011xx) || defined(STM32L021xx)
+#define Dev_category					1
+#elif defined(STM32L010x6) || defined(STM32L031xx) || defined(STM32L041xx)
+#define Dev_category					2
+#elif defined(STM32L010x8) || defined(STM32L051xx) || defined(STM32L052xx) || defined(STM32L053xx) || defined(STM32L062xx) || defined(STM32L063xx)
+#define Dev_category					3
+#elif defined(STM32L010xB) || defined(STM32L071xx) || defined(STM32L072xx) || defined(STM32L073xx) || defined(STM32L081xx) || defined(STM32L082xx) || defined(STM32L083xx)
+#define Dev_category					5
+#else
+#error "Unknown STM32L0 part: the build must define the device (STM32L053xx, STM32L073xx...)"
+#endif
+
+
+//NVM GEOMETRY - the same on every L0
+#define Dev_page_size					128											//smallest erase step of the FLASH
+#define Dev_half_page_size				64											//programming step of FLASHUpd_HalfPage
+#define Dev_page_words					(Dev_page_size / 4)
+#define Dev_half_page_words				(Dev_half_page_size / 4)
+#define Dev_half_pages_per_page			(Dev_page_size / Dev_half_page_size)
+
+
+//MEMORY LAYOUT
+//Note: the FLASH size is the largest of the category. Parts with less FLASH (L072CB: 128 kB, L051K6: 32 kB...) must define Dev_FLASH_size for the build.
+#define Dev_FLASH_base					0x08000000
+#define Dev_RAM_base					0x20000000
+#define Dev_vector_table_words			48											//16 system vectors and 32 IRQs on every L0
+
+#if (Dev_category == 1)
+#define Dev_FLASH_size_max				0x4000										//16 kB
+#define Dev_RAM_size					0x800										//2 kB
+#define Dev_EEPROM_size					0x200										//512 bytes
+#elif (Dev_category == 2)
+#define Dev_FLASH_size_max				0x8000										//32 kB
+#define Dev_RAM_size					0x2000										//8 kB
+#define Dev_EEPROM_size					0x400										//1 kB
+#elif (Dev_category == 3)
+#define Dev_FLASH_size_max				0x10000										//64 kB
+#define Dev_RAM_size					0x2000										//8 kB
+#define Dev_EEPROM_size					0x800										//2 kB
+#else
+#define Dev_FLASH_size_max				0x30000										//192 kB, two banks
+#define Dev_RAM_size					0x5000										//20 kB
+#define Dev_EEPROM_size					0x1800										//6 kB, two banks
+#endif
+
+#ifndef Dev_FLASH_size
+#define Dev_FLASH_size					Dev_FLASH_size_max
+#endif
+
+#define Dev_FLASH_end					(Dev_FLASH_base + Dev_FLASH_size)
+#define Dev_RAM_end						(Dev_RAM_base + Dev_RAM_size)				//the initial stack pointer of an app with its stack at the end of the RAM
+
+
+//RX BUFFER
+//The Rx buffer is a ping-pong buffer of two halves, the DMA IRQ comes when a half is full. A half is one page where the RAM is tight and more where it is not.
+//Note: the SPI1 master is held by the ready line after every page, so a bigger half would not buy anything there.
+#if (Dev_category == 5) && !defined(spi1_transport)
+#define Dev_Rx_half_pages				4											//1 kB buffer out of 20 kB
+#else
+#define Dev_Rx_half_pages				1											//256 bytes out of 8 kB
+#endif
+
+#define Dev_Rx_half_size				(Dev_Rx_half_pages * Dev_page_size)
+#define Dev_Rx_buf_pages				(2 * Dev_Rx_half_pages)
+#define Dev_Rx_buf_size					(Dev_Rx_buf_pages * Dev_page_size)
+#define Dev_Rx_buf_words				(Dev_Rx_buf_size / 4)
+
+
+//CHECKS
+#if (Dev_category == 1) || (Dev_category == 2)
+#error "Category 1 and 2 parts can't take this bootloader: the boot section alone is 32 kB (App_Section_Start_Addr), and they have no USART1"
+#endif
+
+#if (Dev_FLASH_size > Dev_FLASH_size_max)
+#error "Dev_FLASH_size is more than the category has"
+#endif
+
+#endif /* INC_BOOTDEVICETRAITS_STM32L0XX_H_ */
@@ -3,7 +3,7 @@
  *  Author: BalazsFarkas
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
- *  Program version: 1.0
+ *  Program version: 1.23
  *  File: BootExternalController.c
  *  Modified from: N/A
  *  Change history:
@@ -11,11 +11,95 @@
  * v.1.0
  * UART1-based external controller.
  *
+ * v.1.1
+ * Clock profile goes to PLL for programming (0xbb) and back to MSI at the end of the session.
+ *
+ * v.1.2
+ * A/B slots: updates go into the slot we are not running from and the slot is switched once the new app is in. Added 0xb5 (slot status) and 0xac (confirm app).
+ *
+ * v.1.3
+ * Resumable updates (0xb6): progress is kept in data EEPROM page by page. A link loss only pauses the update.
+ * Commands are now read from the first byte of the buffer so they can carry a payload.
+ * Programmer mode entry moved to its own function, shared by 0xbb and 0xb6.
+ *
+ * v.1.4
+ * FLASH readback (0xb7) streamed on UART1 Tx by DMA and per page CRC verify (0xb8) that replies with the mismatching pages only.
+ *
+ * v.1.5
+ * Session report (0xbf) with the number of pages received, sent at the end of every programming session.
+ *
+ * v.1.6
+ * Addressed frames (0xAD, target, command) for a shared RS-485 bus: one node, a group or all nodes. Only a single addressed node replies.
+ * Node address set with 0xa1, last session report polled with 0xbf. Nodes that are not addressed by an update sit the session out as bystanders.
+ *
+ * v.1.7
+ * UART1 baud rate change (0xbd). The reply goes out on the old rate, the first frame on the new rate confirms it.
+ *
+ * v.1.8
+ * The host is held with RTS while a page is written into the FLASH (uart1_flow_control).
+ *
+ * v.1.9
+ * The link is reached through BootLink.h, so the same controller runs on the UART1 or on the SPI1 slave (spi1_transport).
+ *
+ * v.1.10
+ * Pages are not written after a line error on the UART1. The session report (0xbf) carries the line error counters and only counts the pages before the error.
+ *
+ * v.1.11
+ * Session statistics: bytes and pages, FLASH erase and program times, the smallest buffer slack and the session time. The last session can be polled with 0xb9.
+ *
+ * v.1.12
+ * Trace ring dump (0xba, boot_trace).
+ *
+ * v.1.13
+ * Boot config (0xbc): written into data EEPROM, used from the next reset. The reply is the config the next reset will run on.
+ *
+ * v.1.14
+ * Signed images (image_signed): every page is hashed before it goes into the FLASH, the slot is only switched once the tag from the host (0xbe) matches. Hash benchmark with 0xb4.
+ *
+ * v.1.15
+ * Encrypted images (image_encrypted): the nonce of the image comes with 0xb3, every page is decrypted in the Rx buffer before anything else is done with it. Decryption benchmark with 0xb2.
+ *
+ * v.1.16
+ * Session options (0xb1) for the next update. The first one is the byte swap of big-endian images: the page is swapped in the Rx buffer, so it still goes in by half-pages.
+ *
+ * v.1.17
+ * IRQ latency probe (irq_latency_probe): TIM22 runs through every programming session, the latency statistics are read with 0xb0.
+ *
+ * v.1.18
+ * A half of the Rx buffer may hold more than one page (Dev_Rx_half_pages, see BootDeviceTraits_STM32L0xx.h). Both halves go through SessionRxHalfToFLASH page by page.
+ * With more than one page per half, the complete pages of the half that was still filling up are written when the session ends.
+ *
+ * v.1.19
+ * A 0xb6 to a group or to every node makes the matching nodes bystanders. Before, they went on reading the image stream as commands.
+ *
+ * v.1.20
+ * 0xbc with Boot_Config_Clear can be refused too (app base of a signed build), it is logged like any other rejected config.
+ *
+ * v.1.21
+ * 0xb8 refuses a start address past the app section. Before, the page count check wrapped around for such an address.
+ *
+ * v.1.22
+ * 0xb4 and 0xb2 go through BootBenchRun (BootBench.c): the clock profile, the length cap and the timing are no longer repeated in both cases.
+ *
+ * v.1.23
+ * 0xbb without a new nonce (image_encrypted) only takes the image off the line. It no longer clears the update progress of the slot.
+ *
  *
  */
 
 #include "BootExternalController.h"
 
+static void UART1ProgrammerModeEnter(void);
+static void SessionReportSend(void);
+static void SessionStatsTick(void);
+static void SessionStatsPageDone(enum_First_Second_Selector written_half);
+static void SessionRxHalfToFLASH(enum_First_Second_Selector rx_half, uint8_t page_cnt);
+
+static uint16_t Session_Pages_Accepted;													//pages taken over by the controller before a line error
+static uint16_t Session_Time_Stamp;														//TIM6 at the last statistics tick
+#ifdef image_signed
+static enum_Yes_No_Selector Update_Auth_Pending = No;									//an image is in the update slot and waits for its tag (0xbe)
+#endif
 
 //1)UART1 Rx-based external controller
 
@@ -31,7 +115,9 @@
  *
  * The reason why the code is so convoluted is that we don't have a master in UART. Thus the state of the bus must be used to govern, what happens.
  *
- * The code does not have a Tx element on the UART1. The stm32 can not communicate with the partner device. It does communicate with the PC using UART2.
+ * UART1 Tx is only used for short replies to status commands (see UART1TxReply). Logs go to the PC using UART2.
+ *
+ * With "spi1_transport", the same happens on the SPI1 slave: the end of a message is the NSS rising edge instead of the idle bus (see BootSPIDriver).
  *
  * */
 
@@ -42,40 +128,281 @@ void UART1_External_Boot_Controller (void) {
 		  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//we poll for the starting sequence but do not log it
 		  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//we are NOT using DMA!
 
-		  UART1RxMessage();														//we call the UART function - no DMA - to scan for a command sequence
+		  BootLinkRxMessage();														//we call the UART function - no DMA - to scan for a command sequence
 		  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//this order logs at maximum 256 bytes of incoming UART messages
-		  switch (Rx_Message_buf[0]) {
+#ifndef spi1_transport
+		  if (UART1_Baud_Probation == Yes) {											//a frame came through on the new baud rate: we keep it
+			  UART1BaudProbationEnd(Yes);
+		  } else {
+			  //do nothing
+		  }
+#endif
+		  uint8_t* command_ptr = UART1CommandForThisNode();							//the command is the first byte after the start sequence (and the address, if any), anything after it is the payload
+		  if (Update_Bystander == Yes) {												//an image for other nodes on the bus is coming
+			  UART1ProgrammerModeEnter();												//we receive it the same way they do, so the machine code is not mistaken for commands, then drop it
+		  } else {
+			  //do nothing
+		  }
+
+		  switch ((command_ptr != NULL) ? *command_ptr : 0x00) {						//frames for other nodes end up in "default"
 
 		  case 0xaa:																	//activate/jump to app
-			  printf("De-initializing bootloader drivers...\r\n");
-			  UART1Deinit();
-			  printf("Jumping to app...\r\n");
+			  BootLogInfo(LogTok_Deinit_drivers);
+			  BootLinkDeinit();
+			  BootLogInfo(LogTok_Jumping_to_app);
 			  GoToApp();																//we simply jump to the APP and leave the bootloader
 			  break;
 
 		  case 0xbb:																	//switch to programmer mode
-			  printf("Update app...\r\n");
-			  memset(Rx_Message_buf, 0, 64);											//wipe the buffer
+#ifdef image_encrypted
+			  if (BootCryptStart() == No) {
+				  BootLogError(LogTok_Crypt_no_nonce);
+				  Update_Bystander = Yes;												//we take the image off the line without writing it - the host gets no session report
+				  UART1ProgrammerModeEnter();											//the slot and its update progress are left as they are, same as a rejected 0xb6
+				  break;
+			  } else {
+				  //do nothing
+			  }
+#endif
+			  BootLogInfo(LogTok_Update_app);
+			  Update_Resumable = No;													//a plain update can't be resumed
+			  ClearUpdateProgress();
+			  flash_page_addr = App_Slot_Start_Addr[GetUpdateSlot()];					//we write into the slot we are not running from
+			  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//Note: the machine code must be built for this slot (see 0xb5)
+			  UART1ProgrammerModeEnter();
+			  break;
+
+		  case 0xb6:																	//resumable update: payload is the image ID and the image size (both LE32)
+		  {
+			  uint32_t image_id;
+			  uint32_t image_size;
+			  uint32_t next_offset;
+			  memcpy(&image_id, command_ptr + 1, 4);
+			  memcpy(&image_size, command_ptr + 5, 4);
+
+			  if (UART1_Reply_Enabled == No) {											//every node resumes from its own offset, so this only works node by node
+				  Update_Bystander = Yes;												//group or broadcast: we take whatever image follows off the line, like the nodes that are not addressed
+				  UART1ProgrammerModeEnter();
+				  break;
+			  } else {
+				  //do nothing
+			  }
+
+			  if ((image_size == 0) || (image_size > App_Slot_Size)) {
+				  BootLogError(LogTok_Update_rejected, image_size);
+				  next_offset = 0xFFFFFFFF;												//the host must not send anything
+				  BootLinkTxReply(0xb6, (uint8_t*)&next_offset, 4);
+				  break;
+			  } else {
+				  //do nothing
+			  }
+
+#ifdef image_encrypted
+			  if (BootCryptStart() == No) {
+				  BootLogError(LogTok_Crypt_no_nonce);
+				  next_offset = 0xFFFFFFFF;												//same as a rejected update: the host must not send anything
+				  BootLinkTxReply(0xb6, (uint8_t*)&next_offset, 4);
+				  break;
+			  } else {
+				  //do nothing
+			  }
+#endif
+
+			  BootLogInfo(LogTok_Update_app);
+			  next_offset = StartUpdateProgress(image_id, image_size);					//0 for a new image, the first missing page for an image we have seen before
+			  Update_Resumable = Yes;
+			  flash_page_addr = App_Slot_Start_Addr[GetUpdateSlot()] + next_offset;
+			  UART1ProgrammerModeEnter();												//the DMA must be running before the host gets the reply
+
+			  uint8_t resume_status[8];
+			  memcpy(&resume_status[0], &next_offset, 4);								//the host sends the image from this offset on
+			  memcpy(&resume_status[4], (uint32_t*)Update_CRC_Addr, 4);					//CRC of the image up to the offset - the host can check it against its own file
+			  BootLinkTxReply(0xb6, resume_status, 8);
+			  break;
+		  }
+
+		  case 0xcc:																	//reboot
+			  ReBoot();
+			  break;
 
-			  UART1Deinit();														//we completely deinitialize the UART1
+		  case 0xb5:																	//slot status
+		  {
+			  uint32_t slot_record = ReadSlotRecord();
+			  uint32_t update_slot_addr = App_Slot_Start_Addr[GetUpdateSlot()];
+			  uint8_t slot_status[8];
+			  memcpy(&slot_status[0], &slot_record, 4);									//the record as it is in EEPROM (active slot, state, trial boots)
+			  memcpy(&slot_status[4], &update_slot_addr, 4);							//the address the next 0xbb will write to - the host must send an app linked to this address
+			  BootLinkTxReply(0xb5, slot_status, 8);
+			  break;
+		  }
 
-			  DMAChannelUART1RxConfig(&Rx_Message_buf[0]);						//DMA channel reconfig - necessary after DMA shut off to ensure functionality
-			  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//Note: transfer width is 256 bytes, which is 2 pages of FLASH
-			  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//Note: the above 3 functions are mere config functions and do not activate the DMA
+		  case 0xac:																	//confirm the app in the active slot
+			  ConfirmAppSlot();
+			  break;
 
-		      UART1DMAEnable();	 	  	  	  	  	  	  	  	  	  	  	  	//we activate the DMA and the idle detection UART IRQ
-		      	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//capture the incoming machine code (64 words) with DMA
-			  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//here we want to have the DMA running and using the IRQs (for starters, only the TC IRQ to generate a flag)
+		  case 0xbf:																	//session report again - after a broadcast update, the host polls every node with this
+			  SessionReportSend();
+			  break;
 
-		      UART1_DMA_active = Yes;
+		  case 0xb9:																	//statistics of the last session
+			  BootLinkTxReply(0xb9, (uint8_t*)&Last_Session_Stats, sizeof(Last_Session_Stats));	//the struct as it is in RAM, little endian, no padding (36 bytes)
+			  break;
 
-			  printf("Awaiting machine code...\r\n");
+#ifdef boot_trace
+		  case 0xba:																	//trace ring dump
+			  BootTraceDump();
+			  break;
+#endif
 
+#ifdef irq_latency_probe
+		  case 0xb0:																	//IRQ latency of the last programming session
+			  BootLinkTxReply(0xb0, (uint8_t*)&IRQ_Latency, sizeof(IRQ_Latency));		//the struct as it is in RAM, little endian, no padding (36 bytes)
 			  break;
+#endif
 
-		  case 0xcc:																	//reboot
-			  ReBoot();
+		  case 0xb1:																	//session options: payload is one byte of option bits, used by the next update (0xbb or 0xb6)
+			  Update_Byte_Swap = ((*(command_ptr + 1) & Session_Opt_Byte_Swap) != 0) ? Yes : No;
+			  if (Update_Byte_Swap == Yes) BootLogInfo(LogTok_Byte_swap);
+			  break;
+
+#ifdef image_signed
+		  case 0xbe:																	//image tag: payload is the HMAC-SHA256 of the image (32 bytes)
+		  {
+			  uint8_t auth_result = No;
+
+			  if (Update_Auth_Pending == No) {
+				  //do nothing															//no image waiting - the reply tells the host
+			  } else if (BootAuthCheck(command_ptr + 1) == Yes) {
+				  SwitchAppSlot(GetUpdateSlot());										//one word in EEPROM: from the next boot, we run the new app (on trial)
+				  auth_result = Yes;
+			  } else {
+				  BootLogError(LogTok_Auth_failed, GetUpdateSlot());
+				  FLASHErase_Page(App_Slot_Start_Addr[GetUpdateSlot()]);				//the slot must never look valid - not even to the fallback in GoToApp
+			  }
+			  Update_Auth_Pending = No;													//one try per image
+
+			  BootLinkTxReply(0xbe, &auth_result, 1);
+			  break;
+		  }
+
+		  case 0xb4:																	//hash benchmark: payload is the number of bytes (LE16) hashed from the start of the app section
+			  BootBenchRun(0xb4, command_ptr + 1, BootAuthBench);
 			  break;
+#endif
+
+#ifdef image_encrypted
+		  case 0xb3:																	//image nonce: payload is the nonce of the encrypted image that comes next (12 bytes)
+			  BootCryptNonce(command_ptr + 1);
+			  break;
+
+		  case 0xb2:																	//decryption benchmark: payload is the number of bytes (LE16), decrypted page by page
+			  BootBenchRun(0xb2, command_ptr + 1, BootCryptBench);
+			  break;
+#endif
+
+#ifndef spi1_transport																	//on the SPI1, the master sets the clock
+		  case 0xbd:																	//UART1 baud rate: payload is the new rate (LE32)
+		  {
+			  uint32_t new_baud_rate;
+			  memcpy(&new_baud_rate, command_ptr + 1, 4);
+
+			  if (UART1BaudValid(new_baud_rate) == No) {
+				  new_baud_rate = 0;													//the reply tells the host that we stay on the current rate
+			  } else {
+				  //do nothing
+			  }
+
+			  BootLinkTxReply(0xbd, (uint8_t*)&new_baud_rate, 4);							//we acknowledge on the old rate
+			  if (new_baud_rate != 0) {
+				  BootLogInfo(LogTok_Baud_switched, UART1_baud_rate, new_baud_rate);
+				  UART1BaudSwitch(new_baud_rate);										//the host has UART1_baud_probation_in_sec to send a frame on the new rate
+			  } else {
+				  //do nothing
+			  }
+			  break;
+		  }
+#endif
+
+		  case 0xa1:																	//node address and group (1 byte each)
+			  if (*(command_ptr + 1) < Target_group_base) {								//node addresses stop where the group targets start
+				  SetNodeRecord(*(command_ptr + 1), *(command_ptr + 2));
+			  } else {
+				  //do nothing
+			  }
+			  break;
+
+		  case 0xbc:																	//boot config: payload is a struct_Boot_Config (12 bytes, little endian)
+		  {																				//a boot window of Boot_Config_Read only asks for the reply, Boot_Config_Clear goes back to the defaults
+			  struct_Boot_Config new_config;
+			  memcpy(&new_config, command_ptr + 1, sizeof(new_config));
+
+			  if (new_config.boot_window_sec == Boot_Config_Read) {
+				  //do nothing
+			  } else if (new_config.boot_window_sec == Boot_Config_Clear) {
+				  if (ClearBootConfig() == Yes) {
+					  BootLogInfo(LogTok_Boot_config_set);
+				  } else {
+					  BootLogError(LogTok_Boot_config_rejected);
+				  }
+			  } else if (SetBootConfig(&new_config) == Yes) {
+				  BootLogInfo(LogTok_Boot_config_set);
+			  } else {
+				  BootLogError(LogTok_Boot_config_rejected);
+			  }
+
+			  ReadBootConfig(&new_config);												//the config of the next reset - the host sees if its config was taken
+			  BootLinkTxReply(0xbc, (uint8_t*)&new_config, sizeof(new_config));
+			  break;
+		  }
+
+		  case 0xb7:																	//FLASH readback: payload is the start address and the length (both LE32)
+		  {
+			  uint32_t readback_addr;
+			  uint32_t readback_len;
+			  memcpy(&readback_addr, command_ptr + 1, 4);
+			  memcpy(&readback_len, command_ptr + 5, 4);
+
+			  if ((readback_addr < App_Section_Start_Addr) || (readback_addr >= App_Section_End_Addr)
+					  || (readback_len > (App_Section_End_Addr - readback_addr))) {
+				  readback_len = 0;														//we only read back the app section - the reply is just the header with a length of 0
+			  } else {
+				  //do nothing
+			  }
+
+			  BootLinkTxStream(0xb7, (uint8_t*)readback_addr, readback_len);				//DMA straight from the FLASH to the UART1
+			  break;
+		  }
+
+		  case 0xb8:																	//FLASH verify: payload is the start address (LE32), the number of pages (1 byte), then one CRC per page (LE32)
+		  {
+			  uint32_t verify_addr;
+			  uint8_t verify_page_cnt = *(command_ptr + 5);
+			  uint8_t verify_reply[2 + (2 * Verify_max_pages)];
+			  uint16_t mismatch_cnt = 0;
+			  memcpy(&verify_addr, command_ptr + 1, 4);
+
+			  if ((verify_addr < App_Section_Start_Addr) || (verify_addr >= App_Section_End_Addr) || ((verify_addr % Update_Page_Size) != 0) || (verify_page_cnt > Verify_max_pages)
+					  || ((verify_page_cnt * Update_Page_Size) > (App_Section_End_Addr - verify_addr))) {
+				  mismatch_cnt = 0xFFFF;												//invalid request
+			  } else {
+				  for (uint8_t i = 0; i < verify_page_cnt; i++) {
+					  uint32_t host_crc;
+					  uint32_t page_addr = verify_addr + (i * Update_Page_Size);
+					  memcpy(&host_crc, command_ptr + 6 + (4 * i), 4);
+					  if (BootCRCCalc(CRC_seed, (uint32_t*)page_addr, Update_Page_Size / 4) != host_crc) {
+						  uint16_t page_number = (page_addr - Boot_Section_Start_Addr) / Update_Page_Size;	//page number in the FLASH, counted from 0x8000000
+						  memcpy(&verify_reply[2 + (2 * mismatch_cnt)], &page_number, 2);
+						  mismatch_cnt++;
+					  } else {
+						  //do nothing
+					  }
+				  }
+			  }
+
+			  memcpy(&verify_reply[0], &mismatch_cnt, 2);
+			  BootLinkTxReply(0xb8, verify_reply, (mismatch_cnt == 0xFFFF) ? 2 : (2 + (2 * mismatch_cnt)));	//we only send back the pages that don't match
+			  break;
+		  }
 
 		  default:
 			  //do nothing
@@ -85,33 +412,94 @@ void UART1_External_Boot_Controller (void) {
 	  //Programmer Mode
 	  } else if (UART1_DMA_active == Yes) {								  	  	  	  	//defined by the DMA being active (response to the command 0xbb)
 
+		  SessionStatsTick();
+
 		  if (UART1_Message_Received == Yes) {											//in Programmer Mode if we detect that the bus is idle
 
-			  UART1Deinit();														//we de-initialize the UART completely
+			  BootLinkDeinit();														//we de-initialize the UART completely
 			  UART1_DMA_active = No;													//remove the DMA flag
 			  UART1_Message_Received = No;												//remove the message received flag
-			  printf("%d pages of machine app code have been updated \r\n", page_counter);	//we publish the page counter results
-			  page_counter = 0;															//we reset the page counter
-			  flash_page_addr = App_Section_Start_Addr;									//we move the flash pointer to the start of the app for additional updates
-			  memset(Rx_Message_buf, 0, 64);											//we wipe the UART buffer
-			  USART1->CR1 |= (1<<0);													//we re-enable the UART1 without DMA
+#if (Dev_Rx_half_pages > 1)
+			  uint16_t rx_pos = DMA_transfer_width_UART1 - BootLinkRxDMARemaining();
+			  uint8_t rx_tail_pages = (rx_pos % Dev_Rx_half_size) / Update_Page_Size;	//complete pages in the half the DMA was still filling - no DMA IRQ for them
+			  Session_Stats.pages_received += rx_tail_pages;
+			  SessionRxHalfToFLASH((rx_pos < Dev_Rx_half_size) ? First : Second, rx_tail_pages);
+#endif
+			  Session_Stats.bytes_received = (Session_Stats.pages_received * Update_Page_Size)
+					  + ((DMA_transfer_width_UART1 - BootLinkRxDMARemaining()) % Update_Page_Size);	//the filler byte at the end counts too
+			  BootLogInfo(LogTok_Pages_updated, Session_Stats.pages_received);	//we publish the page counter results
+			  BootLogInfo(LogTok_Session_stats, Session_Stats.erase_time_max_us, Session_Stats.program_time_max_us, Session_Stats.min_slack_bytes, Session_Stats.session_time_us / 1000);
+			  if (UART1_Line_Error_Hit == Yes) {
+				  BootLogError(LogTok_Line_errors, Session_Stats.line_errors.overrun, Session_Stats.line_errors.framing, Session_Stats.line_errors.noise, Session_Stats.line_errors.parity);
+			  } else {
+				  //do nothing
+			  }
+			  if (Update_Bystander == No) {
+				  Last_Session_Page_Cnt = (UART1_Line_Error_Hit == Yes) ? Session_Pages_Accepted : Session_Stats.pages_received;	//after a line error, the host must see a mismatch
+				  Last_Session_Stats = Session_Stats;
+				  SessionReportSend();													//session report: the host checks the number of pages we have received against what it sent
+			  } else {
+				  //do nothing
+			  }
+
+			  if (Update_Bystander == Yes) {											//the image was not for us
+				  Update_Bystander = No;
+			  } else if (Update_Resumable == Yes) {											//resumable update: the session may have ended because the link dropped
+				  Update_Resumable = No;
+				  uint32_t next_offset = *(__IO uint32_t*)Update_Next_Offset_Addr;
+				  uint32_t image_size = *(__IO uint32_t*)Update_Image_Size_Addr;
+				  if (next_offset >= image_size) {										//the full image is in
+					  ClearUpdateProgress();
+					  if (AppSlotValid(GetUpdateSlot()) == Yes) {
+#ifdef image_signed
+						  Update_Auth_Pending = Yes;									//the slot is only switched once the tag checks out (0xbe)
+						  BootLogInfo(LogTok_Auth_pending);
+#else
+						  SwitchAppSlot(GetUpdateSlot());
+#endif
+					  } else {
+						  BootLogError(LogTok_Slot_not_valid, GetUpdateSlot());
+					  }
+				  } else {
+					  BootLogInfo(LogTok_Update_paused, next_offset, image_size);		//we keep the record - the host resumes with the same 0xb6
+				  }
+			  } else if (UART1_Line_Error_Hit == Yes) {									//the image is not complete - the running app stays active
+				  BootLogError(LogTok_Slot_not_valid, GetUpdateSlot());
+			  } else if (flash_page_addr != App_Slot_Start_Addr[GetUpdateSlot()]) {		//if we have written anything into the update slot
+				  if (AppSlotValid(GetUpdateSlot()) == Yes) {
+#ifdef image_signed
+					  Update_Auth_Pending = Yes;										//the slot is only switched once the tag checks out (0xbe)
+					  BootLogInfo(LogTok_Auth_pending);
+#else
+					  SwitchAppSlot(GetUpdateSlot());									//one word in EEPROM: from the next boot, we run the new app (on trial)
+#endif
+				  } else {
+					  BootLogError(LogTok_Slot_not_valid, GetUpdateSlot());				//the running app stays active
+				  }
+			  } else {
+				  //do nothing
+			  }
+
+			  flash_page_addr = App_Slot_Start_Addr[GetUpdateSlot()];					//we move the flash pointer to the start of the update slot for additional updates
+			  Update_Byte_Swap = No;													//session options are for one session only
+			  memset(Rx_Message_buf, 0, sizeof(Rx_Message_buf));						//we wipe the UART buffer
+#ifdef irq_latency_probe
+			  BootTIM22_DEINT();														//the latency probe only runs on the PLL
+#endif
+			  SysClockProfile(Clock_Profile_MSI);										//we go back to idling on MSI
+			  BootLinkResume();															//we re-enable the UART1 without DMA
 
 		  } else if (UART1_Message_Received == No){										//if the bus is not idle
 
-			  switch (Machine_Code_Page_Received) {										//we check if we are at the first or the second part of the 64 word long Rx buffer
+			  switch (Machine_Code_Page_Received) {										//we check if we are at the first or the second part of the Rx buffer
 
 			  case First:																//if we are in the front - triggered by the DMA halfway point
-				  UpdatePageInApp(flash_page_addr, 0);									//we pass the address as well as from where in the buffer we intend to read the data
-				  flash_page_addr = flash_page_addr + 0x80;								//we step the page address by one page
-				  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	//Note: we select the page to process on this level
+				  SessionRxHalfToFLASH(First, Dev_Rx_half_pages);
 				  Machine_Code_Page_Received = None;									//we remove the page detection flag
 				  break;
 
-				  //Note: the FLASH copying MUST ALWAYS BE faster than the data reception!
-
 			  case Second:																//if we are in the back - triggered by the DMA TC point
-				  UpdatePageInApp(flash_page_addr, 1);
-				  flash_page_addr = flash_page_addr + 0x80;								//we step the page address by one page
+				  SessionRxHalfToFLASH(Second, Dev_Rx_half_pages);
 				  Machine_Code_Page_Received = None;									//we remove the page detection flag
 
 				  //Note: there is a small delay between the page_received flag (being "first" or "second") and the "message received" flag being "yes".
@@ -141,3 +529,202 @@ void UART1_External_Boot_Controller (void) {
 		  //do nothing
 	  }
 }
+
+
+//2)Programmer mode entry
+static void UART1ProgrammerModeEnter(void) {
+	/*
+	 * Switches the UART1 from command reception to DMA-driven machine code reception.
+	 * flash_page_addr must be set before calling this.
+	 *
+	 * */
+
+	memset(Rx_Message_buf, 0, sizeof(Rx_Message_buf));									//wipe the buffer
+
+	BootLinkDeinit();																	//we completely deinitialize the UART1
+
+	SysClockProfile(Clock_Profile_PLL);													//programming needs every cycle we have
+																						//Note: the UART1 is off, so the BRR can be changed safely
+
+	BootAuthStart();																	//a new tag for every session (image_signed)
+	BootAuthFLASH(App_Slot_Start_Addr[GetUpdateSlot()], flash_page_addr - App_Slot_Start_Addr[GetUpdateSlot()]);	//a resumed update brings the pages of the earlier sessions in first
+#ifdef image_signed
+	Update_Auth_Pending = No;
+#endif
+
+	BootLinkDMAStart();																	//DMA channel reconfig - necessary after DMA shut off to ensure functionality
+																						//Note: transfer width is the whole Rx buffer - 256 bytes, which is 2 pages of FLASH on the L053
+																						//we activate the DMA and the idle detection UART IRQ
+																						//capture the incoming machine code (Dev_Rx_buf_words) with DMA
+																						//here we want to have the DMA running and using the IRQs (for starters, only the TC IRQ to generate a flag)
+
+	memset(&Session_Stats, 0, sizeof(Session_Stats));									//the statistics and the line errors are counted per session
+	Session_Stats.min_slack_bytes = Dev_Rx_half_size;
+	Session_Time_Stamp = TIM6->CNT;														//Note: after the clock profile switch - that reloads the TIM6
+#ifdef irq_latency_probe
+	memset(&IRQ_Latency, 0, sizeof(IRQ_Latency));										//the latency is measured per session, like the statistics
+#ifdef ram_update_path
+	IRQ_Latency.update_path_in_ram = 1;
+#endif
+	BootTIM22_INT();																	//Note: after the clock profile switch - the TIM22 prescaler is set for the PLL
+#endif
+	UART1_Line_Error_Hit = No;
+	Session_Pages_Accepted = 0;
+
+	UART1_DMA_active = Yes;
+
+	BootLogInfo(LogTok_Awaiting_machine_code);
+}
+
+
+//3)Command addressing
+uint8_t* UART1CommandForThisNode(void) {
+	/*
+	 * Returns where the command is in the Rx buffer, or NULL if the frame is not for us.
+	 *
+	 * Plain frames are 0xF0 0xF0 command payload. Addressed frames are 0xF0 0xF0 0xAD target command payload.
+	 * The target is a node address (0x00-0xDF), a group (0xE0 + group number) or all nodes (0xFF).
+	 *
+	 * 1)Plain frame: it is for us. On an RS-485 bus (uart1_rs485), plain frames are ignored: they are most likely replies of other nodes.
+	 * 2)Addressed frame: we check the target against our node record
+	 * 3)Replies are only allowed if the frame was for this node alone
+	 * 4)If another node is about to receive an image, we become a bystander for the session
+	 *
+	 * Note: a bystander runs the programmer mode without writing anything. This keeps us from reading the image as commands.
+	 *
+	 * */
+
+	uint8_t* command_ptr = (uint8_t*)Rx_Message_buf;
+	uint32_t node_record = ReadNodeRecord();
+	Update_Bystander = No;
+	uint8_t node_addr = node_record & 0xFF;
+	uint8_t node_group = (node_record >> 8) & 0xFF;
+
+	//1)
+	if (command_ptr[0] != Cmd_addressed_frame) {
+#ifdef uart1_rs485
+		return NULL;
+#else
+		UART1_Reply_Enabled = Yes;
+		return command_ptr;
+#endif
+	} else {
+		//do nothing
+	}
+
+	//2)
+	uint8_t target = command_ptr[1];
+	if (target == node_addr) {
+		UART1_Reply_Enabled = Yes;													//3)
+	} else if ((target == Target_all_nodes) || ((target >= Target_group_base) && ((target - Target_group_base) == node_group))) {
+		UART1_Reply_Enabled = No;
+	} else {
+		//4)
+		if ((command_ptr[2] == 0xbb) || (command_ptr[2] == 0xb6)) {
+			UART1_Reply_Enabled = No;
+			Update_Bystander = Yes;
+		} else {
+			//do nothing
+		}
+		return NULL;
+	}
+
+	return &command_ptr[2];
+}
+
+
+//4)Session report
+static void SessionReportSend(void) {
+	/*
+	 * The number of pages of the last session (2 bytes), then the overrun, framing, noise and parity errors (2 bytes each).
+	 *
+	 * */
+
+	uint8_t session_report[10];
+	memcpy(&session_report[0], &Last_Session_Page_Cnt, 2);
+	memcpy(&session_report[2], &Last_Session_Stats.line_errors, 8);						//the struct is 4 times 16 bits, no padding
+	BootLinkTxReply(0xbf, session_report, 10);
+}
+
+
+
+//5)Session statistics
+static void SessionStatsTick(void) {
+	/*
+	 * Adds the time since the last tick to the session time. Called on every pass of the programmer mode loop.
+	 *
+	 * Note: TIM6 runs on 1 MHz and wraps on 16 bits, so the loop must come around within 65 ms. The longest pass is a page write of around 10 ms.
+	 *
+	 * */
+
+	uint16_t time_stamp = TIM6->CNT;
+	Session_Stats.session_time_us += (uint16_t) (time_stamp - Session_Time_Stamp);
+	Session_Time_Stamp = time_stamp;
+}
+
+
+static void SessionStatsPageDone(enum_First_Second_Selector written_half) {
+	/*
+	 * Buffer slack: once a half is in the FLASH, how much of the other half of the ping-pong buffer is still free.
+	 * This is how much more the host could have sent before we would have lost data. 0 means that the DMA has already moved on to the half we have just written.
+	 *
+	 * */
+
+	uint16_t rx_remaining = BootLinkRxDMARemaining();									//bytes until the end of the Rx buffer
+	uint16_t slack;
+
+	if (written_half == First) {
+		slack = (rx_remaining <= Dev_Rx_half_size) ? rx_remaining : 0;					//the DMA must still be in the second half
+	} else {
+		slack = (rx_remaining > Dev_Rx_half_size) ? (rx_remaining - Dev_Rx_half_size) : 0;	//the DMA must be in the first half
+	}
+
+	if (slack < Session_Stats.min_slack_bytes) Session_Stats.min_slack_bytes = slack;
+}
+
+
+//6)Pages of the Rx buffer into the FLASH
+static void SessionRxHalfToFLASH(enum_First_Second_Selector rx_half, uint8_t page_cnt) {
+	/*
+	 * Takes the pages of one half of the ping-pong buffer into the FLASH, one after the other.
+	 * page_cnt is Dev_Rx_half_pages, except for the last, partly filled half of a session.
+	 *
+	 * 1)Decrypt, swap and hash the page in the buffer, then write it
+	 * 2)Step the page address - skipped pages too
+	 * 3)Release the host once the whole half is free again
+	 *
+	 * Note: the FLASH copying MUST ALWAYS BE faster than the data reception!
+	 * Note: the host is only released after the last page of the half - the DMA would otherwise refill the pages we are still writing.
+	 *
+	 * */
+
+	uint8_t first_page_in_buf = (rx_half == First) ? 0 : Dev_Rx_half_pages;
+	enum_Yes_No_Selector half_written = No;
+
+	for (uint8_t page_in_half = 0; page_in_half < page_cnt; page_in_half++) {
+		uint8_t page_in_buf = first_page_in_buf + page_in_half;
+		uint32_t* page_ptr = &Rx_Message_buf[Dev_page_words * page_in_buf];
+
+		//1)
+		if (UART1_Line_Error_Hit == No) Session_Pages_Accepted++;					//the page is only good if no line error came before it
+		if ((Update_Bystander == No) && (UART1_Line_Error_Hit == No) && (flash_page_addr < (App_Slot_Start_Addr[GetUpdateSlot()] + App_Slot_Size))) {	//we never write past the end of the update slot - that would be the running app or outside the FLASH
+			BootLinkFlowHold();														//the FLASH is busy: the host pauses until the page is in (uart1_flow_control, SPI1 ready line)
+			BootCryptPage(page_ptr, flash_page_addr - App_Slot_Start_Addr[GetUpdateSlot()]);	//decrypted in place, the rest only ever sees the plain image (image_encrypted)
+			if (Update_Byte_Swap == Yes) FLASHSwap_Page(page_ptr);					//big-endian image: from here on, the page is what goes into the FLASH
+			BootAuthPage(page_ptr);													//the page goes into the tag of the image before it goes into the FLASH (image_signed)
+			UpdatePageInApp(flash_page_addr, page_in_buf);							//we pass the address as well as from where in the buffer we intend to read the data
+			if (Update_Resumable == Yes) CommitUpdateProgress(flash_page_addr);		//the page is in, we move the resume point
+			Session_Stats.pages_written++;
+			half_written = Yes;
+		} else {
+			Session_Stats.pages_skipped++;
+		}
+
+		//2)
+		flash_page_addr = flash_page_addr + Update_Page_Size;						//we step the page address by one page
+	}
+
+	//3)
+	if (half_written == Yes) SessionStatsPageDone(rx_half);						//how close the host came to overrunning the buffer
+	BootLinkFlowRelease();															//Note: the SPI1 DMA IRQ holds the master after every page, so we release bystander pages too
+}
@@ -15,20 +15,41 @@
 
 #include "main.h"
 #include "BootAppManager.h"
+#include "BootClockDriver_STM32L0x3.h"
+#include "BootUARTDriver_STM32L0x3.h"
+#include "BootLink.h"
+#include "BootTrace.h"
+#include "BootImageAuth.h"
+#include "BootImageCrypt.h"
+#include "BootBench.h"
+#include "string.h"
 
 //LOCAL CONSTANT
+#define Cmd_addressed_frame		0xAD												//first byte of an addressed frame, followed by the target
+#define Target_group_base		0xE0												//targets from here are groups
+#define Target_all_nodes		0xFF
+#define Session_Opt_Byte_Swap	0x01												//0xb1: the words of the next image are big-endian
+#define Verify_max_pages		62													//page CRCs that fit into one command: (256 byte buffer - 1 command - 4 address - 1 count) / 4
 
 //LOCAL VARIABLE
 
 //EXTERNAL VARIABLE
-extern uint32_t Rx_Message_buf [64];
+extern uint32_t Rx_Message_buf [Dev_Rx_buf_words];
 extern enum_Yes_No_Selector UART1_DMA_active;
 extern enum_Yes_No_Selector UART1_Message_Received;
-extern uint8_t page_counter;
+extern uint16_t DMA_transfer_width_UART1;
 extern enum_First_Second_Selector Machine_Code_Page_Received;
 extern uint32_t flash_page_addr;
+extern enum_Yes_No_Selector Update_Resumable;
+extern enum_Yes_No_Selector Update_Byte_Swap;
+extern uint16_t Last_Session_Page_Cnt;
+extern struct_Session_Stats Session_Stats;
+extern struct_Session_Stats Last_Session_Stats;
+extern struct_IRQ_Latency IRQ_Latency;
+extern enum_Yes_No_Selector Update_Bystander;
 
 //FUNCTION PROTOTYPES
 void UART1_External_Boot_Controller (void);
+uint8_t* UART1CommandForThisNode(void);
 
 #endif /* INC_EXTERNALCONTROLLER_CUSTOM_H_ */
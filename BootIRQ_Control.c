@@ -3,7 +3,7 @@
  *  Author: BalazsFarkas
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
- *  Program version: 1.0
+ *  Program version: 1.10
  *  File: BootIRQ_Control_STM32L0x3.c
  *  Modified from: N/A
  *  Change history:
@@ -17,15 +17,63 @@
  * DMA IRQ for the UART1 Rx on channel 3.
  * Added TIM2 timer interrupt to count seconds.
  *
+ * v.1.1
+ * Added DMA IRQ for the UART2 Tx on channel 4 (log output).
+ * UART1 IRQ also receives the command bytes (RXNE) so the main loop does not need to poll.
+ * Added LPTIM1 IRQ to count seconds in Stop mode.
+ *
+ * v.1.2
+ * Every page received by the DMA resets the idle frame counter. Gaps between pages no longer end the programming session.
+ *
+ * v.1.3
+ * LPTIM1 IRQ also times the probation of a new UART1 baud rate in external controller mode.
+ *
+ * v.1.4
+ * A new page while the previous one is still waiting for the FLASH holds the host (RTS, uart1_flow_control).
+ *
+ * v.1.5
+ * SPI1 transport (spi1_transport): DMA IRQ on the SPI1 Rx (channel 2) and the NSS rising edge IRQ on EXTI line 15.
+ *
+ * v.1.6
+ * UART1 IRQ catches the overrun, framing, noise and parity errors (see UART1LineError).
+ *
+ * v.1.7
+ * Trace points on the DMA IRQ of the UART1/SPI1 Rx and on the UART1 IRQ (boot_trace).
+ *
+ * v.1.8
+ * The boot window length comes from the boot config.
+ *
+ * v.1.9
+ * RAM update path (ram_update_path): the UART1/SPI1 Rx IRQs and everything they call run from RAM, the vector table is copied to RAM.
+ * Erasing or programming the FLASH stalls every fetch from it - a handler in FLASH waits out the whole operation (roughly 3.2 ms), and so does the DMA that fills the Rx buffer behind it.
+ * With the RAM path, the Rx IRQs are served while the FLASH is busy. The IRQs that stay in FLASH are masked by the NVM driver for as long as it is busy (see BootNVMDriver_STM32L0x3.c).
+ * Added the TIM22 latency probe (irq_latency_probe).
+ *
+ * Note: only what runs while the FLASH is busy is in RAM. UART1RxCommandByte and SPI1TransactionEnd are only called outside programmer mode, the log and the error paths (BootLogError) are left in FLASH - they merely stall.
+ * Note: no division, switch table or other libgcc helper may be used in the RAM functions - those are in FLASH.
+ *
+ * v.1.10
+ * The UART1 DMA IRQ comes once per half of the Rx buffer, which may be more than one page (Dev_Rx_half_pages). The page count of the session follows.
+ * The vector table size is taken from the device traits.
+ *
  */
 
 #include "BootClockDriver_STM32L0x3.h"
 #include "BootIRQ_Control.h"
+#include "BootLogDriver_STM32L0x3.h"
+#include "BootLogTokens.h"
+#include "BootUARTDriver_STM32L0x3.h"
+#include "BootLink.h"
+#include "BootTrace.h"
 #include "main.h"
 #include "stdio.h"
 
+#ifdef ram_update_path
+static uint32_t Vector_table_RAM[Vector_table_size] __attribute__((aligned(256)));
+#endif
+
 //1) DMA IRQ on UART1
-void DMA1_Channel2_3_IRQHandler (void){
+__RAM_UPDATE_PATH void DMA1_Channel2_3_IRQHandler (void){
 	/*
 	 * IRQ activated on half transmission, full transmission and error.
 	 *
@@ -34,8 +82,32 @@ void DMA1_Channel2_3_IRQHandler (void){
 	 * 3)We reset the IRQ.
 	 *
 	 * Note: we want an indifferent FLASH loader, not one that is not controlled differently depending on if we are at the halfway or end point.
+	 * Note: with "spi1_transport", the Rx is on channel 2 in circular mode and every page holds the master (ready line LOW) until it is in the FLASH.
 	 *
 	 * */
+	BootTraceEnter(TracePt_DMA_IRQ);
+#ifdef spi1_transport
+	if ((DMA1->ISR & (1<<6)) == (1<<6)) {										//if we had the half transmission triggered
+		Machine_Code_Page_Received = First;
+	} else if ((DMA1->ISR & (1<<5)) == (1<<5)) {								//if we had full transmission triggered
+		Machine_Code_Page_Received = Second;									//circular mode: the DMA is already back at the start of the buffer
+	} else if ((DMA1->ISR & (1<<7)) == (1<<7)){									//if we had an error
+		BootLogError(LogTok_DMA_error);
+		while(1);
+	} else {
+		//do nothing
+	}
+	SPI1ReadyLow();																//the master waits until the external controller is done with the page
+	Session_Stats.pages_received++;
+	Idle_frame_counter = 0;														//same as on the UART1: the session ends on two transactions without a page
+	DMA1->IFCR |= (1<<4);														//we remove all the interrupt flags from Channel 2
+#else
+	if (Machine_Code_Page_Received != None) {									//both halves of the Rx buffer are full: the host must stop before the DMA wraps around
+		BootLinkFlowHold();														//released once the FLASH is done (uart1_flow_control)
+	} else {
+		//do nothing
+	}
+
 	if ((DMA1->ISR & (1<<10)) == (1<<10)) {										//if we had the half transmission triggered
 		Machine_Code_Page_Received = First;
 	} else if ((DMA1->ISR & (1<<9)) == (1<<9)) {								//if we had full transmission triggered
@@ -52,46 +124,78 @@ void DMA1_Channel2_3_IRQHandler (void){
 		USART1->CR1 |= (1<<0);													//we re-enable the UART1
 
 	} else if ((DMA1->ISR & (1<<11)) == (1<<11)){								//if we had an error
-		printf("DMA transmission error!");
+		BootLogError(LogTok_DMA_error);
 		while(1);
 	} else {
 		//do nothing
 	}
-	page_counter++;																//we count, how many times the IRQ is engaged (and thus count the number of pages we are updating)
+	Session_Stats.pages_received += Dev_Rx_half_pages;							//we count, how many times the IRQ is engaged (and thus count the number of pages we are updating)
+	Idle_frame_counter = 0;														//an idle frame between two pages is pacing from the host, not the end of the session
+																				//Note: the session ends on two idle frames without a full page in between (end of data, then one filler byte)
 	DMA1->IFCR |= (1<<8);														//we remove all the interrupt flags from Channel 3
-
+#endif
+	BootTraceExit(TracePt_DMA_IRQ);
 }
 
 
 //2) UART1 IRQ
-void USART1_IRQHandler(void) {
+__RAM_UPDATE_PATH void USART1_IRQHandler(void) {
 	/*
-	 * This IRQ currently only activates on the detection of an idle frame.
+	 * This IRQ activates on incoming bytes (command mode only) and on the detection of an idle frame.
+	 * In command mode, every byte is passed to the UART driver, which looks for the start sequence and fills the Rx buffer.
 	 * Idle frames are the indicators that we don't have incoming data anymore.
 	 *
 	 * Note: since we are parallel receiving data AND doing other stuff, we MUST leave some time for any concurrent process to activate or conclude.
 	 * Note: with an idle frame counter set to 2, we have a delay of roughly 1 ms.
+	 * Note: in programmer mode, RXNEIE is off and the DMA reads the RDR.
+	 * Note: idle frames before the start sequence (noise, stray bytes) are discarded.
+	 * Note: line errors are handled first, so a broken byte never makes it into a command.
 	 */
 
-	Idle_frame_counter++;
-	if(Idle_frame_counter >=2){
-		UART1_Message_Received = Yes;
-		Idle_frame_counter = 0;
+	BootTraceEnter(TracePt_UART1_IRQ);
+
+	uint32_t line_error_flags = USART1->ISR & 0xF;								//PE, FE, NF and ORE
+	if (line_error_flags != 0) {
+		UART1LineError(line_error_flags);
+	} else {
+		//do nothing
+	}
+
+	if ((USART1->ISR & (1<<20)) == (1<<20)) {									//if we woke up from Stop mode on a start bit
+		USART1->ICR |= (1<<20);													//wake-up flag clearing - the byte itself comes with the RXNE
+	}
+
+	if (((USART1->CR1 & (1<<5)) == (1<<5)) && ((USART1->ISR & (1<<5)) == (1<<5))) {	//if RXNEIE is on and we have a byte in the RDR
+		UART1RxCommandByte(USART1->RDR);										//reading the RDR clears the RXNE flag
+	}
+
+	if ((USART1->ISR & (1<<4)) == (1<<4)) {										//if we had an idle frame
+		if ((UART1_Message_Started == Yes) || (UART1_DMA_active == Yes)) {
+			Idle_frame_counter++;
+			if(Idle_frame_counter >=2){
+				UART1_Message_Received = Yes;
+				Idle_frame_counter = 0;
+			}
+		} else {
+			//do nothing
+		}
+		USART1->ICR |= (1<<4);													//Idle detect flag clearing
 	}
-	USART1->ICR |= (1<<4);														//Idle detect flag clearing
+
+	BootTraceExit(TracePt_UART1_IRQ);
 }
 
 //3) TIM2 IRQ
 void TIM2_IRQHandler(void) {
 
-	  if (seconds_counter >= Boot_transit_in_sec) {
+	  if (seconds_counter >= Boot_Config.boot_window_sec) {
 
-		printf("De-initializing bootloader drivers...\r\n");
-		UART1Deinit();													//we deinit the UART1 driver
+		BootLogInfo(LogTok_Deinit_drivers);
+		BootLinkDeinit();												//we deinit the UART1 driver
 		BootTIM2_DEINT();												//we deinit the TIM2 driver
 																				//Note: it is highyl recommended to deinit all drivers before jumping to the app
 		seconds_counter = 0;
-		printf("Jumping to app...\r\n");
+		BootLogInfo(LogTok_Jumping_to_app);
 	  	GoToApp();																//jumping to the app should unblock the micro from waiting for a reply
 
 	  }
@@ -119,3 +223,168 @@ void BootTIM2IRQPriorEnable(void) {
 	NVIC_SetPriority(TIM2_IRQn, 1);												//IRQ priority for channel 2 & 3
 	NVIC_EnableIRQ(TIM2_IRQn);													//IRQ enable for channel 2 & 3
 }
+
+
+//7) DMA IRQ on UART2 (log)
+void DMA1_Channel4_5_6_7_IRQHandler (void){
+	/*
+	 * IRQ activated when a chunk of the log ring buffer has been sent out.
+	 * Only channel 4 is in use on this IRQ line.
+	 *
+	 * */
+	if ((DMA1->ISR & (1<<13)) == (1<<13)) {										//if we had full transmission triggered on channel 4
+		DMA1->IFCR |= (1<<12);													//we remove all the interrupt flags from Channel 4
+		BootLogDMAComplete();
+	} else {
+		DMA1->IFCR |= (1<<12);
+	}
+}
+
+//8)Log DMA IRQ priority
+//Note: the log is the least important thing the bootloader does
+void BootLogDMAIRQPriorEnable(void) {
+	NVIC_SetPriority(DMA1_Channel4_5_6_7_IRQn, 3);								//IRQ priority for channel 4 to 7
+																				//Note: enable is done in the log driver init
+}
+
+
+//9) LPTIM1 IRQ
+//Note: this is the TIM2 IRQ for the Stop mode boot window (boot_wait_stop_mode)
+//Note: in external controller mode, LPTIM1 times the probation of a new UART1 baud rate instead
+void LPTIM1_IRQHandler(void) {
+
+	  if (UART1_Baud_Probation == Yes) {
+		seconds_counter++;
+		if (seconds_counter >= UART1_baud_probation_in_sec) {
+			UART1BaudProbationEnd(No);											//no frame came through on the new rate: we go back to the old one
+		} else {
+			//do nothing
+		}
+
+	  } else if (seconds_counter >= Boot_Config.boot_window_sec) {
+
+		BootLogInfo(LogTok_Deinit_drivers);
+		BootLinkDeinit();														//we deinit the UART1 driver
+		BootLPTIM1_DEINT();														//we deinit the LPTIM1 driver
+		seconds_counter = 0;
+		BootLogInfo(LogTok_Jumping_to_app);
+	  	GoToApp();																//jumping to the app should unblock the micro from waiting for a reply
+
+	  } else {
+		seconds_counter++;
+	  }
+
+	  LPTIM1->ICR |= (1<<1);													//we reset the IRQ
+}
+
+//10)LPTIM1 IRQ priority
+void BootLPTIM1IRQPriorEnable(void) {
+	NVIC_SetPriority(LPTIM1_IRQn, 1);											//same priority as TIM2
+	NVIC_EnableIRQ(LPTIM1_IRQn);
+}
+
+
+//11) EXTI4_15 IRQ
+//Note: only line 15 (SPI1 NSS, spi1_transport) is handled, the other lines are cleared and dropped
+__RAM_UPDATE_PATH void EXTI4_15_IRQHandler(void) {
+	/*
+	 * The NSS rising edge is the SPI1 version of the UART1 idle frame: the master is done with a transaction.
+	 *
+	 * 1)In programmer mode, we count transactions without a page in between - two of them end the session
+	 * 2)Otherwise, the SPI1 driver checks what the transaction was
+	 *
+	 * */
+
+	uint32_t exti_pending = EXTI->PR & 0xFFF0;
+
+	EXTI->PR = exti_pending;													//writing 1 clears the pending bits
+
+	if ((exti_pending & (1<<15)) == (1<<15)) {
+		if (UART1_DMA_active == Yes) {
+			Idle_frame_counter++;
+			if(Idle_frame_counter >=2){
+				UART1_Message_Received = Yes;
+				Idle_frame_counter = 0;
+			}
+		} else {
+			SPI1TransactionEnd();
+		}
+	} else {
+		//do nothing
+	}
+}
+
+//12)SPI1 NSS IRQ priority
+void SPI1IRQPriorEnable(void) {
+	NVIC_SetPriority(EXTI4_15_IRQn, 2);											//same priority as the UART1
+																				//Note: enable is done in the SPI1 driver when we expect a transaction
+}
+
+
+#ifdef ram_update_path
+//13)Vector table in RAM
+void BootVectorTableRAM(void) {
+	/*
+	 * The handlers marked with __RAM_UPDATE_PATH are already in RAM, the vector table still points to them from the FLASH.
+	 * A vector fetch from the FLASH stalls the IRQ entry the same way the handler would, so the table is copied to RAM and VTOR is moved to the copy.
+	 *
+	 * 1)Copy the table of the bootloader
+	 * 2)Point VTOR at the copy
+	 *
+	 * Note: VTOR needs the table aligned to its size, rounded up to a power of 2 (48 words -> 256 bytes).
+	 * Note: the app must set VTOR in its SystemInit (see BootAppManager.h), so the RAM table is never used after the jump.
+	 *
+	 * */
+
+	//1)
+	__disable_irq();
+	for (uint8_t i = 0; i < Vector_table_size; i++) {
+		Vector_table_RAM[i] = *(__IO uint32_t*)(FLASH_BASE + (4 * i));
+	}
+
+	//2)
+	SCB->VTOR = (uint32_t)Vector_table_RAM;
+	__DSB();
+	__enable_irq();
+}
+#endif
+
+
+#ifdef irq_latency_probe
+//14)TIM22 IRQ - latency probe
+__RAM_UPDATE_PATH void TIM22_IRQHandler(void) {
+	/*
+	 * TIM22 counts at 1 MHz from 0 after every overflow. The counter at the start of the IRQ is how long the IRQ had to wait, in us.
+	 * This includes the exception entry (16 cycles, 0.5 us on the PLL).
+	 *
+	 * 1)Read the counter first
+	 * 2)Sample count, max and histogram
+	 *
+	 * Note: the period is 10 ms, longer than any NVM operation. A longer wait would wrap the counter and be counted short.
+	 * Note: with ram_update_path, the probe is in RAM like the Rx IRQs and has the same priority as the UART1 IRQ - it sees what they see.
+	 *
+	 * */
+
+	//1)
+	uint16_t latency_us = TIM22->CNT;
+	TIM22->SR &= ~(1<<0);														//we reset the IRQ
+
+	//2)
+	uint8_t bucket = 0;
+	for (uint16_t latency_bits = latency_us; latency_bits != 0; latency_bits >>= 1) {
+		bucket++;																//no CLZ on the M0+ and no libgcc from RAM
+	}
+	if (bucket >= IRQ_latency_buckets) bucket = IRQ_latency_buckets - 1;
+
+	IRQ_Latency.samples++;
+	if (IRQ_Latency.histogram[bucket] != 0xFFFF) IRQ_Latency.histogram[bucket]++;
+	if (latency_us > IRQ_Latency.max_us) IRQ_Latency.max_us = latency_us;
+}
+
+
+//15)TIM22 IRQ priority
+void BootTIM22IRQPriorEnable(void) {
+	NVIC_SetPriority(TIM22_IRQn, 2);											//same priority as the UART1
+																				//Note: enable is done when the probe is started
+}
+#endif
@@ -15,10 +15,10 @@
 #include "stdint.h"
 #include "string.h"
 #include "main.h"
-#include "stm32l053xx.h"
+#include "stm32l0xx.h"
 
 //LOCAL CONSTANT
-static const uint8_t Boot_transit_in_sec = 5;								//defines how many TIM2 IRQs we wait before leaving the bootloader
+#define Vector_table_size				Dev_vector_table_words						//16 system vectors and 32 IRQs
 
 //LOCAL VARIABLE
 static uint8_t Idle_frame_counter = 0;
@@ -26,14 +26,22 @@ static uint8_t Idle_frame_counter = 0;
 //EXTERNAL VARIABLE
 extern enum_Yes_No_Selector UART1_Message_Received;
 extern enum_Yes_No_Selector UART1_Message_Started;
+extern enum_Yes_No_Selector UART1_DMA_active;
 extern enum_First_Second_Selector Machine_Code_Page_Received;
 extern uint16_t DMA_transfer_width_UART1;
-extern uint8_t page_counter;
+extern struct_Session_Stats Session_Stats;
 extern uint8_t seconds_counter;
+extern struct_IRQ_Latency IRQ_Latency;
+extern struct_Boot_Config Boot_Config;										//boot_window_sec defines how many TIM2 IRQs we wait before leaving the bootloader
 
 //FUNCTION PROTOTYPES
 void UART1IRQPriorEnable(void);
 void BootDMAIRQPriorEnable(void);
 void BootTIM2IRQPriorEnable(void);
+void BootLogDMAIRQPriorEnable(void);
+void BootLPTIM1IRQPriorEnable(void);
+void SPI1IRQPriorEnable(void);
+void BootVectorTableRAM(void);
+void BootTIM22IRQPriorEnable(void);
 
 #endif /* INC_BOOTIRQ_CONTROL_CUSTOM_H_ */
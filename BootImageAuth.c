@@ -0,0 +1,117 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.2
+ *  File: BootImageAuth.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds the image authentication of the bootloader (image_signed).
+ *
+ * v.1.0
+ * The tag of an image is its HMAC-SHA256 with the key below. It is computed page by page while the image comes in, right before the page goes into the FLASH.
+ * A page is 2 SHA-256 blocks, which is far less than the erase and the half-page writes that come after it. The session statistics (min slack) and the trace (boot_trace) show what is left.
+ * A resumed update hashes the pages already in the FLASH first, so the tag is always over the whole image.
+ * 0xb4 times the hash on a block of FLASH, so the cycles per byte can be checked on the part (see HostTools/BootSign.c).
+ *
+ * Note: HMAC is symmetric - the key is in the bootloader section, so the bootloader must be read protected (RDP level 1) for this to mean anything.
+ * Note: the key below is a development key. Every product must have its own.
+ *
+ * v.1.1
+ * The page length comes from the device traits.
+ *
+ * v.1.2
+ * The benchmark only hashes. Timing and reply are in BootBench.c, shared with the decryption benchmark.
+ *
+ */
+
+#include "BootImageAuth.h"
+
+#ifdef image_signed
+
+#include "BootTrace.h"
+#include "BootAppManager.h"
+
+//development key - replace it, and keep it out of the repository for real products
+//Note: "bootsign -k" takes the same 32 bytes as a binary file
+static const uint8_t Auth_key[HMAC_key_size] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+};
+
+static struct_SHA256_Ctx Auth_ctx;
+static enum_Yes_No_Selector Auth_started = No;
+
+
+//1)Start the tag of a new image
+void BootAuthStart(void) {
+	HMACSHA256Start(&Auth_ctx, Auth_key);
+	Auth_started = Yes;
+}
+
+
+//2)Add a page from the Rx buffer
+void BootAuthPage(const uint32_t* page_ptr) {
+	/*
+	 * Called with the half of the ping-pong buffer that is about to go into the FLASH.
+	 * The buffer is word aligned, so SHA256Compress reads the words with REV and nothing is copied.
+	 *
+	 * */
+
+	BootTraceEnter(TracePt_Auth_page);
+	SHA256Update(&Auth_ctx, (const uint8_t*)page_ptr, Dev_page_size);
+	BootTraceExit(TracePt_Auth_page);
+}
+
+
+//3)Add what is already in the FLASH
+//Note: for resumed updates - the pages before the resume point came in an earlier session
+void BootAuthFLASH(uint32_t flash_addr, uint32_t flash_len) {
+	SHA256Update(&Auth_ctx, (const uint8_t*)flash_addr, flash_len);
+}
+
+
+//4)Check the tag from the host
+enum_Yes_No_Selector BootAuthCheck(const uint8_t* host_tag) {
+	/*
+	 * 1)Finish the tag - this can only be done once per image
+	 * 2)Compare all 32 bytes, no early exit: the time of the compare must not tell how many bytes were right
+	 *
+	 * */
+
+	uint8_t image_tag[SHA256_digest_size];
+	uint8_t tag_diff = 0;
+
+	//1)
+	if (Auth_started == No) return No;
+	Auth_started = No;
+	HMACSHA256Finish(&Auth_ctx, Auth_key, image_tag);
+
+	//2)
+	for (uint8_t i = 0; i < SHA256_digest_size; i++) {
+		tag_diff |= image_tag[i] ^ host_tag[i];
+	}
+
+	return (tag_diff == 0) ? Yes : No;
+}
+
+
+//5)Hash benchmark - the work of 0xb4, timed by BootBenchRun
+uint8_t BootAuthBench(uint16_t bench_len, uint8_t* result_ptr) {
+	/*
+	 * Hashes bench_len bytes from the start of the app section (plain SHA-256). The digest is the result (32 bytes).
+	 * The host checks it against its own SHA-256 of the same block (read back with 0xb7).
+	 *
+	 * */
+
+	struct_SHA256_Ctx bench_ctx;
+
+	SHA256Init(&bench_ctx);
+	SHA256Update(&bench_ctx, (const uint8_t*)App_Section_Start_Addr, bench_len);
+	SHA256Final(&bench_ctx, result_ptr);
+	return SHA256_digest_size;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootImageAuth.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Image authentication of the bootloader (image_signed).
+ *
+ * Every page that goes into the FLASH is hashed on its way there. The slot is only switched once the host has sent the tag of the image (0xbe) and it matches.
+ * Without "image_signed", nothing here is compiled.
+ */
+
+#ifndef INC_BOOTIMAGEAUTH_H_
+#define INC_BOOTIMAGEAUTH_H_
+
+#include "stdint.h"
+#include "main.h"
+#include "BootSHA256.h"
+
+//LOCAL CONSTANT
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+
+//FUNCTION PROTOTYPES
+#ifdef image_signed
+void BootAuthStart(void);
+void BootAuthPage(const uint32_t* page_ptr);
+void BootAuthFLASH(uint32_t flash_addr, uint32_t flash_len);
+enum_Yes_No_Selector BootAuthCheck(const uint8_t* host_tag);
+uint8_t BootAuthBench(uint16_t bench_len, uint8_t* result_ptr);
+#else
+#define BootAuthStart()							do {} while (0)
+#define BootAuthPage(page_ptr)					do {} while (0)
+#define BootAuthFLASH(flash_addr, flash_len)	do {} while (0)
+#endif
+
+#endif /* INC_BOOTIMAGEAUTH_H_ */
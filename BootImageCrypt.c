@@ -0,0 +1,94 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.2
+ *  File: BootImageCrypt.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds the image decryption of the bootloader (image_encrypted).
+ *
+ * v.1.0
+ * The host encrypts the image with AES-128 in CTR mode (see HostTools/BootCrypt.c). The counter block is a 12 byte nonce, then the index of the 16 byte block in the image.
+ * The nonce is new for every encrypted image and comes with 0xb3 before the update starts. Every update needs its own 0xb3.
+ * Since the counter only depends on the position in the image, every page is decrypted on its own, in place, wherever the update starts - resumed updates included.
+ * 0xb2 times the decryption of a page, so the throughput can be checked against the link on the part (see HostTools/BootCrypt.c).
+ *
+ * Note: the STM32L053 has no AES peripheral (the L062/L063 have one), so this is software. The peripheral would go in BootCryptPage only.
+ * Note: the key is in the bootloader section, so the bootloader must be read protected (RDP level 1). The key below is a development key.
+ *
+ * v.1.1
+ * Page and bench page sizes from the device traits instead of 128 bytes.
+ *
+ * v.1.2
+ * The benchmark only decrypts. Timing and reply are in BootBench.c, shared with the hash benchmark.
+ *
+ */
+
+#include "BootImageCrypt.h"
+
+#ifdef image_encrypted
+
+#include "string.h"
+#include "BootTrace.h"
+
+//development key - same rules as Auth_key in BootImageAuth.c
+//Note: "bootcrypt -k" takes the same 16 bytes as a binary file
+static const uint8_t Crypt_key[AES_key_size] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+static struct_AES_Ctx Crypt_ctx;
+static uint8_t Crypt_counter_block[AES_block_size];
+static enum_Yes_No_Selector Crypt_nonce_new = No;
+
+
+//1)Nonce of the next image
+void BootCryptNonce(const uint8_t* nonce) {
+	AESKeyExpand(&Crypt_ctx, Crypt_key);												//every time - it is a few hundred cycles, and the round keys can't go stale
+	memcpy(Crypt_counter_block, nonce, Crypt_nonce_size);
+	memset(&Crypt_counter_block[Crypt_nonce_size], 0, AES_block_size - Crypt_nonce_size);
+	Crypt_nonce_new = Yes;
+}
+
+
+//2)Update start
+//Note: returns No if no nonce came since the last update - decrypting with an old nonce would only write garbage
+enum_Yes_No_Selector BootCryptStart(void) {
+	enum_Yes_No_Selector nonce_new = Crypt_nonce_new;
+	Crypt_nonce_new = No;
+	return nonce_new;
+}
+
+
+//3)Decrypt a page in the Rx buffer
+void BootCryptPage(uint32_t* page_ptr, uint32_t image_offset) {
+	BootTraceEnter(TracePt_Crypt_page);
+	AESCTRCrypt(&Crypt_ctx, Crypt_counter_block, image_offset / AES_block_size, (uint8_t*)page_ptr, Dev_page_size);
+	BootTraceExit(TracePt_Crypt_page);
+}
+
+
+//4)Decryption benchmark - the work of 0xb2, timed by BootBenchRun
+uint8_t BootCryptBench(uint16_t bench_len, uint8_t* result_ptr) {
+	/*
+	 * Decrypts a page on the stack over and over, bench_len bytes in total. There is no result, only the time.
+	 * The key stream does not depend on the data, so the page content doesn't matter.
+	 *
+	 * Note: the round keys are set up again first. That is a few hundred cycles, so it is left in the time.
+	 *
+	 * */
+
+	uint32_t bench_page[Dev_page_words] = {0};
+
+	(void) result_ptr;
+	AESKeyExpand(&Crypt_ctx, Crypt_key);
+	for (uint32_t done_len = 0; done_len < bench_len; done_len += Dev_page_size) {
+		AESCTRCrypt(&Crypt_ctx, Crypt_counter_block, done_len / AES_block_size, (uint8_t*)bench_page, Dev_page_size);
+	}
+	return 0;
+}
+
+#endif
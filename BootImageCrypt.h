@@ -0,0 +1,41 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootImageCrypt.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Image decryption of the bootloader (image_encrypted).
+ *
+ * The image comes in encrypted with AES-128 in CTR mode. Every page is decrypted in the Rx buffer, right before it is hashed (image_signed) and written into the FLASH.
+ * Without "image_encrypted", nothing here is compiled.
+ */
+
+#ifndef INC_BOOTIMAGECRYPT_H_
+#define INC_BOOTIMAGECRYPT_H_
+
+#include "stdint.h"
+#include "main.h"
+#include "BootAES.h"
+
+//LOCAL CONSTANT
+#define Crypt_nonce_size			12										//the last 4 bytes of the counter block are the block index in the image
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+
+//FUNCTION PROTOTYPES
+#ifdef image_encrypted
+void BootCryptNonce(const uint8_t* nonce);
+enum_Yes_No_Selector BootCryptStart(void);
+void BootCryptPage(uint32_t* page_ptr, uint32_t image_offset);
+uint8_t BootCryptBench(uint16_t bench_len, uint8_t* result_ptr);
+#else
+#define BootCryptPage(page_ptr, image_offset)	do {} while (0)
+#endif
+
+#endif /* INC_BOOTIMAGECRYPT_H_ */
@@ -0,0 +1,53 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootLink.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * The link towards the external controller: UART1 by default, SPI1 slave with "spi1_transport".
+ * The external controller and the IRQs only use these macros, so the command set is the same on both.
+ */
+
+#ifndef INC_BOOTLINK_H_
+#define INC_BOOTLINK_H_
+
+#include "main.h"
+#include "BootUARTDriver_STM32L0x3.h"
+#include "BootSPIDriver_STM32L0x3.h"
+#include "BootDMADriver_STM32L0x3.h"
+
+#ifdef spi1_transport
+
+#define BootLinkConfig()							SPI1Config()
+#define BootLinkIRQPriorEnable()					SPI1IRQPriorEnable()
+#define BootLinkRxMessage()							SPI1RxMessage()
+#define BootLinkTxReply(cmd, ptr, len)				SPI1TxReply(cmd, ptr, len)
+#define BootLinkTxStream(cmd, ptr, len)				SPI1TxStream(cmd, ptr, len)
+#define BootLinkDeinit()							SPI1Deinit()
+#define BootLinkDMAStart()							SPI1DMAEnable()
+#define BootLinkResume()							do {} while (0)						//SPI1RxMessage sets everything up again
+#define BootLinkFlowHold()							SPI1ReadyLow()
+#define BootLinkFlowRelease()						SPI1ReadyHigh()
+#define BootLinkRxDMARemaining()					(DMA1_Channel2->CNDTR)				//bytes until the end of the Rx buffer
+
+#else
+
+#define BootLinkConfig()							UART1Config()
+#define BootLinkIRQPriorEnable()					UART1IRQPriorEnable()
+#define BootLinkRxMessage()							UART1RxMessage()
+#define BootLinkTxReply(cmd, ptr, len)				UART1TxReply(cmd, ptr, len)
+#define BootLinkTxStream(cmd, ptr, len)				UART1TxStream(cmd, ptr, len)
+#define BootLinkDeinit()							UART1Deinit()
+#define BootLinkDMAStart()							do { DMAChannelUART1RxConfig(&Rx_Message_buf[0]); UART1DMAEnable(); } while (0)
+#define BootLinkResume()							do { USART1->CR1 |= (1<<0); } while (0)		//we re-enable the UART1 without DMA
+#define BootLinkFlowHold()							UART1FlowHold()
+#define BootLinkFlowRelease()						UART1FlowRelease()
+#define BootLinkRxDMARemaining()					(DMA1_Channel3->CNDTR)				//bytes until the end of the Rx buffer
+
+#endif
+
+#endif /* INC_BOOTLINK_H_ */
@@ -0,0 +1,345 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.4
+ *  File: BootLogDriver_STM32L0x3.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds the log sink that funnels printf to the PC through UART2.
+ *
+ * v.1.0
+ * Ring buffer for the outgoing log, drained by DMA1 Channel 4 on the UART2 Tx.
+ * Writers only copy into the ring buffer and never wait for the UART. If the buffer is full, the bytes are dropped and counted.
+ *
+ * v.1.1
+ * Added the tokenized log frame encoder (see BootLogTokens.h).
+ * Added busy check so Stop mode does not cut the log.
+ * Added baud rate update for clock profile changes.
+ *
+ * v.1.2
+ * Added a register level UART2 setup for builds without the HAL (bare_metal_startup). It replaces MX_USART2_UART_Init.
+ *
+ * v.1.3
+ * Added a bounded drain of the log and a deinit for the jump to the app. The app must not start with the log DMA running and its IRQ enabled.
+ *
+ * v.1.4
+ * The baud rate update doesn't wait for the log anymore. The log is drained by SysClockProfile before the switch, when the old BRR still fits the clock.
+ *
+ */
+
+#include "BootLogDriver_STM32L0x3.h"
+#include "BootDMADriver_STM32L0x3.h"
+#include "BootLogTokens.h"
+#include "stdarg.h"
+#include "BootClockDriver_STM32L0x3.h"
+
+static uint8_t Log_ring_buf[Log_ring_buf_size];
+static volatile uint16_t Log_ring_head = 0;											//where the next byte will be written by printf
+static volatile uint16_t Log_ring_tail = 0;											//where the DMA is reading from
+static volatile uint16_t Log_DMA_chunk_len = 0;										//number of bytes the DMA is currently sending. 0 means the DMA is idle.
+
+static void BootLogKick(void);
+
+#ifndef log_tokenized
+//format strings for the printf version of the log - generated from the same table as the tokens
+#define BOOT_LOG_TOKEN(token, format) format,
+const char* const Log_format_table[LogTok_Count] = {
+#include "BootLogTokens.def"
+};
+#undef BOOT_LOG_TOKEN
+#endif
+
+//1)Log sink init
+void BootLogInit(void) {
+	/*
+	 * UART2 is set up by the HAL (MX_USART2_UART_Init) or by BootLogUART2Config (bare_metal_startup). We only add the DMA request for the Tx side.
+	 *
+	 * 1)Configure DMA1 Channel 4 for the UART2 Tx
+	 * 2)Enable DMA on UART2 Tx
+	 * 3)Enable the DMA IRQ
+	 *
+	 * Note: the DMA clocking is enabled in BootDMAInit, which must be called before this function.
+	 * */
+
+	//1)
+	Log_ring_head = 0;
+	Log_ring_tail = 0;
+	Log_DMA_chunk_len = 0;
+	Log_dropped_bytes = 0;
+	DMAChannelUART2TxConfig();
+
+	//2)
+#ifdef boot_wait_stop_mode
+	USART2->CR1 &= ~(1<<0);																//disable the UART2
+	RCC->CCIPR &= ~(3<<2);
+	RCC->CCIPR |= (2<<2);																//UART2 runs on HSI16 so the log keeps its baud rate when we wake up from Stop on HSI16
+	USART2->CR1 |= (1<<0);																//enable the UART2
+#endif
+	BootLogBaudUpdate();
+	USART2->CR3 |= (1<<7);																//DMA enabled on Tx (DMAT bit)
+
+	//3)
+	NVIC_EnableIRQ(DMA1_Channel4_5_6_7_IRQn);
+}
+
+
+//2)Write into the log ring buffer
+int BootLogWrite(const uint8_t* log_data_ptr, int log_data_len) {
+	/*
+	 * This function is called by "_write" (printf) from both the main loop and the IRQs.
+	 * It never waits for the UART: whatever does not fit into the ring buffer is dropped and added to Log_dropped_bytes.
+	 *
+	 * 1)Lock out the IRQs while we move the head (the IRQs may log too)
+	 * 2)Copy as many bytes as we have space for
+	 * 3)Count the rest as dropped
+	 * 4)Start the DMA if it is idle
+	 *
+	 * Note: we save and restore PRIMASK instead of enabling IRQs blindly since we might be called with IRQs already disabled.
+	 * */
+
+	//1)
+	uint32_t primask_buf = __get_PRIMASK();
+	__disable_irq();
+
+	//2)
+	uint16_t used_space = (Log_ring_head - Log_ring_tail + Log_ring_buf_size) % Log_ring_buf_size;
+	uint16_t free_space = Log_ring_buf_size - 1 - used_space;
+	int copy_len = (log_data_len < free_space) ? log_data_len : free_space;
+
+	for (int i = 0; i < copy_len; i++) {
+		Log_ring_buf[Log_ring_head] = log_data_ptr[i];
+		Log_ring_head = (Log_ring_head + 1) % Log_ring_buf_size;
+	}
+
+	//3)
+	Log_dropped_bytes += (log_data_len - copy_len);
+
+	//4)
+	BootLogKick();
+
+	__set_PRIMASK(primask_buf);
+
+	return log_data_len;																//we always report the full length, otherwise newlib would try again (and block)
+}
+
+
+//3)Start the DMA on the next contiguous chunk of the ring buffer
+static void BootLogKick(void) {
+	/*
+	 * Must be called with IRQs disabled.
+	 * The DMA is not circular. We send the bytes between tail and head, or between tail and the end of the buffer if the data wraps around.
+	 * The wrapped part goes out with the next kick from the TC IRQ.
+	 * */
+
+	if ((Log_DMA_chunk_len != 0) || (Log_ring_head == Log_ring_tail)) return;			//DMA busy or nothing to send
+
+	if (Log_ring_head > Log_ring_tail) {
+		Log_DMA_chunk_len = Log_ring_head - Log_ring_tail;
+	} else {
+		Log_DMA_chunk_len = Log_ring_buf_size - Log_ring_tail;
+	}
+
+	DMA1_Channel4->CMAR = (uint32_t) &Log_ring_buf[Log_ring_tail];						//CMAR and CNDTR can only be written when the channel is off
+	DMA1_Channel4->CNDTR = Log_DMA_chunk_len;
+	DMA1_Channel4->CCR |= (1<<0);														//we enable the DMA channel
+}
+
+
+//4)DMA transfer complete on the log
+void BootLogDMAComplete(void) {
+	/*
+	 * Called from the DMA1 Channel 4 IRQ once a chunk has been handed over to the UART2.
+	 * We release the sent bytes and start the next chunk, if there is any.
+	 *
+	 * Note: higher priority IRQs may log while we are here, hence the lock.
+	 * */
+
+	uint32_t primask_buf = __get_PRIMASK();
+	__disable_irq();
+
+	DMA1_Channel4->CCR &= ~(1<<0);														//we disable the DMA channel
+	Log_ring_tail = (Log_ring_tail + Log_DMA_chunk_len) % Log_ring_buf_size;
+	Log_DMA_chunk_len = 0;
+	BootLogKick();
+
+	__set_PRIMASK(primask_buf);
+}
+
+
+//5)Tokenized log frame
+void BootLogTokenEmit(enum_Log_Token token, uint8_t arg_cnt, ...) {
+	/*
+	 * Instead of formatting a string, we send the token and the raw arguments. The PC does the formatting.
+	 *
+	 * 1)Build the frame header: sync byte, token, argument count
+	 * 2)Add the arguments as 32-bit little endian words
+	 * 3)Pass the full frame to the ring buffer in one go (so frames from IRQs can't interleave with each other)
+	 *
+	 * Note: if the ring buffer is full, the frame may be cut. The decoder resynchronises on the next sync byte.
+	 * */
+
+	uint8_t log_frame[3 + (4 * Log_frame_max_args)];
+	uint8_t log_frame_len = 0;
+	va_list arg_list;
+
+	//1)
+	if (arg_cnt > Log_frame_max_args) arg_cnt = Log_frame_max_args;
+	log_frame[log_frame_len++] = Log_frame_sync_byte;
+	log_frame[log_frame_len++] = (uint8_t) token;
+	log_frame[log_frame_len++] = arg_cnt;
+
+	//2)
+	va_start(arg_list, arg_cnt);
+	for (uint8_t i = 0; i < arg_cnt; i++) {
+		uint32_t arg_buf = va_arg(arg_list, uint32_t);
+		log_frame[log_frame_len++] = (uint8_t) (arg_buf >> 0);
+		log_frame[log_frame_len++] = (uint8_t) (arg_buf >> 8);
+		log_frame[log_frame_len++] = (uint8_t) (arg_buf >> 16);
+		log_frame[log_frame_len++] = (uint8_t) (arg_buf >> 24);
+	}
+	va_end(arg_list);
+
+	//3)
+	BootLogWrite(log_frame, log_frame_len);
+}
+
+
+//6)Log activity check
+enum_Yes_No_Selector BootLogBusy(void) {
+	/*
+	 * The log is busy as long as we have data in the ring buffer or the UART2 is still shifting out the last byte.
+	 * Stop mode would freeze the DMA and the UART2 mid-transfer, so we don't stop while the log is busy.
+	 * */
+
+	if ((Log_DMA_chunk_len != 0) || (Log_ring_head != Log_ring_tail)) return Yes;
+	if ((USART2->ISR & (1<<6)) != (1<<6)) return Yes;									//TC flag - goes HIGH once the last byte has left the UART2
+	return No;
+}
+
+
+//7)Log baud rate update
+void BootLogBaudUpdate(void) {
+	/*
+	 * Recalculates the UART2 BRR after a clock profile change. The log runs at 115200 baud.
+	 *
+	 * 1)Find the kernel clock: HSI16 if selected in CCIPR, APB1 otherwise
+	 * 2)If the BRR changes, write it with the UART2 disabled
+	 *
+	 * Note: this runs after the clock switch. Waiting for the log here would be too late - it would go out on the new clock with the old BRR. SysClockProfile drains it before the switch.
+	 * */
+
+	//1)
+	uint32_t UART2_kernel_clock;
+	if ((RCC->CCIPR & (3<<2)) == (2<<2)) {
+		UART2_kernel_clock = 16000000;
+	} else {
+		UART2_kernel_clock = GetPCLK1Freq();
+	}
+	uint32_t UART2_BRR = (UART2_kernel_clock + (Log_baud_rate / 2)) / Log_baud_rate;
+
+	//2)
+	if (USART2->BRR != UART2_BRR) {
+		USART2->CR1 &= ~(1<<0);															//disable the UART2
+		USART2->BRR = UART2_BRR;
+		USART2->CR1 |= (1<<0);															//enable the UART2
+	}
+}
+
+
+#ifdef bare_metal_startup
+//8)UART2 setup without the HAL
+void BootLogUART2Config(void) {
+	/*
+	 * What MX_USART2_UART_Init and HAL_UART_MspInit did, minus what the log never uses.
+	 *
+	 * 1)Clock the UART2 and the PORTA. The kernel clock stays on APB1 (CCIPR reset value), the same as the HAL set it.
+	 * 2)PA2 as USART2_TX on AF4
+	 * 3)8N1, oversampling by 16, Tx only, then enable
+	 *
+	 * Note: the HAL also enabled the receiver on PA3. Nothing ever reads the UART2, so PA3 is left in analog mode.
+	 * Note: the BRR is written here with the UART2 still off. BootLogBaudUpdate only touches it again when the clock profile changes.
+	 * */
+
+	//1)
+	RCC->APB1ENR |= (1<<17);															//enable UART2 clocking
+	RCC->IOPENR |= (1<<0);																//PORTA
+
+	//2)
+	GPIOA->MODER &= ~(1<<4);															//AF for PA2
+	GPIOA->AFR[0] &= ~(15<<8);
+	GPIOA->AFR[0] |= (4<<8);															//PA2 is USART2_TX on AF4
+
+	//3)
+	USART2->CR1 = 0x00;																	//8 bits, no parity, oversampling by 16 - and the UART2 off
+	USART2->CR2 = 0x00;																	//1 stop bit
+	USART2->CR3 = 0x00;																	//no flow control, no DMA yet (see BootLogInit)
+	USART2->BRR = (GetPCLK1Freq() + (Log_baud_rate / 2)) / Log_baud_rate;
+	USART2->CR1 |= (1<<3);																//transmitter enabled
+	USART2->CR1 |= (1<<0);																//enable the UART2
+}
+#endif
+
+
+//9)Log drain
+enum_Yes_No_Selector BootLogDrain(uint32_t timeout_us) {
+	/*
+	 * Waits until the log is out, but no longer than timeout_us. Returns No if it ran out of time.
+	 *
+	 * 1)Serve the TC of the log DMA ourselves
+	 * 2)Count the time on TIM6 - it runs on 1 MHz on every clock profile, the 16 bit wraps are summed up
+	 *
+	 * Note: we may be called from an IRQ above the log DMA (TIM2, LPTIM1). BootLogDMAComplete would never run there, and the wrapped part of the ring buffer would never be sent.
+	 * */
+
+	uint32_t waited_us = 0;
+	uint16_t last_time = TIM6->CNT;
+
+	while (BootLogBusy() == Yes) {
+		//1)
+		uint32_t primask_buf = __get_PRIMASK();
+		__disable_irq();															//the DMA IRQ must not serve the same TC
+		if ((DMA1->ISR & (1<<13)) == (1<<13)) {
+			DMA1->IFCR |= (1<<12);													//we remove all the interrupt flags from Channel 4
+			BootLogDMAComplete();
+		} else {
+			//do nothing
+		}
+		__set_PRIMASK(primask_buf);
+
+		//2)
+		uint16_t time_now = TIM6->CNT;
+		waited_us += (uint16_t) (time_now - last_time);
+		last_time = time_now;
+		if (waited_us >= timeout_us) return No;
+	}
+
+	return Yes;
+}
+
+
+//10)Log deinit
+void BootLogDeinit(void) {
+	/*
+	 * Called right before the jump to the app.
+	 *
+	 * 1)Let the log go out
+	 * 2)Stop the DMA, the DMA request of the UART2 and the IRQ. Whatever did not make it out is dropped.
+	 *
+	 * Note: the UART2 itself is left on, so the last byte is not cut. The app sets it up again, if it uses it.
+	 * */
+
+	//1)
+	BootLogDrain(Log_drain_timeout_us);
+
+	//2)
+	NVIC_DisableIRQ(DMA1_Channel4_5_6_7_IRQn);
+	DMA1_Channel4->CCR &= ~(1<<0);													//we disable the DMA channel
+	USART2->CR3 &= ~(1<<7);															//no DMA on Tx (DMAT bit)
+	DMA1->IFCR |= (1<<12);															//we remove all the interrupt flags from Channel 4
+	NVIC_ClearPendingIRQ(DMA1_Channel4_5_6_7_IRQn);
+	Log_DMA_chunk_len = 0;
+	Log_ring_tail = Log_ring_head;
+}
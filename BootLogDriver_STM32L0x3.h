@@ -0,0 +1,41 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootLogDriver_STM32L0x3.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ */
+
+#ifndef INC_BOOTLOGDRIVER_CUSTOM_H_
+#define INC_BOOTLOGDRIVER_CUSTOM_H_
+
+#include "stdint.h"
+#include "main.h"
+
+//LOCAL CONSTANT
+#define Log_baud_rate			115200												//UART2 baud rate
+#define Log_ring_buf_size		512													//size of the log ring buffer in bytes
+																					//Note: one byte is always kept free to tell a full buffer from an empty one
+#define Log_drain_timeout_us	50000												//a full ring buffer takes 45 ms at 115200 baud
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+extern uint32_t Log_dropped_bytes;													//number of log bytes that did not fit into the ring buffer
+
+//FUNCTION PROTOTYPES
+void BootLogInit(void);
+int BootLogWrite(const uint8_t* log_data_ptr, int log_data_len);
+void BootLogDMAComplete(void);
+enum_Yes_No_Selector BootLogBusy(void);
+void BootLogBaudUpdate(void);
+enum_Yes_No_Selector BootLogDrain(uint32_t timeout_us);
+void BootLogDeinit(void);
+#ifdef bare_metal_startup
+void BootLogUART2Config(void);
+#endif
+
+#endif /* INC_BOOTLOGDRIVER_CUSTOM_H_ */
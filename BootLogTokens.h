@@ -0,0 +1,85 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootLogTokens.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Log macros of the bootloader.
+ *
+ * With "log_tokenized" defined, a log call only sends a frame of [0xA5][token][number of arguments][arguments as 32-bit little endian words] to the log ring buffer.
+ * The text is rebuilt on the PC by HostTools/BootLogDecoder.c using the same BootLogTokens.def table.
+ * Without "log_tokenized", the log calls are plain printf calls using the table's format strings.
+ *
+ * Levels above "log_level" are removed by the preprocessor - arguments included - so they cost nothing.
+ */
+
+#ifndef INC_BOOTLOGTOKENS_CUSTOM_H_
+#define INC_BOOTLOGTOKENS_CUSTOM_H_
+
+#include "stdint.h"
+#include "stdio.h"
+
+//#define log_tokenized															//uncomment to strip the format strings from the image
+
+//LOCAL CONSTANT
+#define Log_level_none			0
+#define Log_level_error			1
+#define Log_level_info			2
+#define Log_level_debug			3
+
+#ifndef log_level
+#define log_level				Log_level_info										//log calls above this level are compiled out
+#endif
+
+#define Log_frame_sync_byte		0xA5												//first byte of every tokenized log frame
+#define Log_frame_max_args		4
+
+//token IDs generated from the table
+#define BOOT_LOG_TOKEN(token, format) token,
+typedef enum {
+#include "BootLogTokens.def"
+	LogTok_Count
+} enum_Log_Token;
+#undef BOOT_LOG_TOKEN
+
+//argument counter - counts up to 4 arguments, zero included (GCC "##" extension)
+#define LOG_NARGS(...)	LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, N, ...)	N
+
+#ifdef log_tokenized
+#define BOOT_LOG(token, ...)	BootLogTokenEmit(token, LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+#else
+#define BOOT_LOG(token, ...)	printf(Log_format_table[token], ##__VA_ARGS__)
+#endif
+
+#if log_level >= Log_level_error
+#define BootLogError(token, ...)	BOOT_LOG(token, ##__VA_ARGS__)
+#else
+#define BootLogError(token, ...)	do {} while (0)
+#endif
+
+#if log_level >= Log_level_info
+#define BootLogInfo(token, ...)		BOOT_LOG(token, ##__VA_ARGS__)
+#else
+#define BootLogInfo(token, ...)		do {} while (0)
+#endif
+
+#if log_level >= Log_level_debug
+#define BootLogDebug(token, ...)	BOOT_LOG(token, ##__VA_ARGS__)
+#else
+#define BootLogDebug(token, ...)	do {} while (0)
+#endif
+
+//EXTERNAL VARIABLE
+#ifndef log_tokenized
+extern const char* const Log_format_table[LogTok_Count];
+#endif
+
+//FUNCTION PROTOTYPES
+void BootLogTokenEmit(enum_Log_Token token, uint8_t arg_cnt, ...);
+
+#endif /* INC_BOOTLOGTOKENS_CUSTOM_H_ */
@@ -3,7 +3,7 @@
  *  Author: BalazsFarkas
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
- *  Program version: 1.0
+ *  Program version: 1.4
  *  File: BootNVMDriver_STM32L0x3.c
  *  Modified from: STM32_NVMDriver/NVMDriver_STM32L0x3.c
  *  Change history:
@@ -13,10 +13,34 @@
  * v.1.0
  * Slightly rework version of the previously written NVM driver code.
  *
+ * v.1.1
+ * Added data EEPROM word write (slot record and other persistent bootloader data).
+ *
+ * v.1.2
+ * Endian swap of a whole page in the Rx buffer with REV, ahead of the half-page writes. Big-endian images no longer need the word by word path.
+ *
+ * v.1.3
+ * RAM update path (ram_update_path): the page erase and the data EEPROM write run from RAM too, the IRQs stay enabled while the FLASH is busy.
+ * Only the IRQs with their handler in RAM are left unmasked for the busy time (NVM_busy_RAM_IRQs), the rest are masked in the NVIC and come after. SysTick is stopped as well.
+ * The half-page write still runs the 16 word writes with all IRQs disabled - only the wait for the end of the programming is open to IRQs.
+ *
+ * v.1.4
+ * Half-page and page word counts come from the device traits. The Rx buffer index is the page in the buffer, whatever its size.
+ *
  */
 
 #include <BootNVMDriver_STM32L0x3.h>
 #include "main.h"
+#include "BootLogTokens.h"
+
+#ifdef ram_update_path
+#define NVM_busy_RAM_IRQs		((1<<DMA1_Channel2_3_IRQn) | (1<<USART1_IRQn) | (1<<EXTI4_15_IRQn) | (1<<TIM22_IRQn))		//handlers in RAM (see BootIRQ_Control.c) - only these are served while the NVM is busy
+
+static uint32_t NVM_busy_masked_IRQs;
+
+static void NVMBusyIRQMask(void);
+static void NVMBusyIRQRestore(void);
+#endif
 
 
 //1)FLASH speed and interrupt initialisation
@@ -61,7 +85,7 @@ void NVM_Init (void){
 }
 
 //2)Erase a page of FLASH
-void FLASHErase_Page(uint32_t flash_page_addr) {
+__RAM_UPDATE_PATH void FLASHErase_Page(uint32_t flash_page_addr) {
 	/* This function erases a full page of NVM. A page consists of 8 rows of 4 words (128 bytes or 1 kbit).
 	 * It is not possible to erase a smaller section of FLASH than a page.
 	 *
@@ -73,6 +97,7 @@ void FLASHErase_Page(uint32_t flash_page_addr) {
 	 * 6)Close NVM and add readout protection
 	 *
 	 * Note: writing 0xCC to the RDPORT bricks the micro indefinitely!!!
+	 * Note: with ram_update_path, the function runs from RAM and the Rx IRQs are served during the erase.
 	 */
 
 	//1)
@@ -91,12 +116,18 @@ void FLASHErase_Page(uint32_t flash_page_addr) {
 	FLASH->PECR |= (1<<3);						//we pick the FLASH for erasing
 
 	//5)
+#ifdef ram_update_path
+	NVMBusyIRQMask();
+#endif
 	*(__IO uint32_t*)(flash_page_addr) = (uint32_t)0;		//value doesn't actually matter here, we are erasing
 
 	while((FLASH->SR & (1<<0)) == (1<<0));		//we stay in the loop while the BSY flag is 1
 
 	while(!(((FLASH->SR & (1<<1)) == (1<<1))));	//we stay in the loop while the EOP flag is not 1
 	FLASH->SR |= (1<<1);						//we reset the EOP flag to 0 by writing 1 to it
+#ifdef ram_update_path
+	NVMBusyIRQRestore();
+#endif
 
 	//6)
 //	FLASH->OPTR = (0xBB<<0);					//we switch back to Level 1 protection using RDPROT bits
@@ -176,6 +207,7 @@ void FLASHUpd_HalfPage(uint32_t loc_var_current_flash_half_page_addr, uint8_t fu
 	 * Call with the __RAM_FUNC attribute!!!!!
 	 *
 	 * Also, ALL IRQs must be disabled during the write process or we have a crash.
+	 * With ram_update_path, this is only true for the 16 word writes. Once they are in, the IRQs in RAM may come while the FLASH is busy.
 	 *
 	 * This function writes a sixteen 32-bit words in the NVM.
 	 * The address of the action must align to a half page - first 6 bits of the first address must be 0.
@@ -223,16 +255,22 @@ void FLASHUpd_HalfPage(uint32_t loc_var_current_flash_half_page_addr, uint8_t fu
 
 
 	//5)
+#ifdef ram_update_path
+	NVMBusyIRQMask();							//only the IRQs in RAM may come once the programming has started
+#endif
 	__disable_irq();							//we disable all the IRQs
 												//Note: apparently this was "forgotten" in the refman, but one must deactivate all IRQs before working with FLASH, otherwise the writing will be interrupted
 												//Note: it actually makes complete sense...a pickle it is not mentioned whatsoever
 
 	//6)
-	for(uint8_t i = 0; i < 16; i++) {
-		*(__IO uint32_t*)(loc_var_current_flash_half_page_addr) = Rx_Message_buf[(32 * full_page_cnt_in_buf) + (16 * half_page_cnt_in_page) + i];
+	for(uint8_t i = 0; i < Dev_half_page_words; i++) {
+		*(__IO uint32_t*)(loc_var_current_flash_half_page_addr) = Rx_Message_buf[(Dev_page_words * full_page_cnt_in_buf) + (Dev_half_page_words * half_page_cnt_in_page) + i];
 												//Note: the half page address does not need to be changed (similar to the erasing command)
 												//Note: we only need to step the pointer for the data we want to write into the FLASH
 	}
+#ifdef ram_update_path
+	__enable_irq();								//the 16 words are in, the programming has started
+#endif
 
 	while((FLASH->SR & (1<<0)) == (1<<0));		//we stay in the loop while the BSY flag is 1
 	while(!(((FLASH->SR & (1<<1)) == (1<<1))));	//we stay in the loop while the EOP flag is not 1
@@ -245,7 +283,11 @@ void FLASHUpd_HalfPage(uint32_t loc_var_current_flash_half_page_addr, uint8_t fu
 	FLASH->PECR |= (1<<0);						//we set PELOCK on the NVM to 1, locking it again for writing operations
 
 	//8)
+#ifdef ram_update_path
+	NVMBusyIRQRestore();
+#else
 	__enable_irq();								//we re-enable the IRQs
+#endif
 }
 
 
@@ -254,7 +296,7 @@ void FLASHUpd_HalfPage(uint32_t loc_var_current_flash_half_page_addr, uint8_t fu
 //5)
 //if we encounter an error during writing to the FLASH, the code stops working
 void FLASH_IRQHandler(void){
-	printf("Memory error... \r\n");
+	BootLogError(LogTok_Memory_error);
 	FLASH->SR |= (0x32F<<8);						//we reset all the error interrupt flags
 	while(1);
 }
@@ -265,3 +307,96 @@ void FLASHIRQPriorEnable(void) {
 	NVIC_SetPriority(FLASH_IRQn, 1);
 	NVIC_EnableIRQ(FLASH_IRQn);
 }
+
+
+//7)Write a word to a data EEPROM address
+__RAM_UPDATE_PATH void EEPROMUpd_Word(uint32_t eeprom_word_addr, uint32_t updated_eeprom_value) {
+	/* This function writes a 32-bit word in the data EEPROM.
+	 * Unlike the FLASH, the data EEPROM does not need a separate erase: with FIX at 0, the NVM erases the word on its own if it needs to.
+	 * A word write is a single NVM operation, so the word is either the old or the new value, never a mix of the two.
+	 *
+	 * 1)Unlock the NVM control register PECR (data EEPROM only needs PELOCK removed)
+	 * 2)Make sure no FLASH programming mode is selected
+	 * 3)Write the word and wait until success flag is raised
+	 * 4)Close NVM
+	 *
+	 */
+
+	//1)
+	FLASH->PEKEYR = 0x89ABCDEF;					//PEKEY1
+	FLASH->PEKEYR = 0x02030405;					//PEKEY2
+
+	//2)
+	FLASH->PECR &= ~((1<<3) | (1<<9) | (1<<10));	//no PROG, ERASE or FPRG
+	FLASH->PECR &= ~(1<<8);						//FIX is 0 - automatic erase only when necessary
+
+	//3)
+#ifdef ram_update_path
+	NVMBusyIRQMask();
+#endif
+	*(__IO uint32_t*)(eeprom_word_addr) = updated_eeprom_value;
+
+	while((FLASH->SR & (1<<0)) == (1<<0));		//we stay in the loop while the BSY flag is 1
+	while(!(((FLASH->SR & (1<<1)) == (1<<1))));	//we stay in the loop while the EOP flag is not 1
+	FLASH->SR |= (1<<1);						//we reset the EOP flag to 0 by writing 1 to it
+#ifdef ram_update_path
+	NVMBusyIRQRestore();
+#endif
+
+	//4)
+	FLASH->PECR |= (1<<0);						//we set PELOCK on the NVM to 1, locking it again for writing operations
+}
+
+
+
+//8)Endian swap of a page in the Rx buffer
+void FLASHSwap_Page(uint32_t* page_ptr) {
+	/*
+	 * Swaps the bytes of the 32 words of a page in place, before the page goes to FLASHUpd_HalfPage.
+	 * One REV per word: a load, a REV and a store, instead of the shifts and masks of the word by word endian_swap.
+	 * Four words per loop cycle to spend less on the loop itself.
+	 *
+	 * Note: runs from FLASH - it is done before the half-page writes, not in them.
+	 *
+	 * */
+
+	for(uint8_t i = 0; i < Dev_page_words; i += 4) {
+		page_ptr[i] = __REV(page_ptr[i]);
+		page_ptr[i + 1] = __REV(page_ptr[i + 1]);
+		page_ptr[i + 2] = __REV(page_ptr[i + 2]);
+		page_ptr[i + 3] = __REV(page_ptr[i + 3]);
+	}
+}
+
+
+
+#ifdef ram_update_path
+//9)Mask the IRQs in FLASH for an NVM operation
+__RAM_UPDATE_PATH static void NVMBusyIRQMask(void) {
+	/*
+	 * A handler in FLASH would stall on its first fetch until the NVM is done - and hold up every IRQ of the same or lower priority with it.
+	 * So only the handlers in RAM stay enabled while the NVM is busy. The rest stay pending and come once the NVIC is restored.
+	 *
+	 * 1)Disable the enabled IRQs that are not in RAM
+	 * 2)Stop the SysTick IRQ and drop a tick that may be pending already
+	 *
+	 * Note: the HAL tick is late by the busy time. Nothing in the bootloader times itself with it.
+	 *
+	 * */
+
+	//1)
+	NVM_busy_masked_IRQs = NVIC->ISER[0] & ~NVM_busy_RAM_IRQs;
+	NVIC->ICER[0] = NVM_busy_masked_IRQs;
+
+	//2)
+	SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+	SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+}
+
+
+//10)Restore the IRQs after an NVM operation
+__RAM_UPDATE_PATH static void NVMBusyIRQRestore(void) {
+	NVIC->ISER[0] = NVM_busy_masked_IRQs;
+	SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+}
+#endif
@@ -13,14 +13,17 @@
 #define INC_NVMDRIVER_CUSTOM_H_
 
 #include "stdint.h"
-#include "stm32l053xx.h"
+#include "stm32l0xx.h"
+#include "main.h"
 
-extern uint32_t Rx_Message_buf [64];
+extern uint32_t Rx_Message_buf [Dev_Rx_buf_words];
 
 void NVM_Init (void);
 void FLASHErase_Page(uint32_t flash_page_addr);
 void FLASHUpd_Word(uint32_t flash_word_addr, uint32_t updated_flash_value);
 void FLASHIRQPriorEnable(void);
+void EEPROMUpd_Word(uint32_t eeprom_word_addr, uint32_t updated_eeprom_value);
+void FLASHSwap_Page(uint32_t* page_ptr);
 
 __attribute__((section(".RamFunc"))) void FLASHUpd_HalfPage(uint32_t loc_var_current_flash_half_page_addr, uint8_t full_page_cnt_in_buf, uint8_t half_page_cnt_in_page);		//Note: this function MUST run from RAM, not FLASH!
 
@@ -0,0 +1,235 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.0
+ *  File: BootSHA256.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds a streaming SHA-256 (FIPS 180-4) and HMAC-SHA256 (RFC 2104) on top of it.
+ *
+ * v.1.0
+ * Written for the M0+: the round loop is not unrolled (FLASH is tight in the bootloader section) and the message schedule is a 16 word ring instead of 64 words.
+ * The 8 working variables don't fit into the 8 low registers anyway, so unrolling would mostly buy spills.
+ * Rotations are written so GCC makes a single RORS out of them. Ch and Maj use the forms with one operation less.
+ * Full blocks are hashed straight from the caller's buffer - a page from the Rx buffer is never copied. Word aligned blocks are read with a word load and REV.
+ *
+ */
+
+#include "BootSHA256.h"
+#include "string.h"
+
+static void SHA256Compress(uint32_t* state, const uint8_t* block);
+
+static const uint32_t SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROR(x, n)			(((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA256_S0(x)				(SHA256_ROR(x, 2) ^ SHA256_ROR(x, 13) ^ SHA256_ROR(x, 22))
+#define SHA256_S1(x)				(SHA256_ROR(x, 6) ^ SHA256_ROR(x, 11) ^ SHA256_ROR(x, 25))
+#define SHA256_s0(x)				(SHA256_ROR(x, 7) ^ SHA256_ROR(x, 18) ^ ((x) >> 3))
+#define SHA256_s1(x)				(SHA256_ROR(x, 17) ^ SHA256_ROR(x, 19) ^ ((x) >> 10))
+#define SHA256_CH(e, f, g)			((((f) ^ (g)) & (e)) ^ (g))
+#define SHA256_MAJ(a, b, c)			((((a) | (b)) & (c)) | ((a) & (b)))
+
+
+//1)Compression of one 64 byte block
+static void SHA256Compress(uint32_t* state, const uint8_t* block) {
+	/*
+	 * 1)Load the block as big endian words
+	 * 2)64 rounds - the schedule word for round i overwrites the one of round i - 16
+	 * 3)Add the result to the state
+	 *
+	 * */
+
+	uint32_t w[16];
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+	uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+	//1)
+	if (((uintptr_t)block & 0x3) == 0) {
+		const uint8_t* aligned_block = __builtin_assume_aligned(block, 4);				//the memcpy below then becomes a single word load
+		for (uint8_t i = 0; i < 16; i++) {
+			uint32_t block_word;
+			memcpy(&block_word, &aligned_block[4 * i], 4);
+			w[i] = __builtin_bswap32(block_word);									//REV on the M0+
+		}
+	} else {
+		for (uint8_t i = 0; i < 16; i++) {
+			w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[(4 * i) + 1] << 16) | ((uint32_t)block[(4 * i) + 2] << 8) | block[(4 * i) + 3];
+		}
+	}
+
+	//2)
+	for (uint8_t i = 0; i < 64; i++) {
+		uint32_t w_i;
+		if (i < 16) {
+			w_i = w[i];
+		} else {
+			w_i = w[i & 15] + SHA256_s1(w[(i - 2) & 15]) + w[(i - 7) & 15] + SHA256_s0(w[(i - 15) & 15]);
+			w[i & 15] = w_i;
+		}
+		uint32_t t1 = h + SHA256_S1(e) + SHA256_CH(e, f, g) + SHA256_K[i] + w_i;
+		uint32_t t2 = SHA256_S0(a) + SHA256_MAJ(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	//3)
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+
+//2)Streaming SHA-256
+void SHA256Init(struct_SHA256_Ctx* ctx) {
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+	ctx->total_len = 0;
+	ctx->block_len = 0;
+}
+
+
+void SHA256Update(struct_SHA256_Ctx* ctx, const uint8_t* data_ptr, uint32_t data_len) {
+	/*
+	 * 1)Top up a block we have started earlier
+	 * 2)Hash full blocks straight from the caller's buffer
+	 * 3)Keep the rest for later
+	 *
+	 * Note: pages are 128 bytes, so with a page at a time we always end up in 2) and never copy anything.
+	 *
+	 * */
+
+	ctx->total_len += data_len;
+
+	//1)
+	if (ctx->block_len != 0) {
+		uint32_t fill_len = SHA256_block_size - ctx->block_len;
+		if (fill_len > data_len) fill_len = data_len;
+		memcpy(&ctx->block[ctx->block_len], data_ptr, fill_len);
+		ctx->block_len += fill_len;
+		data_ptr += fill_len;
+		data_len -= fill_len;
+		if (ctx->block_len == SHA256_block_size) {
+			SHA256Compress(ctx->state, ctx->block);
+			ctx->block_len = 0;
+		} else {
+			//do nothing
+		}
+	} else {
+		//do nothing
+	}
+
+	//2)
+	while (data_len >= SHA256_block_size) {
+		SHA256Compress(ctx->state, data_ptr);
+		data_ptr += SHA256_block_size;
+		data_len -= SHA256_block_size;
+	}
+
+	//3)
+	if (data_len != 0) {
+		memcpy(&ctx->block[ctx->block_len], data_ptr, data_len);
+		ctx->block_len += data_len;
+	} else {
+		//do nothing
+	}
+}
+
+
+void SHA256Final(struct_SHA256_Ctx* ctx, uint8_t* digest) {
+	/*
+	 * 1)Padding: 0x80, zeros, then the length in bits as a big endian 64-bit number
+	 * 2)Digest is the state, big endian
+	 *
+	 * */
+
+	uint32_t bit_len = ctx->total_len << 3;
+	uint8_t len_hi = ctx->total_len >> 29;
+
+	//1)
+	ctx->block[ctx->block_len++] = 0x80;
+	if (ctx->block_len > (SHA256_block_size - 8)) {
+		memset(&ctx->block[ctx->block_len], 0, SHA256_block_size - ctx->block_len);
+		SHA256Compress(ctx->state, ctx->block);
+		ctx->block_len = 0;
+	} else {
+		//do nothing
+	}
+	memset(&ctx->block[ctx->block_len], 0, SHA256_block_size - 8 - ctx->block_len);
+	ctx->block[56] = 0;
+	ctx->block[57] = 0;
+	ctx->block[58] = 0;
+	ctx->block[59] = len_hi;
+	ctx->block[60] = bit_len >> 24;
+	ctx->block[61] = bit_len >> 16;
+	ctx->block[62] = bit_len >> 8;
+	ctx->block[63] = bit_len;
+	SHA256Compress(ctx->state, ctx->block);
+
+	//2)
+	for (uint8_t i = 0; i < 8; i++) {
+		digest[4 * i] = ctx->state[i] >> 24;
+		digest[(4 * i) + 1] = ctx->state[i] >> 16;
+		digest[(4 * i) + 2] = ctx->state[i] >> 8;
+		digest[(4 * i) + 3] = ctx->state[i];
+	}
+}
+
+
+//3)HMAC-SHA256
+/*
+ * HMAC(key, message) = SHA256((key ^ opad) | SHA256((key ^ ipad) | message))
+ * Start hashes the inner key block, the message then goes through SHA256Update as usual, Finish does the outer hash.
+ * The key is always HMAC_key_size bytes, zero padded to a block.
+ *
+ * */
+
+void HMACSHA256Start(struct_SHA256_Ctx* ctx, const uint8_t* key) {
+	uint8_t key_block[SHA256_block_size];
+
+	for (uint8_t i = 0; i < SHA256_block_size; i++) {
+		key_block[i] = ((i < HMAC_key_size) ? key[i] : 0) ^ 0x36;
+	}
+	SHA256Init(ctx);
+	SHA256Update(ctx, key_block, SHA256_block_size);
+	memset(key_block, 0, SHA256_block_size);										//no key material left on the stack
+}
+
+
+void HMACSHA256Finish(struct_SHA256_Ctx* ctx, const uint8_t* key, uint8_t* tag) {
+	uint8_t key_block[SHA256_block_size];
+	uint8_t inner_digest[SHA256_digest_size];
+
+	SHA256Final(ctx, inner_digest);
+	for (uint8_t i = 0; i < SHA256_block_size; i++) {
+		key_block[i] = ((i < HMAC_key_size) ? key[i] : 0) ^ 0x5c;
+	}
+	SHA256Init(ctx);
+	SHA256Update(ctx, key_block, SHA256_block_size);
+	SHA256Update(ctx, inner_digest, SHA256_digest_size);
+	SHA256Final(ctx, tag);
+	memset(key_block, 0, SHA256_block_size);
+}
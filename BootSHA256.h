@@ -0,0 +1,42 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootSHA256.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Plain C, no registers touched: the host tools build the very same file for their reference test (see HostTools/BootSign.c).
+ */
+
+#ifndef INC_BOOTSHA256_H_
+#define INC_BOOTSHA256_H_
+
+#include "stdint.h"
+
+//LOCAL CONSTANT
+#define SHA256_block_size			64
+#define SHA256_digest_size			32
+#define HMAC_key_size				32										//we only take keys of this size - no hashing of longer keys needed
+
+typedef struct {
+	uint32_t state[8];
+	uint32_t total_len;														//bytes hashed so far - an image is never more than 4 GB
+	uint8_t block[SHA256_block_size];										//bytes waiting for a full block
+	uint8_t block_len;
+} struct_SHA256_Ctx;
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+
+//FUNCTION PROTOTYPES
+void SHA256Init(struct_SHA256_Ctx* ctx);
+void SHA256Update(struct_SHA256_Ctx* ctx, const uint8_t* data_ptr, uint32_t data_len);
+void SHA256Final(struct_SHA256_Ctx* ctx, uint8_t* digest);
+void HMACSHA256Start(struct_SHA256_Ctx* ctx, const uint8_t* key);
+void HMACSHA256Finish(struct_SHA256_Ctx* ctx, const uint8_t* key, uint8_t* tag);
+
+#endif /* INC_BOOTSHA256_H_ */
@@ -0,0 +1,310 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.3
+ *  File: BootSPIDriver_STM32L0x3.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds the SPI1 slave transport of the bootloader (spi1_transport). It replaces the UART1 for boards that sit next to a host processor.
+ *
+ * v.1.0
+ * SPI1 slave on PA15 (NSS), PB3 (SCK), PB4 (MISO), PB5 (MOSI), all on AF0. PA8 is the ready line towards the master.
+ * The messages are the same as on the UART1 (0xF0 0xF0 command payload). The end of a message is the rising edge of NSS instead of the idle frames.
+ * Commands and machine code are both received by DMA (Channel2). Replies are sent by DMA (Channel3) when the master clocks them out.
+ *
+ * v.1.1
+ * The ready line is driven from the DMA IRQ, so it runs from RAM with it (ram_update_path).
+ *
+ * v.1.2
+ * Family header instead of the L053 one. The SPI1 keeps one page per half of the Rx buffer on every part (see BootDeviceTraits_STM32L0xx.h).
+ *
+ * v.1.3
+ * The readback block goes out in transactions of 32 kB at most. On category 5 parts the app section is well over 64 kB, which the 16 bit transfer length silently cut.
+ *
+ */
+
+#include "BootSPIDriver_STM32L0x3.h"
+#include "stm32l0xx.h"
+#include "BootDMADriver_STM32L0x3.h"
+#include "string.h"
+
+#if defined(spi1_transport) && (defined(boot_wait_stop_mode) || defined(uart1_auto_baud) || defined(uart1_flow_control) || defined(uart1_rs485))
+#error "spi1_transport replaces the UART1: the Stop mode wake-up and the uart1_ options can't be used with it"
+#endif
+
+static volatile enum_Yes_No_Selector SPI1_Tx_Pending = No;							//a reply is waiting for the master to clock it out
+static volatile uint16_t SPI1_Rx_Message_len = 0;									//bytes received in the last command transaction - start sequence included
+static uint8_t SPI1_Tx_buf[SPI1_Tx_buf_size];
+
+static void SPI1Reset(void);
+static void SPI1NSSIRQEnable(void);
+static void SPI1TxSend(const uint8_t* tx_ptr, uint16_t tx_len);
+
+//1)SPI1 slave init
+void SPI1Config(void) {
+	/*
+	 * 1)Clock the SPI1, the SYSCFG (EXTI mux) and the GPIO ports
+	 * 2)Set the pins: SPI1 on AF0, ready line as output (LOW - we are not listening yet)
+	 * 3)SPI1 as slave: mode 0 (CPOL 0, CPHA 0), 8 bits, MSB first, hardware NSS
+	 * 4)NSS rising edge on EXTI line 15 - this is how we know that a transaction is over
+	 *
+	 * Note: PA5 (the other SCK pin) is the LED on the nucleo, hence port B.
+	 * Note: the SPI1 is only enabled (SPE) when we expect a transaction. See SPI1RxMessage, SPI1DMAEnable and SPI1TxSend.
+	 *
+	 * */
+
+	//1)
+	RCC->APB2ENR |= (1<<12);															//enable SPI1 clocking
+	RCC->APB2ENR |= (1<<0);																//enable SYSCFG clocking
+	RCC->IOPENR |= (1<<0) | (1<<1);														//PORTA and PORTB
+
+	//2)
+	GPIOA->MODER &= ~(1<<30);															//AF for PA15
+	GPIOA->AFR[1] &= ~(15<<28);															//PA15 is SPI1_NSS on AF0
+	GPIOA->PUPDR |= (1<<30);															//pull-up on NSS - a master that is not connected does not select us
+	GPIOB->MODER &= ~((1<<6) | (1<<8) | (1<<10));										//AF for PB3, PB4 and PB5
+	GPIOB->AFR[0] &= ~((15<<12) | (15<<16) | (15<<20));									//SPI1_SCK, SPI1_MISO and SPI1_MOSI on AF0
+	GPIOB->OSPEEDR |= (3<<8);															//very high speed on MISO
+	GPIOA->BSRR = (1<<24);																//PA8 LOW
+	GPIOA->MODER &= ~(1<<17);															//PA8 is a GPIO output - the ready line
+
+	//3)
+	SPI1Reset();																		//CR1 and CR2 at reset value: slave, mode 0, 8 bits, MSB first, hardware NSS
+
+	//4)
+	SYSCFG->EXTICR[3] &= ~(15<<12);														//EXTI line 15 is on port A
+	EXTI->RTSR |= (1<<15);																//rising edge
+	EXTI->IMR |= (1<<15);																//IRQ unmasked - the NVIC side is enabled when needed
+}
+
+
+//2)SPI1 get the message
+void SPI1RxMessage(void) {
+	/*
+	 * The SPI1 version of UART1RxMessage.
+	 *
+	 * 1)Arm the DMA on the Rx buffer (normal mode, no IRQ), enable the SPI1 and pull the ready line HIGH
+	 * 2)Sleep until a transaction with a message in it ends (see SPI1TransactionEnd)
+	 * 3)Stop everything, drop the start sequence so the command is at the start of the buffer - as it is with the UART1
+	 *
+	 * Note: anything received after the end of the message is discarded, the command is in the buffer to stay until we call this function again.
+	 *
+	 * */
+
+	//1)
+	UART1_Message_Received = No;
+	SPI1Reset();
+	DMAChannelSPI1RxConfig((uint32_t) Rx_Message_buf, No);
+	DMA1_Channel2->CCR |= (1<<0);														//we enable the DMA channel
+	SPI1->CR2 |= (1<<0);																//DMA enabled on Rx (RXDMAEN bit)
+	SPI1->CR1 |= (1<<6);																//enable the SPI1
+	SPI1NSSIRQEnable();
+	SPI1ReadyHigh();																	//the master may send
+
+	//2)
+	while (UART1_Message_Received == No){
+		__disable_irq();
+		if (UART1_Message_Received == No) {
+			__WFI();																	//the NSS IRQ wakes us up
+		}
+		__enable_irq();
+	}
+
+	//3)
+	NVIC_DisableIRQ(EXTI4_15_IRQn);
+	DMA1_Channel2->CCR &= ~(1<<0);														//we disable the DMA channel
+	SPI1Reset();
+	UART1_Message_Received = No;
+	memmove((uint8_t*) Rx_Message_buf, (uint8_t*) Rx_Message_buf + 2, SPI1_Rx_Message_len - 2);
+	memset((uint8_t*) Rx_Message_buf + SPI1_Rx_Message_len - 2, 0, sizeof(Rx_Message_buf) - (SPI1_Rx_Message_len - 2));
+}
+
+
+//3)SPI1 DMA enable - programmer mode
+void SPI1DMAEnable(void) {
+	/*
+	 * The SPI1 version of DMAChannelUART1RxConfig + UART1DMAEnable.
+	 * The DMA runs in circular mode on the 2 page long Rx buffer, the half transfer and transfer complete IRQs hand the pages over to the FLASH.
+	 *
+	 * Note: the master must wait for the ready line to go HIGH before every page. The DMA IRQ pulls it LOW, the external controller releases it once the page is in the FLASH.
+	 *
+	 * */
+
+	SPI1Reset();
+	DMAChannelSPI1RxConfig((uint32_t) &Rx_Message_buf[0], Yes);
+	NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);												//we enable the IRQ for the DMA
+	DMA1_Channel2->CCR |= (1<<0);														//we enable the DMA channel
+	SPI1->CR2 |= (1<<0);																//DMA enabled on Rx (RXDMAEN bit)
+	SPI1->CR1 |= (1<<6);																//enable the SPI1
+	SPI1NSSIRQEnable();
+	SPI1ReadyHigh();
+}
+
+
+//4)SPI1 full deinit
+void SPI1Deinit(void) {
+	SPI1ReadyLow();
+	DMA1_Channel2->CCR &= ~(1<<0);														//we disable the DMA channels
+	DMA1_Channel3->CCR &= ~(1<<0);
+	NVIC_DisableIRQ(DMA1_Channel2_3_IRQn);												//we disable the IRQ for the DMA
+	NVIC_DisableIRQ(EXTI4_15_IRQn);														//we disable the NSS IRQ
+	SPI1Reset();
+}
+
+
+//5)SPI1 end of transaction
+void SPI1TransactionEnd(void) {
+	/*
+	 * Called from the EXTI IRQ on the rising edge of NSS, outside of programmer mode.
+	 *
+	 * 1)If we had a reply waiting, the master has just clocked it out
+	 * 2)If we are listening, we check if we have a message: the start sequence and at least a command byte
+	 * 3)Anything else (noise, a read without a reply) is dropped and we listen again
+	 *
+	 * Note: the master must leave a few microseconds between the last clock and NSS going HIGH, so the DMA can move the last byte.
+	 *
+	 * */
+
+	uint8_t* rx_ptr = (uint8_t*) Rx_Message_buf;
+	uint16_t rx_len = DMA_transfer_width_UART1 - DMA1_Channel2->CNDTR;
+
+	//1)
+	if (SPI1_Tx_Pending == Yes) {
+		SPI1_Tx_Pending = No;
+
+	//2)
+	} else if ((SPI1->CR2 & (1<<0)) == (1<<0)) {
+		if ((rx_len >= 3) && (rx_ptr[0] == UART_message_start_byte) && (rx_ptr[1] == UART_message_start_byte)) {
+			SPI1->CR2 &= ~(1<<0);														//no more bytes into the buffer
+			SPI1ReadyLow();
+			SPI1_Rx_Message_len = rx_len;
+			UART1_Message_Received = Yes;
+
+		//3)
+		} else {
+			DMA1_Channel2->CCR &= ~(1<<0);												//we disable the DMA channel
+			DMA1_Channel2->CMAR = (uint32_t) Rx_Message_buf;
+			DMA1_Channel2->CNDTR = DMA_transfer_width_UART1;							//we start from the beginning of the buffer
+			DMA1_Channel2->CCR |= (1<<0);
+		}
+
+	} else {
+		//do nothing
+	}
+}
+
+
+//6)SPI1 send a reply
+void SPI1TxReply(uint8_t reply_cmd, const uint8_t* reply_payload_ptr, uint16_t reply_payload_len) {
+	/*
+	 * The SPI1 version of UART1TxReply: the start sequence, the command, then the payload.
+	 * The slave can't talk on its own, so we load the reply, pull the ready line HIGH and wait until the master has clocked it out.
+	 *
+	 * Note: the master knows the length of every reply from the command. It may clock more bytes than that, the extra bytes are don't-care.
+	 *
+	 * */
+
+	if (UART1_Reply_Enabled == No) return;
+	if (reply_payload_len > (SPI1_Tx_buf_size - 3)) reply_payload_len = SPI1_Tx_buf_size - 3;
+
+	SPI1_Tx_buf[0] = UART_message_start_byte;
+	SPI1_Tx_buf[1] = UART_message_start_byte;
+	SPI1_Tx_buf[2] = reply_cmd;
+	memcpy(&SPI1_Tx_buf[3], reply_payload_ptr, reply_payload_len);
+	SPI1TxSend(SPI1_Tx_buf, 3 + reply_payload_len);
+}
+
+
+//7)SPI1 stream a block of memory
+void SPI1TxStream(uint8_t reply_cmd, const uint8_t* stream_ptr, uint32_t stream_len) {
+	/*
+	 * The SPI1 version of UART1TxStream. The master reads the header (with the length) in one transaction, then the block.
+	 * The block is cut into transactions of SPI1_stream_chunk bytes, the last one may be shorter. The ready line goes HIGH before each of them.
+	 *
+	 * Note: the readback is limited to the app section, which reaches past 64 kB on category 5 parts (Dev_FLASH_end). CNDTR is only 16 bits wide.
+	 *
+	 * */
+
+	if (UART1_Reply_Enabled == No) return;
+	SPI1TxReply(reply_cmd, (uint8_t*)&stream_len, 4);
+	while (stream_len > 0) {
+		uint16_t chunk_len = (stream_len > SPI1_stream_chunk) ? SPI1_stream_chunk : stream_len;
+		SPI1TxSend(stream_ptr, chunk_len);
+		stream_ptr += chunk_len;
+		stream_len -= chunk_len;
+	}
+}
+
+
+//8)Ready line
+void SPI1ReadyHigh(void) {
+	GPIOA->BSRR = (1<<8);																//PA8 HIGH - the master may start a transaction
+}
+
+__RAM_UPDATE_PATH void SPI1ReadyLow(void) {
+	GPIOA->BSRR = (1<<24);																//PA8 LOW - the master must wait
+}
+
+
+//9)SPI1 reset
+static void SPI1Reset(void) {
+	/*
+	 * The SPI1 of the L0 has no FIFO to flush. A byte the master did not clock out stays in the Tx buffer and would come out first in the next transaction.
+	 * Resetting the peripheral is the only way to get rid of it.
+	 *
+	 * */
+
+	RCC->APB2RSTR |= (1<<12);															//reset SPI1
+	RCC->APB2RSTR &= ~(1<<12);															//release the reset
+}
+
+
+//10)NSS IRQ enable
+static void SPI1NSSIRQEnable(void) {
+	EXTI->PR = (1<<15);																	//we clear any earlier edge
+	NVIC_ClearPendingIRQ(EXTI4_15_IRQn);
+	NVIC_EnableIRQ(EXTI4_15_IRQn);
+}
+
+
+//11)SPI1 Tx by DMA
+static void SPI1TxSend(const uint8_t* tx_ptr, uint16_t tx_len) {
+	/*
+	 * 1)Set up the DMA on the SPI1 Tx and enable the SPI1 - the DMA loads the first byte right away
+	 * 2)Pull the ready line HIGH and sleep until the master has clocked the data out (NSS rising edge)
+	 * 3)Stop the DMA and reset the SPI1
+	 *
+	 * Note: what the master sends while it reads is not stored.
+	 *
+	 * */
+
+	//1)
+	SPI1Reset();
+	DMAChannelSPI1TxConfig();
+	DMA1_Channel3->CMAR = (uint32_t) tx_ptr;
+	DMA1_Channel3->CNDTR = tx_len;
+	DMA1_Channel3->CCR |= (1<<0);														//we enable the DMA channel
+	SPI1->CR2 |= (1<<1);																//DMA enabled on Tx (TXDMAEN bit)
+	SPI1->CR1 |= (1<<6);																//enable the SPI1
+	SPI1_Tx_Pending = Yes;
+	SPI1NSSIRQEnable();
+
+	//2)
+	SPI1ReadyHigh();
+	while (SPI1_Tx_Pending == Yes){
+		__disable_irq();
+		if (SPI1_Tx_Pending == Yes) {
+			__WFI();
+		}
+		__enable_irq();
+	}
+	SPI1ReadyLow();
+
+	//3)
+	NVIC_DisableIRQ(EXTI4_15_IRQn);
+	DMA1_Channel3->CCR &= ~(1<<0);														//we disable the DMA channel
+	SPI1Reset();
+}
@@ -0,0 +1,39 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootSPIDriver_STM32L0x3.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ */
+
+#ifndef INC_BOOTSPIDRIVER_CUSTOM_H_
+#define INC_BOOTSPIDRIVER_CUSTOM_H_
+
+#include "stdint.h"
+#include "main.h"
+#include "BootUARTDriver_STM32L0x3.h"										//the SPI1 shares the message flags and the Rx buffer with the UART1
+
+//LOCAL CONSTANT
+#define SPI1_Tx_buf_size			132										//largest reply (0xb8 with 62 pages) plus the header
+#define SPI1_stream_chunk			0x8000									//largest block of a readback in one transaction - CNDTR is only 16 bits wide
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+extern uint16_t DMA_transfer_width_UART1;
+
+//FUNCTION PROTOTYPES
+void SPI1Config(void);
+void SPI1RxMessage(void);
+void SPI1DMAEnable(void);
+void SPI1Deinit(void);
+void SPI1TransactionEnd(void);
+void SPI1TxReply(uint8_t reply_cmd, const uint8_t* reply_payload_ptr, uint16_t reply_payload_len);
+void SPI1TxStream(uint8_t reply_cmd, const uint8_t* stream_ptr, uint32_t stream_len);
+void SPI1ReadyHigh(void);
+void SPI1ReadyLow(void);
+
+#endif /* INC_BOOTSPIDRIVER_CUSTOM_H_ */
@@ -0,0 +1,76 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Program version: 1.2
+ *  File: BootTrace.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Code holds the trace ring of the bootloader (boot_trace).
+ *
+ * v.1.0
+ * The M0+ has no DWT cycle counter, so the time stamps come from TIM6, which runs on 1 MHz on every clock profile (see SysClockProfile).
+ * Enter and exit events of the hot paths (FLASH erase and write, DMA and UART1 IRQs) go into a fixed RAM ring. The oldest events are overwritten.
+ * The ring is sent to the host with 0xba and emptied. HostTools/BootTraceHist.c pairs the events and builds the latency histograms.
+ *
+ * v.1.1
+ * The record runs from RAM with the Rx IRQs (ram_update_path). The modulo on the write index is a power of 2, so it stays an AND - no division helper from the FLASH.
+ *
+ * v.1.2
+ * Registers through stm32l0xx.h, so the trace builds for any L0 part.
+ *
+ */
+
+#include "BootTrace.h"
+
+#ifdef boot_trace
+
+#include "stm32l0xx.h"
+#include "BootLink.h"
+
+typedef struct {
+	uint16_t write_idx;																	//where the next event goes
+	uint16_t event_cnt;																	//events in the ring - at most Trace_ring_size
+	uint32_t event[Trace_ring_size];
+} struct_Trace_Ring;
+
+static struct_Trace_Ring Trace_ring;
+
+
+//1)Record an event
+__RAM_UPDATE_PATH void BootTraceRecord(uint32_t trace_event) {
+	/*
+	 * Called from the main loop and from the IRQs, so the ring is updated with the IRQs masked.
+	 *
+	 * Note: PRIMASK is restored, not cleared - we may be called with the IRQs already masked.
+	 * Note: TIM6 wraps every 65 ms and is reloaded by a clock profile switch. The host only looks at the time between an enter and its exit.
+	 *
+	 * */
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	Trace_ring.event[Trace_ring.write_idx] = trace_event | TIM6->CNT;
+	Trace_ring.write_idx = (Trace_ring.write_idx + 1) % Trace_ring_size;
+	if (Trace_ring.event_cnt < Trace_ring_size) Trace_ring.event_cnt++;
+	__set_PRIMASK(primask);
+}
+
+
+//2)Dump the ring
+void BootTraceDump(void) {
+	/*
+	 * The ring goes out as it is in RAM: write index, number of events, then all Trace_ring_size events (little endian).
+	 * The oldest event is at the write index if the ring is full, at 0 otherwise. The host sorts this out.
+	 *
+	 * Note: the ring is emptied after the dump, so two dumps never carry the same event.
+	 *
+	 * */
+
+	BootLinkTxStream(0xba, (uint8_t*)&Trace_ring, sizeof(Trace_ring));
+	Trace_ring.write_idx = 0;
+	Trace_ring.event_cnt = 0;
+}
+
+#endif
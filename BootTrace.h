@@ -0,0 +1,55 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: STM32L053R8
+ *  Header version: 1.0
+ *  File: BootTrace.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Trace macros of the bootloader.
+ *
+ * With "boot_trace" defined, BootTraceEnter/BootTraceExit put a TIM6 time stamp and the trace point into a RAM ring (see BootTrace.c). The ring is dumped with 0xba.
+ * Without "boot_trace", the macros, the ring and the dump command are all removed by the preprocessor.
+ *
+ * An event is one word: TIM6 count (1 us) in bits 15:0, trace point in bits 22:16, exit in bit 31.
+ */
+
+#ifndef INC_BOOTTRACE_CUSTOM_H_
+#define INC_BOOTTRACE_CUSTOM_H_
+
+#include "stdint.h"
+#include "main.h"
+
+//LOCAL CONSTANT
+#define Trace_ring_size			128													//events in the ring - 512 bytes of RAM
+#define Trace_event_exit		(1UL<<31)
+
+//trace point IDs generated from the table
+#define BOOT_TRACE_POINT(point, name) point,
+typedef enum {
+#include "BootTracePoints.def"
+	TracePt_Count
+} enum_Trace_Point;
+#undef BOOT_TRACE_POINT
+
+#ifdef boot_trace
+#define BootTraceEnter(point)		BootTraceRecord((uint32_t)(point) << 16)
+#define BootTraceExit(point)		BootTraceRecord(((uint32_t)(point) << 16) | Trace_event_exit)
+#else
+#define BootTraceEnter(point)		do {} while (0)
+#define BootTraceExit(point)		do {} while (0)
+#endif
+
+//LOCAL VARIABLE
+
+//EXTERNAL VARIABLE
+
+//FUNCTION PROTOTYPES
+#ifdef boot_trace
+void BootTraceRecord(uint32_t trace_event);
+void BootTraceDump(void);
+#endif
+
+#endif /* INC_BOOTTRACE_CUSTOM_H_ */
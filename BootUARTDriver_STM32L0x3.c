@@ -3,7 +3,7 @@
  *  Author: BalazsFarkas
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
- *  Program version: 1.0
+ *  Program version: 1.10
  *  File: BootUARTDriver_STM32L0x3.c
  *  Modified from: STM32_UARTDriver/UARTDriver_STM32L0x3.c
  *  Change history:
@@ -12,11 +12,52 @@
  * Slight rework of the previously written UART1 driver code.
  * Deinit function added.
  *
+ * v.1.1.
+ * Command reception moved into the USART1 IRQ (RXNE and idle). The main loop sleeps (WFI) while waiting for a command instead of polling RXNE.
+ * Optional Stop mode wait with wake-up on start bit (boot_wait_stop_mode).
+ * BRR is calculated from the baud rate and the clock profile.
+ * Added reply function on UART1 Tx.
+ *
+ * v.1.2.
+ * Added DMA-driven stream on UART1 Tx (DMA1 Channel2) for FLASH readback.
+ *
+ * v.1.3.
+ * RS-485 driver enable on PA12 (uart1_rs485). Replies can be switched off for frames addressed to more than one node.
+ *
+ * v.1.4.
+ * Baud rate change at runtime with a probation period. If no frame comes through at the new rate, LPTIM1 switches us back to the old one.
+ *
+ * v.1.5.
+ * Optional auto baud rate detection on the first byte of the message start sequence (uart1_auto_baud).
+ *
+ * v.1.6.
+ * Optional RTS/CTS flow control (uart1_flow_control). CTS is handled by the USART, RTS is driven by us, so it can follow the FLASH and not only the RDR.
+ *
+ * v.1.7.
+ * Overrun detection is on again. Overrun, framing, noise and parity errors are counted per session and drop the frame or the rest of the image they hit.
+ *
+ * v.1.8.
+ * The flow control and the line error handling are called from the Rx IRQs, so they run from RAM with them (ram_update_path).
+ *
+ * v.1.9.
+ * Included through stm32l0xx.h, the part is picked by the device define of the build. The DMA transfer width is set by the caller from the device traits.
+ *
+ * v.1.10.
+ * Three sample majority vote on the data bits instead of one bit sampling. With ONEBIT set, the noise flag never came and the noise counter of the session was always 0.
+ *
  */
 
 #include <BootClockDriver_STM32L0x3.h>
 #include "BootUARTDriver_STM32L0x3.h"
-#include "stm32l053xx.h"
+#include "stm32l0xx.h"
+#include "BootLogDriver_STM32L0x3.h"
+#include "BootDMADriver_STM32L0x3.h"
+#include "BootIRQ_Control.h"
+#include "BootLogTokens.h"
+
+#if defined(uart1_flow_control) && defined(uart1_rs485)
+#error "uart1_flow_control and uart1_rs485 both need PA12 (RTS and DE)"
+#endif
 
 //1)UART init (no DMA)
 void UART1Config (void)
@@ -42,12 +83,30 @@ void UART1Config (void)
 	RCC->APB2ENR |= (1<<14);															//APB2 is the peripheral clock enable. Bit 14 is to enable the uart1 clock
 	RCC->IOPENR |= (1<<0);																//IOPENR enables the clock on the PORTA (PA10/D2 is Rx, PA9/D8 is Tx for USART1)
 //	RCC->CCIPR |= (2<<0);																//we could clock the UART using HSI16 as source (16 MHz). We currently clock on APB2 isnetad, which is also 16 MHz.
+#ifdef boot_wait_stop_mode
+	RCC->CCIPR &= ~(3<<0);
+	RCC->CCIPR |= (2<<0);																//in Stop mode, APB2 is off. USART1 must run on HSI16 to detect the start bit. BRR does not change - 16 MHz either way.
+#endif
+#ifdef uart1_auto_baud
+	RCC->CCIPR &= ~(3<<0);
+	RCC->CCIPR |= (2<<0);																//the auto baud rate detection counts in kernel clocks, so we need the 16 MHz of HSI16 on every clock profile
+#endif
 
 	//2)Set the GPIOs
 	GPIOA->MODER &= ~(1<<18);															//AF for PA9
 	GPIOA->MODER &= ~(1<<20);															//AF for PA10
 	GPIOA->OSPEEDR |= (3<<18) | (3<<20);												//very high speed PA9 and PA10
 	GPIOA->AFR[1] |= (1<<6) | (1<<10);													//from page 46 of the device datasheet, USART1 is on AF4 for PA9 and PA10 on the HIGH register of the AFR
+#ifdef uart1_rs485
+	GPIOA->MODER &= ~(1<<24);															//AF for PA12
+	GPIOA->AFR[1] |= (1<<18);															//PA12 is USART1_DE on AF4
+#endif
+#ifdef uart1_flow_control
+	GPIOA->MODER &= ~(1<<22);															//AF for PA11
+	GPIOA->AFR[1] |= (1<<14);															//PA11 is USART1_CTS on AF4
+	GPIOA->BSRR |= (1<<28);																//PA12 LOW - RTS asserted, the host may send
+	GPIOA->MODER &= ~(1<<25);															//PA12 is a GPIO output - we drive RTS ourselves (see UART1FlowHold)
+#endif
 																						//OTYPER and PUPDR are not written to since we want push/pull and no pull resistors
 
 	//3)Configure UART
@@ -66,20 +125,38 @@ void UART1Config (void)
 	USART1->CR2 &= ~(1<<12);															//One stop bit
 	USART1->CR2 &= ~(1<<13);
 
-	USART1->CR3 |= (1<<11);																//one bit sampling on data
-	USART1->CR3 |= (1<<12);																//overrun error disabled
+	USART1->CR3 &= ~(1<<11);															//three sample majority vote on data - ONEBIT would disable the noise detection (NF)
+																						//overrun error enabled (OVRDIS stays 0) - a lost byte shifts the whole image, we must know about it
+	USART1->CR3 |= (1<<0);																//EIE - framing, noise and overrun errors trigger the USART1 IRQ in DMA mode too
+#ifdef uart1_flow_control
+	USART1->CR3 |= (1<<9);																//CTSE - we only transmit while the host asserts CTS
+#endif
+#ifdef uart1_rs485
+	USART1->CR3 |= (1<<14);																//DEM - the UART1 drives the DE pin of the transceiver HIGH while it transmits
+	USART1->CR1 |= (1<<21) | (1<<16);													//DEAT and DEDT: 1/16 bit time of driver enable before the start bit and after the stop bit
+																						//DEP stays 0 - DE is active HIGH
+#endif
 																						//LSB first, CPOL clock polarity is standard, CPHA clock phase is standard
 
 //	USART1->BRR |= 0x683;																//we want to have a baud rate of 9600 with HSI16 as source (refman 779 proposes values for 32 MHz) and oversampling of 16
 
-	USART1->BRR |= 0x116;																//57600 baud rate using 16 MHz clocking and oversampling of 16
+//	USART1->BRR |= 0x116;																//57600 baud rate using 16 MHz clocking and oversampling of 16
 																						//Note: 115200 baud rate is just barely too fast for the DMA to restart between incoming UART bytes
+	UART1BaudUpdate();																	//BRR is calculated from UART1_baud_rate and the current clocking (0x116 for 57600 on 16 MHz)
 
 	//4)Enable the interrupts, set up errors
 	USART1->CR1 |= (1<<4);																//IDIE enabled. It activates the main USART1 IRQ.
 																						//Note: an idle frame is the word length, plus stop bit, plus start bit. This will be a bit longer than 1 ms (1.04 ms to be precise) at 9600 baud rate
 																						//Note: on an Adalogger, the Serial1 commands are NOT blocking!
 
+#ifdef boot_wait_stop_mode
+	//5)Wake-up from Stop mode
+	USART1->CR1 |= (1<<1);																//UESM - USART1 is able to wake up the mcu from Stop mode
+	USART1->CR3 |= (2<<20);																//WUS - wake-up on start bit detection
+	USART1->CR3 |= (1<<22);																//WUFIE - wake-up interrupt enabled
+	EXTI->IMR |= (1<<25);																//USART1 wake-up line (on by default after reset)
+#endif
+
 }
 
 
@@ -97,8 +174,8 @@ void UART1DMAEnable (void) {
 
 	USART1->CR3 |= (1<<6);																//DMA enabled on Rx (DMAR bit)
 
-	USART1->CR3 |= (1<<13);																//DMA is disabled on reception error
-																						//RXNE must be cleared or the DMA request removed to clear this
+	USART1->CR3 &= ~(1<<13);															//DDRE is 0: the DMA keeps on running through a reception error
+																						//Note: the IRQ counts the error and stops the FLASH writes (see UART1LineError), the DMA must only keep the pages in step
 
 	USART1->CR1 |= (1<<0);																//enable the UART1
 }
@@ -128,74 +205,62 @@ uint8_t UART1RxByte (void)
 //4)UART1 get the message - with message start sequence
 void UART1RxMessage(void) {
 	/*
-	 * 1)We enable the UART.
-	 * 2)While the timeout is not reached
-	 * 3)We check if we have the incoming message sequence detected
-	 * 4)If yes, we transfer incoming bytes to a memory buffer
-	 * 5)After the IRQ is triggered and we leave the state machine-in-the-loop, we reset everything and shut down the UART
+	 * 1)We enable the UART and the RXNE IRQ. From here, the USART1 IRQ collects the message (see UART1RxCommandByte below).
+	 * 2)We sleep until the IRQ tells us that the message is in the buffer
+	 * 3)After the message is received, we reset everything and shut down the UART
 	 *
 	 * Note: the start of the message is detected when 0xFOFO comes through the bus.
 	 * Note: the end of the message is detected when the bus has been idle for 2 bytes. This MUST be matched on the transmitter side by implementing an adequately sized delay between messages. Failing to do so freezes the bus.
 	 * Note: the bus is VERY noisy. If we don't sample the bus exactly where we should, we can capture fake data.
+	 * Note: the core does nothing while waiting for the message, so we let it sleep (WFI) instead of polling the RXNE flag. Any IRQ - RXNE, idle or TIM2 - wakes it up.
 	 *
 	 * */
 
 	//1)
+	UART1_Message_Received = No;
+	UART1_Message_Started = No;
+	UART1_Start_Byte_Detected_Once = No;
+	Rx_Message_buf_ptr = (uint8_t*) Rx_Message_buf;
+#ifdef uart1_auto_baud
+	if (UART1_Auto_Baud == Yes) {
+		UART1AutoBaudLock();															//we lock onto the rate of the host with the first 0xF0 - it is counted as the first start byte
+	} else {
+		//do nothing
+	}
+#endif
+	USART1->ICR |= 0xF;																	//we clear any line error flag from earlier traffic - these are not counted
+	USART1->CR1 |= (1<<5);																//RXNEIE enabled. Every incoming byte triggers the USART1 IRQ.
+	NVIC_ClearPendingIRQ(USART1_IRQn);
+	NVIC_EnableIRQ(USART1_IRQn);														//we activate the IRQ
 	USART1->CR1 |= (1<<0);																//enable the UART1
 
 	//2)
-	while (UART1_Message_Received == No){												//we execute the following section until the IRQ is triggered by an idle line
-		switch (UART1_Message_Started){
-		case No:
-			while(!((USART1->ISR & (1<<5)) == (1<<5)));									//RXNE bit. Goes HIGH when the data register is ready to be read out.
-			uint8_t Rx_byte_buf = USART1->RDR;											//reading the RDR clears the RXE flag
-
-			//3)
-			if(Rx_byte_buf == UART_message_start_byte) {								//we detected the start byte
-				switch (UART1_Start_Byte_Detected_Once){
-				case No:																//if this was the first time
-					UART1_Start_Byte_Detected_Once = Yes;
-					break;
-				case Yes:																//if this was the second time
-					UART1_Start_Byte_Detected_Once = No;
-					UART1_Message_Started = Yes;
-					break;
-				default:
-					break;
-				}
-
+	while (UART1_Message_Received == No){												//we sleep until the IRQ is triggered by an idle line
+		__disable_irq();
+		if (UART1_Message_Received == No) {
+#ifdef boot_wait_stop_mode
+			if ((UART1_Stop_Mode_Wait == Yes) && (UART1_Message_Started == No) && (UART1_Start_Byte_Detected_Once == No) && (BootLogBusy() == No)) {
+				BootStopMode();															//nothing is coming in and nothing is going out: we can stop the clocks
+				__enable_irq();															//the IRQ that woke us up runs now - on HSI16
+				SysClockProfile(Clock_Profile_HSI16);									//we wake up on HSI16 with the prescalers of the previous profile, so we tidy up
+																						//Note: this takes no PLL lock, and the UARTs run on HSI16 in this mode - the USART1 keeps on receiving
 			} else {
-				UART1_Start_Byte_Detected_Once = No;									//if the start byte is not detected twice in a sequence, we discard
+				__WFI();																//a message is coming in: we stay on full clock
 			}
-			break;
-
-		//4)
-		case Yes:
-
-			if((USART1->ISR & (1<<5)) == (1<<5)){										//if we have data in the RX buffer
-																						//Note: we don't use a while loop here to avoid being stuck (RXNE test comes after the idle test, which could freeze the bus)
-				USART1->ICR |= (1<<4);													//we clear the idle flag
-				NVIC_EnableIRQ(USART1_IRQn);											//we activate the IRQ
-																						//Note: the IRQ should only be active when we are receiving a message. Activating it earlier can lead to false triggers.
-																						//Note: we use an IRQ to end the message since we can't use a specific sequence to stop it. That sequence can very much be in the machine code.
-																						//Note: 0xFFFF is different to two idle frames due to the position of the start bit
-				*(Rx_Message_buf_ptr++) = USART1->RDR;									//we read out and reset the RXNE flag
-			} else {
-				//do nothing
-			}
-			break;
-
-		default:
-			break;
+#else
+			__WFI();																	//Note: WFI wakes up on a pending IRQ even with the IRQs masked, so we can't miss the flag between the check and the WFI
+#endif
 		}
+		__enable_irq();
 	}
 
-	//5)
+	//3)
 	NVIC_DisableIRQ(USART1_IRQn);
+	USART1->CR1 &= ~(1<<5);																//RXNEIE disabled
 	USART1->CR1 &= ~(1<<0);																//disable the UART1
 	UART1_Message_Received = No;														//we reset the message received flag
 	UART1_Message_Started = No;															//we reset the message started flag
-	Rx_Message_buf_ptr = Rx_Message_buf;												//we reset the buf pointer to its original spot
+	Rx_Message_buf_ptr = (uint8_t*) Rx_Message_buf;										//we reset the buf pointer to its original spot
 }
 
 
@@ -207,8 +272,395 @@ void UART1RxMessage(void) {
 	 */
 void UART1Deinit(void) {
 	USART1->CR1 &= ~(1<<0);																//disable the UART1
+	USART1->CR1 &= ~(1<<5);																//RXNEIE disabled
 	USART1->CR3 &= ~(1<<6);																//DMA disabled on Rx (DMAR bit)
 	DMA1_Channel3->CCR &= ~(1<<0);														//we disable the DMA channel
 	NVIC_DisableIRQ(DMA1_Channel2_3_IRQn);												//we disable the IRQ for the DMA
 	NVIC_DisableIRQ(USART1_IRQn);														//disable UART1 IRQ
 }
+
+
+//6)UART1 command byte reception
+void UART1RxCommandByte(uint8_t Rx_byte_buf) {
+	/*
+	 * Called from the USART1 IRQ for every incoming byte while we are in command mode (RXNEIE is on).
+	 * This is the same state machine that used to run in the polling loop of UART1RxMessage.
+	 *
+	 * 1)We check if we have the incoming message sequence detected
+	 * 2)If yes, we transfer incoming bytes to the Rx buffer
+	 *
+	 * Note: the idle IRQ only ends the message once the start sequence has been found.
+	 * Note: bytes that don't fit into the Rx buffer are discarded.
+	 *
+	 * */
+
+	switch (UART1_Message_Started){
+	//1)
+	case No:
+		if(Rx_byte_buf == UART_message_start_byte) {									//we detected the start byte
+			switch (UART1_Start_Byte_Detected_Once){
+			case No:																	//if this was the first time
+				UART1_Start_Byte_Detected_Once = Yes;
+				break;
+			case Yes:																	//if this was the second time
+				UART1_Start_Byte_Detected_Once = No;
+				USART1->ICR |= (1<<4);													//we clear the idle flag - we only count idle frames from here
+				UART1_Message_Started = Yes;
+				break;
+			default:
+				break;
+			}
+
+		} else {
+			UART1_Start_Byte_Detected_Once = No;										//if the start byte is not detected twice in a sequence, we discard
+		}
+		break;
+
+	//2)
+	case Yes:
+		if (Rx_Message_buf_ptr < ((uint8_t*) Rx_Message_buf + sizeof(Rx_Message_buf))) {
+			*(Rx_Message_buf_ptr++) = Rx_byte_buf;
+		} else {
+			//do nothing
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+//7)UART1 baud rate update
+void UART1BaudUpdate(void) {
+	/*
+	 * Calculates the BRR for UART1_baud_rate from the current UART1 kernel clock.
+	 * Called upon init and whenever the clock profile changes.
+	 *
+	 * 1)Find the kernel clock: HSI16 if selected in CCIPR, APB2 otherwise
+	 * 2)Calculate the BRR (oversampling of 16, rounded)
+	 * 3)If the BRR changes, we write it with the UART disabled - BRR can't be written while UE is set
+	 *
+	 * */
+
+	//1)
+	uint32_t UART1_kernel_clock;
+	if ((RCC->CCIPR & (3<<0)) == (2<<0)) {
+		UART1_kernel_clock = 16000000;
+	} else {
+		UART1_kernel_clock = GetPCLK2Freq();
+	}
+
+	//2)
+	uint32_t UART1_BRR = (UART1_kernel_clock + (UART1_baud_rate / 2)) / UART1_baud_rate;
+
+	//3)
+	if (USART1->BRR != UART1_BRR) {
+		uint32_t UART1_enabled = USART1->CR1 & (1<<0);
+		USART1->CR1 &= ~(1<<0);															//disable the UART1
+		USART1->BRR = UART1_BRR;
+		USART1->CR1 |= UART1_enabled;													//re-enable the UART1 if it was on
+	}
+}
+
+
+//8)UART1 send a reply
+void UART1TxReply(uint8_t reply_cmd, const uint8_t* reply_payload_ptr, uint16_t reply_payload_len) {
+	/*
+	 * Sends a reply to the master on UART1 Tx: the message start sequence (0xF0F0), the command we are replying to, then the payload.
+	 * Replies are short, so this is a blocking function.
+	 *
+	 * 1)Check that we may talk at all, then enable the UART1 (we restore its state at the end)
+	 * 2)Send the bytes one by one, waiting for TXE
+	 * 3)Wait until the last byte has left (TC)
+	 *
+	 * Note: multi-byte values in the payload are little endian.
+	 *
+	 * */
+
+	//1)
+	if (UART1_Reply_Enabled == No) return;												//frame was addressed to a group or to all nodes: we stay off the bus
+	uint32_t UART1_enabled = USART1->CR1 & (1<<0);
+	USART1->CR1 |= (1<<0);																//enable the UART1
+
+	//2)
+	uint8_t reply_header[3] = {UART_message_start_byte, UART_message_start_byte, reply_cmd};
+	for (uint8_t i = 0; i < 3; i++) {
+		while(!((USART1->ISR & (1<<7)) == (1<<7)));										//TXE bit. Goes HIGH when the data register is ready to be written to.
+		USART1->TDR = reply_header[i];
+	}
+	for (uint16_t i = 0; i < reply_payload_len; i++) {
+		while(!((USART1->ISR & (1<<7)) == (1<<7)));
+		USART1->TDR = reply_payload_ptr[i];
+	}
+
+	//3)
+	while(!((USART1->ISR & (1<<6)) == (1<<6)));											//TC bit
+	if (UART1_enabled == 0) USART1->CR1 &= ~(1<<0);										//disable the UART1 if it was off
+}
+
+
+//9)UART1 stream a block of memory
+void UART1TxStream(uint8_t reply_cmd, const uint8_t* stream_ptr, uint32_t stream_len) {
+	/*
+	 * Sends a reply header (0xF0F0, the command, the length as LE32), followed by a block of memory using DMA1 Channel2.
+	 * Used for FLASH readback, where the payload can be kilobytes long.
+	 *
+	 * 1)Send the header - blocking, it is only 7 bytes
+	 * 2)Set up the DMA and enable DMA on the UART1 Tx
+	 * 3)Send the block in chunks - CNDTR is only 16 bits wide
+	 * 4)Wait until the last byte has left the UART1 and restore the UART1
+	 *
+	 * Note: the core only waits on the DMA flag here. The UART1 Rx is not active (we are in command mode), so there is nothing else to do anyway.
+	 *
+	 * */
+
+	//1)
+	if (UART1_Reply_Enabled == No) return;
+	UART1TxReply(reply_cmd, (uint8_t*)&stream_len, 4);
+
+	//2)
+	uint32_t UART1_enabled = USART1->CR1 & (1<<0);
+	DMAChannelUART1TxConfig();
+	USART1->CR1 |= (1<<0);																//enable the UART1
+	USART1->CR3 |= (1<<7);																//DMA enabled on Tx (DMAT bit)
+
+	//3)
+	while (stream_len > 0) {
+		uint16_t chunk_len = (stream_len > 0x8000) ? 0x8000 : stream_len;
+		DMA1->IFCR |= (1<<4);															//we remove all the interrupt flags from Channel 2
+		DMA1_Channel2->CMAR = (uint32_t) stream_ptr;
+		DMA1_Channel2->CNDTR = chunk_len;
+		DMA1_Channel2->CCR |= (1<<0);													//we enable the DMA channel
+		while(!((DMA1->ISR & (1<<5)) == (1<<5)));										//TCIF2 - the last byte of the chunk has been handed over to the UART1
+		DMA1_Channel2->CCR &= ~(1<<0);													//we disable the DMA channel
+		stream_ptr += chunk_len;
+		stream_len -= chunk_len;
+	}
+
+	//4)
+	while(!((USART1->ISR & (1<<6)) == (1<<6)));											//TC bit
+	USART1->CR3 &= ~(1<<7);																//DMA disabled on Tx
+	DMA1->IFCR |= (1<<4);
+	if (UART1_enabled == 0) USART1->CR1 &= ~(1<<0);										//disable the UART1 if it was off
+}
+
+
+//10)UART1 baud rate check
+enum_Yes_No_Selector UART1BaudValid(uint32_t baud_rate) {
+	/*
+	 * Checks if a baud rate can be generated by the UART1.
+	 * A new baud rate always runs on HSI16 as kernel clock (see UART1BaudSwitch), so we check against 16 MHz and not the APB2 of the current clock profile.
+	 * On MSI, APB2 is only 2.097 MHz, which would limit us to roughly 130 kbaud.
+	 *
+	 * 1)Check the limits: with oversampling of 16, BRR can't be lower than 16 - 1 Mbaud on 16 MHz
+	 * 2)Check the rounding error of the BRR
+	 *
+	 * */
+
+	//1)
+	if ((baud_rate < UART1_baud_min) || (baud_rate > UART1_baud_max)) return No;
+
+	//2)
+	uint32_t UART1_BRR = (16000000 + (baud_rate / 2)) / baud_rate;
+	uint32_t actual_baud_rate = 16000000 / UART1_BRR;
+	uint32_t baud_error = (actual_baud_rate > baud_rate) ? (actual_baud_rate - baud_rate) : (baud_rate - actual_baud_rate);
+	if ((baud_error * 1000) > (baud_rate * UART1_baud_error_max)) return No;		//error is in 1/1000
+
+	return Yes;
+}
+
+
+//11)UART1 baud rate switch
+void UART1BaudSwitch(uint32_t new_baud_rate) {
+	/*
+	 * Switches the UART1 to a new baud rate (checked with UART1BaudValid) and starts the probation.
+	 * The reply to the host must be sent out BEFORE calling this - it goes out on the old rate.
+	 *
+	 * 1)Move the UART1 to HSI16 as kernel clock - the rate is then the same on every clock profile
+	 * 2)Keep the old rate for the fallback, write the new BRR
+	 * 3)Start the probation: LPTIM1 counts the seconds until a frame comes through on the new rate (see UART1BaudProbationEnd)
+	 *
+	 * Note: HSI16 stays on in the MSI profile if a UART uses it as kernel clock (see SysClockProfile).
+	 * Note: the kernel clock can only be changed with the UART1 disabled.
+	 *
+	 * */
+
+	//1)
+	RCC->CR |= (1<<0);																	//we turn on HSI16
+	while (!(RCC->CR & (1<<2)));
+	uint32_t UART1_enabled = USART1->CR1 & (1<<0);
+	USART1->CR1 &= ~(1<<0);																//disable the UART1
+	RCC->CCIPR &= ~(3<<0);
+	RCC->CCIPR |= (2<<0);																//UART1 runs on HSI16
+
+	//2)
+	UART1_Fallback_baud_rate = UART1_baud_rate;
+	UART1_baud_rate = new_baud_rate;
+	UART1BaudUpdate();
+	USART1->CR1 |= UART1_enabled;														//re-enable the UART1 if it was on
+
+	//3)
+	seconds_counter = 0;
+	UART1_Baud_Probation = Yes;
+	BootLPTIM1_INT();																	//LPTIM1 is free in external controller mode
+	BootLPTIM1IRQPriorEnable();
+}
+
+
+//12)UART1 baud rate probation end
+void UART1BaudProbationEnd(enum_Yes_No_Selector keep_new_rate) {
+	/*
+	 * Ends the probation of a new baud rate.
+	 * Called by the external controller once a frame came through on the new rate (keep_new_rate is Yes), or by the LPTIM1 IRQ when the probation ran out (No).
+	 *
+	 * 1)Stop the probation timer
+	 * 2)If the new rate did not work, we go back to the old one and drop whatever half-message we have in the buffer
+	 *
+	 * Note: the host must send a frame on the new rate within UART1_baud_probation_in_sec. Any frame with a start sequence will do, even one for another node.
+	 *
+	 * */
+
+	//1)
+	BootLPTIM1_DEINT();
+	UART1_Baud_Probation = No;
+	seconds_counter = 0;
+
+	//2)
+	if (keep_new_rate == No) {
+		UART1_baud_rate = UART1_Fallback_baud_rate;
+		UART1BaudUpdate();
+		UART1_Message_Started = No;
+		UART1_Start_Byte_Detected_Once = No;
+		Rx_Message_buf_ptr = (uint8_t*) Rx_Message_buf;
+		BootLogError(LogTok_Baud_fallback, UART1_baud_rate);
+	} else {
+		//do nothing
+	}
+}
+
+
+//13)UART1 auto baud rate lock
+void UART1AutoBaudLock(void) {
+	/*
+	 * Locks the UART1 onto the baud rate of the host using the first byte of the message start sequence (0xF0).
+	 * Returns once the rate is locked, with the first 0xF0 counted as received.
+	 *
+	 * The auto baud rate detection of the USART in mode 0 measures the start bit: from the falling edge to the first rising edge.
+	 * 0xF0 goes out LSB first, so the line stays low for the start bit AND the 4 low data bits. The hardware thus writes 5 bit times into the BRR, not one.
+	 * We divide it by 5 ourselves.
+	 *
+	 * 1)Arm the detection (ABREN, ABRMOD 0). The UART1 runs on HSI16 as kernel clock (see UART1Config).
+	 * 2)Wait for the measurement with the IRQs masked: we have 5 bit times (the 4 high data bits and the stop bit) to correct the BRR before the next start bit
+	 * 3)Correct the BRR with the UART1 disabled. The line is high for the rest of the 0xF0, so the receiver picks up cleanly on the start bit of the second 0xF0.
+	 * 4)Out of range or failed measurement (noise): we re-arm. Otherwise we switch the detection off and keep the rate.
+	 *
+	 * Note: IRQs that come in while we wait (boot window timer, log DMA) are let through between two checks of the flag. The boot window timer can still leave for the app.
+	 * Note: 5 bit times on 1 Mbaud is 5 us. This is why the boot window runs on HSI16 and not MSI in this mode.
+	 *
+	 * */
+
+	uint32_t UART1_BRR = 0;
+
+	//1)
+	USART1->CR1 &= ~(1<<0);																//disable the UART1
+	USART1->CR2 &= ~(3<<21);															//ABRMOD 0 - start bit measurement
+	USART1->CR2 |= (1<<20);																//ABREN
+	USART1->CR1 |= (1<<0);																//enable the UART1
+
+	while (UART1_BRR == 0) {
+
+		//2)
+		__disable_irq();
+		while (!((USART1->ISR & (1<<15)) == (1<<15))) {									//ABRF - goes HIGH when the measurement is done (or has failed)
+			if ((SCB->ICSR & SCB_ICSR_ISRPENDING_Msk) != 0) {
+				__enable_irq();															//we let the pending IRQ run
+				__disable_irq();
+			} else {
+				//do nothing
+			}
+		}
+
+		//3)
+		uint32_t UART1_ABR_status = USART1->ISR;
+		USART1->CR1 &= ~(1<<0);															//disable the UART1 - the rest of the 0xF0 is not received
+		UART1_BRR = USART1->BRR / 5;
+
+		//4)
+		if (((UART1_ABR_status & (1<<14)) == (1<<14)) || (UART1_BRR < 16) || (UART1_BRR > (16000000 / UART1_baud_min))) {	//ABRE or a rate outside of what we accept
+			UART1_BRR = 0;
+			USART1->CR1 |= (1<<0);
+			USART1->RQR |= (1<<0);														//ABRRQ - we measure the next character again
+		} else {
+			USART1->BRR = UART1_BRR;
+			USART1->CR2 &= ~(1<<20);													//ABREN off - the rate is locked
+			USART1->CR1 |= (1<<0);
+			UART1_Start_Byte_Detected_Once = Yes;										//the measured byte was the first 0xF0
+		}
+		__enable_irq();
+	}
+
+	UART1_baud_rate = (16000000 + (UART1_BRR / 2)) / UART1_BRR;						//clock profile changes recalculate the BRR from this
+}
+
+
+//14)UART1 flow control - hold the host
+__RAM_UPDATE_PATH void UART1FlowHold(void) {
+	/*
+	 * Deasserts RTS: the host stops sending after the byte it is on (uart1_flow_control only).
+	 * Called while the FLASH is busy and when both halves of the Rx buffer are full.
+	 *
+	 * Note: the hardware RTS of the USART (RTSE) only follows the RDR. The DMA empties the RDR right away, so RTSE would never stop the host. We drive PA12 ourselves instead.
+	 * Note: the pause of the host shows up as an idle frame. The next page resets the idle frame counter, so this does not end the session.
+	 *
+	 * */
+
+#ifdef uart1_flow_control
+	GPIOA->BSRR |= (1<<12);																//PA12 HIGH - RTS deasserted
+#endif
+}
+
+
+//15)UART1 flow control - release the host
+__RAM_UPDATE_PATH void UART1FlowRelease(void) {
+#ifdef uart1_flow_control
+	GPIOA->BSRR |= (1<<28);																//PA12 LOW - RTS asserted
+#endif
+}
+
+
+//16)UART1 line error
+__RAM_UPDATE_PATH void UART1LineError(uint32_t line_error_flags) {
+	/*
+	 * Called from the USART1 IRQ with the PE, FE, NF and ORE flags of the ISR.
+	 *
+	 * 1)We count the errors for the session report
+	 * 2)In programmer mode, nothing is written into the FLASH from here on. An overrun loses a byte, so even the pages after the error would be shifted.
+	 * 3)In command mode, we drop the frame - the host gets no reply and sends it again
+	 * 4)We clear the flags
+	 *
+	 * Note: the NF flag comes with a valid byte (the majority vote of the samples was fine), it is only counted. It tells us that the line is marginal.
+	 * Note: the DMA runs with DDRE off, so it does not stop on the error. The broken byte goes into the Rx buffer, but the page is never written.
+	 *
+	 * */
+
+	//1)
+	if ((line_error_flags & (1<<3)) == (1<<3)) Session_Stats.line_errors.overrun++;
+	if ((line_error_flags & (1<<1)) == (1<<1)) Session_Stats.line_errors.framing++;
+	if ((line_error_flags & (1<<2)) == (1<<2)) Session_Stats.line_errors.noise++;
+	if ((line_error_flags & (1<<0)) == (1<<0)) Session_Stats.line_errors.parity++;
+
+	if ((line_error_flags & ((1<<3) | (1<<1) | (1<<0))) == 0) {						//noise only: the byte is good
+		//do nothing
+	} else if (UART1_DMA_active == Yes) {
+		//2)
+		UART1_Line_Error_Hit = Yes;
+	} else {
+		//3)
+		UART1_Message_Started = No;
+		UART1_Start_Byte_Detected_Once = No;
+	}
+
+	//4)
+	USART1->ICR |= (line_error_flags & 0xF);											//PECF, FECF, NCF and ORECF
+}
@@ -17,6 +17,10 @@
 
 //LOCAL CONSTANT
 static const uint8_t UART_message_start_byte = 0xF0;		//the message start sequence is (twice this byte)
+#define UART1_baud_min					1200						//slowest rate we accept in a baud rate change
+#define UART1_baud_max					1000000						//BRR of 16 on 16 MHz with oversampling of 16
+#define UART1_baud_error_max			20							//largest rounding error of the BRR in 1/1000
+static const uint8_t UART1_baud_probation_in_sec = 2;		//time the host has to send a frame on a new baud rate
 
 //LOCAL VARIABLE
 static enum_Yes_No_Selector UART1_Start_Byte_Detected_Once = No;
@@ -24,8 +28,17 @@ static enum_Yes_No_Selector UART1_Start_Byte_Detected_Once = No;
 //EXTERNAL VARIABLE
 extern enum_Yes_No_Selector UART1_Message_Received;
 extern enum_Yes_No_Selector UART1_Message_Started;
-extern uint32_t Rx_Message_buf [64];						//we have a 32 bit MCU
+extern uint32_t Rx_Message_buf [Dev_Rx_buf_words];						//we have a 32 bit MCU
+extern enum_Yes_No_Selector UART1_Stop_Mode_Wait;				//Stop mode is allowed while waiting for a message (boot_wait_stop_mode only)
+extern uint32_t UART1_baud_rate;
+extern uint32_t UART1_Fallback_baud_rate;					//the rate we go back to if a new rate does not work
+extern enum_Yes_No_Selector UART1_Baud_Probation;				//a new baud rate is on trial until the first frame comes through
+extern enum_Yes_No_Selector UART1_Auto_Baud;					//every message locks onto the rate of the host (uart1_auto_baud only)
+extern enum_Yes_No_Selector UART1_Reply_Enabled;				//replies are off for group and broadcast frames - only one node may talk on a shared bus
 extern uint8_t* Rx_Message_buf_ptr;							//UART data is only 8 bits
+extern struct_Session_Stats Session_Stats;					//the line errors of the current programming session are counted in here
+extern enum_Yes_No_Selector UART1_Line_Error_Hit;				//a line error in programmer mode: the rest of the image is not written
+extern enum_Yes_No_Selector UART1_DMA_active;
 
 //FUNCTION PROTOTYPES
 void UART1Config (void);
@@ -33,6 +46,17 @@ uint8_t UART1RxByte (void);
 void UART1RxMessage(void);
 void UART1DMAEnable (void);
 void UART1Deinit(void);
+void UART1RxCommandByte(uint8_t Rx_byte_buf);
+void UART1BaudUpdate(void);
+void UART1TxStream(uint8_t reply_cmd, const uint8_t* stream_ptr, uint32_t stream_len);
+void UART1TxReply(uint8_t reply_cmd, const uint8_t* reply_payload_ptr, uint16_t reply_payload_len);
+enum_Yes_No_Selector UART1BaudValid(uint32_t baud_rate);
+void UART1BaudSwitch(uint32_t new_baud_rate);
+void UART1BaudProbationEnd(enum_Yes_No_Selector keep_new_rate);
+void UART1AutoBaudLock(void);
+void UART1FlowHold(void);
+void UART1FlowRelease(void);
+void UART1LineError(uint32_t line_error_flags);
 
 
 #endif /* INC_UARTDRIVER_CUSTOM_H_ */
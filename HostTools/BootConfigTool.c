@@ -0,0 +1,282 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.0
+ *  File: BootConfigTool.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Host side tool for the boot config record of the bootloader (0xbc).
+ *
+ * v.1.0
+ * Activates the external controller, reads the boot config the next reset will run on and prints it.
+ * With settings on the command line, only those are changed and the config is written back. The bootloader replies with what it has stored, so a rejected config shows up as a mismatch.
+ * The payload is the struct_Boot_Config of the bootloader: boot window (s), activation command, fast boot policy, reserved, baud rate (LE32), app base (LE32).
+ *
+ * Note: the new config only takes effect on the next reset of the device - the baud rate and the activation command included.
+ *
+ * Build: gcc -O2 -Wall -o bootconfigtool BootConfigTool.c
+ * Usage: bootconfigtool [-b baud] [-A activation] [-s] /dev/ttyUSB0 [window=5] [activation=0xc3] [baud=57600] [base=0x8008000] [fastboot=0|1]
+ *        bootconfigtool [-b baud] [-A activation] [-s] /dev/ttyUSB0 defaults
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+//LOCAL CONSTANT
+#define Msg_start_byte			0xF0
+#define Msg_gap_ms				10												//gap that closes a message on the bootloader side
+#define Reply_timeout_ms		2000
+#define Boot_config_size		12												//struct_Boot_Config of the bootloader
+#define Boot_config_read		0x00											//boot window that only asks for the reply
+#define Boot_config_clear		0xFF											//boot window that goes back to the compiled defaults
+
+
+//1)Serial port
+static void SleepMs(unsigned ms) {
+	struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+}
+
+
+static speed_t BaudToSpeed(long baud) {
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	default: return 0;
+	}
+}
+
+
+static int OpenSerialPort(const char* port_name, speed_t baud) {
+	int port_fd = open(port_name, O_RDWR | O_NOCTTY);
+	if (port_fd < 0) return -1;
+
+	struct termios tty;
+	if (tcgetattr(port_fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, baud);
+		cfsetospeed(&tty, baud);
+		tty.c_cc[VMIN] = 0;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(port_fd, TCSANOW, &tty);
+	}
+	tcflush(port_fd, TCIOFLUSH);
+	return port_fd;
+}
+
+
+static int ReadBytes(int port_fd, uint8_t* dst, size_t len) {
+	size_t rx_cnt = 0;
+	while (rx_cnt < len) {
+		struct pollfd pfd = { port_fd, POLLIN, 0 };
+		if (poll(&pfd, 1, Reply_timeout_ms) <= 0) return -1;
+		ssize_t rx_len = read(port_fd, dst + rx_cnt, len - rx_cnt);
+		if (rx_len <= 0) return -1;
+		rx_cnt += rx_len;
+	}
+	return 0;
+}
+
+
+//2)Commands
+/*
+ * 1)Start sequence, a gap, the command and its payload, another gap - the bootloader ends a message on its second idle frame
+ * 2)Replies are 0xF0 0xF0, the command, then the payload. Anything before the header is skipped.
+ *
+ * */
+static int SendCommand(int port_fd, uint8_t cmd, const uint8_t* payload, size_t payload_len) {
+	const uint8_t start_seq[2] = { Msg_start_byte, Msg_start_byte };
+	uint8_t msg_buf[1 + Boot_config_size];
+
+	//1)
+	msg_buf[0] = cmd;
+	if (payload_len) memcpy(&msg_buf[1], payload, payload_len);
+	if (write(port_fd, start_seq, 2) != 2) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+	if (write(port_fd, msg_buf, 1 + payload_len) != (ssize_t) (1 + payload_len)) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+	return 0;
+}
+
+
+static int ReadReply(int port_fd, uint8_t cmd, uint8_t* payload, size_t payload_len) {
+	uint8_t header[3] = {0};
+
+	//2)
+	while ((header[0] != Msg_start_byte) || (header[1] != Msg_start_byte) || (header[2] != cmd)) {
+		header[0] = header[1];
+		header[1] = header[2];
+		if (ReadBytes(port_fd, &header[2], 1) < 0) return -1;
+	}
+	return ReadBytes(port_fd, payload, payload_len);
+}
+
+
+static int ExchangeConfig(int port_fd, const uint8_t* config_out, uint8_t* config_in) {
+	if (SendCommand(port_fd, 0xbc, config_out, Boot_config_size) < 0) return -1;
+	return ReadReply(port_fd, 0xbc, config_in, Boot_config_size);
+}
+
+
+//3)Config fields
+static uint32_t GetLE32(const uint8_t* src) {
+	return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+
+static void PutLE32(uint8_t* dst, uint32_t value) {
+	dst[0] = value; dst[1] = value >> 8; dst[2] = value >> 16; dst[3] = value >> 24;
+}
+
+
+static void PrintConfig(const uint8_t* config) {
+	printf("window=%u activation=0x%02x baud=%u base=0x%x fastboot=%u\n", config[0], config[1], GetLE32(&config[4]), GetLE32(&config[8]), config[2]);
+}
+
+
+/*
+ * Settings are "name=value", values in C notation (0x... for hex).
+ *
+ * */
+static int ApplySetting(uint8_t* config, const char* setting) {
+	const char* value_str = strchr(setting, '=');
+	if (value_str == NULL) return -1;
+	size_t name_len = value_str - setting;
+	unsigned long value = strtoul(value_str + 1, NULL, 0);
+
+	if ((name_len == 6) && (strncmp(setting, "window", 6) == 0)) {
+		config[0] = value;
+	} else if ((name_len == 10) && (strncmp(setting, "activation", 10) == 0)) {
+		config[1] = value;
+	} else if ((name_len == 8) && (strncmp(setting, "fastboot", 8) == 0)) {
+		config[2] = value;
+	} else if ((name_len == 4) && (strncmp(setting, "baud", 4) == 0)) {
+		PutLE32(&config[4], value);
+	} else if ((name_len == 4) && (strncmp(setting, "base", 4) == 0)) {
+		PutLE32(&config[8], value);
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+			"Usage: bootconfigtool [options] /dev/ttyUSB0 [window=s] [activation=byte] [baud=rate] [base=addr] [fastboot=0|1]\n"
+			"       bootconfigtool [options] /dev/ttyUSB0 defaults\n"
+			"  without settings, the config of the next reset is only printed\n"
+			"  -b baud       UART1 baud rate (default 57600)\n"
+			"  -A byte       activation command (default 0xc3)\n"
+			"  -s            skip the activation (bootloader already in external controller mode)\n"
+			"  fastboot=1    no boot window after a power-on reset if the active app is confirmed\n");
+}
+
+
+int main(int argc, char** argv) {
+	long baud = 57600;
+	uint8_t activation_cmd = 0xc3;
+	int skip_activation = 0;
+	uint8_t config_out[Boot_config_size] = {0};
+	uint8_t config_in[Boot_config_size];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:A:s")) != -1) {
+		switch (opt) {
+		case 'b': baud = strtol(optarg, NULL, 10); break;
+		case 'A': activation_cmd = strtoul(optarg, NULL, 0); break;
+		case 's': skip_activation = 1; break;
+		default: PrintUsage(); return 2;
+		}
+	}
+	if ((argc - optind) < 1) {
+		PrintUsage();
+		return 2;
+	}
+	if (BaudToSpeed(baud) == 0) {
+		fprintf(stderr, "Unsupported baud rate\n");
+		return 2;
+	}
+
+	int port_fd = OpenSerialPort(argv[optind], BaudToSpeed(baud));
+	if (port_fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	/*
+	 * 1)Activate, then read the config of the next reset
+	 * 2)Change what is given on the command line and write it back - or go back to the defaults
+	 * 3)The reply is what the bootloader has stored: it must match what we sent
+	 *
+	 * */
+
+	//1)
+	if (!skip_activation && (SendCommand(port_fd, activation_cmd, NULL, 0) < 0)) goto fail_io;
+	config_out[0] = Boot_config_read;
+	if (ExchangeConfig(port_fd, config_out, config_in) < 0) {
+		fprintf(stderr, "No reply to 0xbc - is the bootloader in external controller mode?\n");
+		close(port_fd);
+		return 1;
+	}
+	if ((argc - optind) == 1) {
+		PrintConfig(config_in);
+		close(port_fd);
+		return 0;
+	}
+
+	//2)
+	if (strcmp(argv[optind + 1], "defaults") == 0) {
+		memset(config_out, 0, Boot_config_size);
+		config_out[0] = Boot_config_clear;
+	} else {
+		memcpy(config_out, config_in, Boot_config_size);
+		for (int i = optind + 1; i < argc; i++) {
+			if (ApplySetting(config_out, argv[i]) < 0) {
+				fprintf(stderr, "Unknown setting %s\n", argv[i]);
+				close(port_fd);
+				return 2;
+			}
+		}
+	}
+	if (ExchangeConfig(port_fd, config_out, config_in) < 0) {
+		fprintf(stderr, "No reply to 0xbc\n");
+		close(port_fd);
+		return 1;
+	}
+	close(port_fd);
+
+	//3)
+	PrintConfig(config_in);
+	if ((config_out[0] != Boot_config_clear) && (memcmp(config_out, config_in, Boot_config_size) != 0)) {
+		fprintf(stderr, "Config rejected by the bootloader - the one above stays\n");
+		return 1;
+	}
+	return 0;
+
+fail_io:
+	fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+	close(port_fd);
+	return 1;
+}
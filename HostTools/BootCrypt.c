@@ -0,0 +1,386 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.1
+ *  File: BootCrypt.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Host side tool for encrypted images (image_encrypted).
+ *
+ * v.1.0
+ * Encrypts an image with AES-128 in CTR mode for the bootloader: the image is padded to full pages with 0xFF, then encrypted with a random 12 byte nonce.
+ * The output (image.bin.enc) is a 16 byte header - "BENC" and the nonce - followed by the encrypted image. The flasher sends the nonce with 0xb3 and streams the rest.
+ * Uses the AES of the bootloader itself (BootAES.c), so the known-answer test (-T) checks the very same code that runs on the device.
+ * The benchmark (-b) has the bootloader decrypt a number of pages (0xb2) and prints the throughput next to what the link and the FLASH need.
+ *
+ * Note: the key file is 16 raw bytes. Without -k, the development key of BootImageCrypt.c is used.
+ * Note: for an image that is signed as well (image_signed), the tag is made over the plain image - sign first, then encrypt.
+ *
+ * v.1.1
+ * The known-answer test reports through BootTestCheck.h, like the other self-tests.
+ *
+ * Build: gcc -O2 -Wall -I.. -o bootcrypt BootCrypt.c ../BootAES.c
+ * Usage: bootcrypt [-k key.bin] image.bin
+ *        bootcrypt -T
+ *        bootcrypt -b 4096 [-p baud] [-A activation] [-s] /dev/ttyUSB0
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BootAES.h"
+#include "BootTestCheck.h"
+
+//LOCAL CONSTANT
+#define Flash_page_size			128												//the bootloader decrypts whole pages
+#define Flash_slot_size			0x4000											//one app slot
+#define Msg_start_byte			0xF0
+#define Msg_gap_ms				10												//gap that closes a message on the bootloader side
+#define Reply_timeout_ms		2000
+#define Crypt_nonce_size		12												//the rest of the counter block is the block index in the image
+#define Crypt_header_magic		"BENC"
+#define Bench_max_bytes			4096											//Bench_max_bytes of the bootloader (BootBench.h)
+#define Page_write_us			9600											//erase and two half-page writes of a page, 3.2 ms each typical in the datasheet - the session statistics (0xb9) have the real figure
+
+static const uint8_t Dev_key[AES_key_size] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+
+//1)Hex helpers
+static void HexString(const uint8_t* src, size_t len, char* dst) {
+	for (size_t i = 0; i < len; i++) sprintf(&dst[2 * i], "%02x", src[i]);
+}
+
+
+static size_t HexBytes(const char* src, uint8_t* dst) {
+	size_t len = 0;
+	while (src[0] && src[1]) {
+		unsigned byte;
+		sscanf(src, "%2x", &byte);
+		dst[len++] = byte;
+		src += 2;
+	}
+	return len;
+}
+
+
+//2)Known-answer test
+/*
+ * 1)AES-128 block: FIPS 197 appendix C.1
+ * 2)CTR-AES128: SP 800-38A F.5.1, four blocks - the counter there runs over the low 32 bits only, same as ours
+ * 3)Page by page: every page decrypted on its own with its block index must give the same as the whole image in one go
+ *
+ * */
+static int KnownAnswerTest(void) {
+	struct_AES_Ctx ctx;
+	uint8_t key[AES_key_size];
+	uint8_t block[AES_block_size];
+	uint8_t counter_block[AES_block_size];
+	uint8_t data[4 * AES_block_size];
+	int fail_cnt = 0;
+
+	//1)
+	HexBytes("000102030405060708090a0b0c0d0e0f", key);
+	HexBytes("00112233445566778899aabbccddeeff", block);
+	AESKeyExpand(&ctx, key);
+	AESEncryptBlock(&ctx, block, block);
+	fail_cnt += CheckBytes("aes128 fips197 c.1", block, AES_block_size, "69c4e0d86a7b0430d8cdb78070b4c55a");
+
+	//2)
+	HexBytes("2b7e151628aed2a6abf7158809cf4f3c", key);
+	HexBytes("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", counter_block);
+	HexBytes("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+			"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710", data);
+	AESKeyExpand(&ctx, key);
+	AESCTRCrypt(&ctx, counter_block, 0, data, sizeof(data));
+	fail_cnt += CheckBytes("ctr sp800-38a f.5.1", data, sizeof(data), "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff"
+			"5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee");
+
+	AESCTRCrypt(&ctx, counter_block, 0, data, sizeof(data));						//same operation both ways
+	fail_cnt += CheckBytes("ctr sp800-38a f.5.2", data, sizeof(data), "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+			"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+
+	//3)
+	uint8_t image_one_go[8 * Flash_page_size];
+	uint8_t image_by_page[8 * Flash_page_size];
+	for (int i = 0; i < (int) sizeof(image_one_go); i++) image_one_go[i] = i * 13;
+	memcpy(image_by_page, image_one_go, sizeof(image_by_page));
+	AESKeyExpand(&ctx, Dev_key);
+	AESCTRCrypt(&ctx, counter_block, 0, image_one_go, sizeof(image_one_go));
+	for (uint32_t page_offset = 0; page_offset < sizeof(image_by_page); page_offset += Flash_page_size) {
+		AESCTRCrypt(&ctx, counter_block, page_offset / AES_block_size, &image_by_page[page_offset], Flash_page_size);
+	}
+	fail_cnt += CheckCase("page by page", memcmp(image_one_go, image_by_page, sizeof(image_one_go)) == 0);
+
+	return fail_cnt;
+}
+
+
+//3)Encrypt an image
+static int EncryptImage(const char* image_name, const uint8_t* key) {
+	FILE* image_file = fopen(image_name, "rb");
+	if (image_file == NULL) {
+		fprintf(stderr, "Can't open %s: %s\n", image_name, strerror(errno));
+		return 1;
+	}
+	uint8_t* image_data = malloc(Flash_slot_size + 1);
+	size_t image_len = fread(image_data, 1, Flash_slot_size + 1, image_file);
+	fclose(image_file);
+	if ((image_len == 0) || (image_len > Flash_slot_size)) {
+		fprintf(stderr, "%s: image must be 1 to %d bytes\n", image_name, Flash_slot_size);
+		free(image_data);
+		return 1;
+	}
+	size_t padded_len = (image_len + Flash_page_size - 1) / Flash_page_size * Flash_page_size;
+	memset(&image_data[image_len], 0xFF, padded_len - image_len);				//same padding as the flasher - the bootloader writes the padding as well
+
+	/*
+	 * A nonce must never be used twice with the same key: it comes from /dev/urandom for every image.
+	 *
+	 * */
+	uint8_t header[4 + Crypt_nonce_size];
+	uint8_t counter_block[AES_block_size] = {0};
+	int random_fd = open("/dev/urandom", O_RDONLY);
+	if ((random_fd < 0) || (read(random_fd, counter_block, Crypt_nonce_size) != Crypt_nonce_size)) {
+		fprintf(stderr, "Can't get a nonce from /dev/urandom\n");
+		if (random_fd >= 0) close(random_fd);
+		free(image_data);
+		return 1;
+	}
+	close(random_fd);
+	memcpy(header, Crypt_header_magic, 4);
+	memcpy(&header[4], counter_block, Crypt_nonce_size);
+
+	struct_AES_Ctx ctx;
+	AESKeyExpand(&ctx, key);
+	AESCTRCrypt(&ctx, counter_block, 0, image_data, padded_len);
+
+	char enc_name[4096];
+	char nonce_hex[(2 * Crypt_nonce_size) + 1];
+	snprintf(enc_name, sizeof(enc_name), "%s.enc", image_name);
+	FILE* enc_file = fopen(enc_name, "wb");
+	if ((enc_file == NULL) || (fwrite(header, 1, sizeof(header), enc_file) != sizeof(header)) || (fwrite(image_data, 1, padded_len, enc_file) != padded_len)) {
+		fprintf(stderr, "Can't write %s: %s\n", enc_name, strerror(errno));
+		if (enc_file != NULL) fclose(enc_file);
+		free(image_data);
+		return 1;
+	}
+	fclose(enc_file);
+	free(image_data);
+	HexString(&header[4], Crypt_nonce_size, nonce_hex);
+	printf("%s: %zu bytes (%zu padded), nonce %s -> %s\n", image_name, image_len, padded_len, nonce_hex, enc_name);
+	return 0;
+}
+
+
+//4)Serial port
+static void SleepMs(unsigned ms) {
+	struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+}
+
+
+static speed_t BaudToSpeed(long baud) {
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	default: return 0;
+	}
+}
+
+
+static int OpenSerialPort(const char* port_name, speed_t baud) {
+	int port_fd = open(port_name, O_RDWR | O_NOCTTY);
+	if (port_fd < 0) return -1;
+
+	struct termios tty;
+	if (tcgetattr(port_fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, baud);
+		cfsetospeed(&tty, baud);
+		tty.c_cc[VMIN] = 0;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(port_fd, TCSANOW, &tty);
+	}
+	tcflush(port_fd, TCIOFLUSH);
+	return port_fd;
+}
+
+
+static int ReadBytes(int port_fd, uint8_t* dst, size_t len) {
+	size_t rx_cnt = 0;
+	while (rx_cnt < len) {
+		struct pollfd pfd = { port_fd, POLLIN, 0 };
+		if (poll(&pfd, 1, Reply_timeout_ms) <= 0) return -1;
+		ssize_t rx_len = read(port_fd, dst + rx_cnt, len - rx_cnt);
+		if (rx_len <= 0) return -1;
+		rx_cnt += rx_len;
+	}
+	return 0;
+}
+
+
+static uint32_t GetLE32(const uint8_t* src) {
+	return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+
+//5)Commands
+/*
+ * 1)Start sequence, a gap, the command and its payload, another gap - the bootloader ends a message on its second idle frame
+ * 2)Replies are 0xF0 0xF0, the command, then the payload. Anything before the header is skipped.
+ *
+ * */
+static int SendCommand(int port_fd, uint8_t cmd, const uint8_t* payload, size_t payload_len) {
+	const uint8_t start_seq[2] = { Msg_start_byte, Msg_start_byte };
+	uint8_t msg_buf[16];
+
+	//1)
+	msg_buf[0] = cmd;
+	if (payload_len) memcpy(&msg_buf[1], payload, payload_len);
+	if (write(port_fd, start_seq, 2) != 2) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+	if (write(port_fd, msg_buf, 1 + payload_len) != (ssize_t) (1 + payload_len)) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+	return 0;
+}
+
+
+static int ReadReply(int port_fd, uint8_t cmd, uint8_t* payload, size_t payload_len) {
+	uint8_t header[3] = {0};
+
+	//2)
+	while ((header[0] != Msg_start_byte) || (header[1] != Msg_start_byte) || (header[2] != cmd)) {
+		header[0] = header[1];
+		header[1] = header[2];
+		if (ReadBytes(port_fd, &header[2], 1) < 0) return -1;
+	}
+	return ReadBytes(port_fd, payload, payload_len);
+}
+
+
+//6)Decryption benchmark on the device
+/*
+ * 1)0xb2 with the number of bytes: the reply is the time in us and the core clock
+ * 2)Throughput and cycles per byte, next to the line rate and the FLASH - decryption must stay well below both
+ *
+ * Note: the time comes from TIM6 on the device (1 us steps). 4096 bytes is the most the bootloader takes.
+ *
+ * */
+static int Benchmark(int port_fd, uint16_t bench_len, long baud) {
+	uint8_t payload[2];
+	uint8_t bench_reply[8];
+
+	//1)
+	payload[0] = bench_len;
+	payload[1] = bench_len >> 8;
+	if ((SendCommand(port_fd, 0xb2, payload, 2) < 0) || (ReadReply(port_fd, 0xb2, bench_reply, sizeof(bench_reply)) < 0)) {
+		fprintf(stderr, "No reply to 0xb2 - is the bootloader built with image_encrypted and in external controller mode?\n");
+		return 1;
+	}
+
+	//2)
+	uint32_t bench_time_us = GetLE32(&bench_reply[0]);
+	uint32_t core_clock = GetLE32(&bench_reply[4]);
+	if (bench_time_us == 0) {
+		fprintf(stderr, "%u bytes took less than 1 us - use more bytes\n", bench_len);
+		return 1;
+	}
+	double page_us = (double) bench_time_us * Flash_page_size / bench_len;
+	printf("%u bytes in %u us at %u Hz: %.0f bytes/s, %.1f cycles/byte\n", bench_len, bench_time_us, core_clock,
+			bench_len * 1e6 / bench_time_us, (double) bench_time_us * (core_clock / 1e6) / bench_len);
+	printf("one page: %.0f us to decrypt, %.0f us on the line at %ld baud, about %d us to erase and write (datasheet)\n",
+			page_us, Flash_page_size * 10 * 1e6 / baud, baud, Page_write_us);
+	return 0;
+}
+
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+			"Usage: bootcrypt [-k key.bin] image.bin     writes the encrypted image into image.bin.enc\n"
+			"       bootcrypt -T                         known-answer test of the AES and the CTR mode\n"
+			"       bootcrypt -b bytes [options] /dev/ttyUSB0   decryption benchmark on the device (0xb2)\n"
+			"  -k key.bin    16 byte key (default: the development key)\n"
+			"  -p baud       UART1 baud rate (default 57600)\n"
+			"  -A byte       activation command (default 0xc3)\n"
+			"  -s            skip the activation (bootloader already in external controller mode)\n");
+}
+
+
+int main(int argc, char** argv) {
+	uint8_t key[AES_key_size];
+	long baud = 57600;
+	uint8_t activation_cmd = 0xc3;
+	int skip_activation = 0;
+	long bench_len = 0;
+	int opt;
+
+	memcpy(key, Dev_key, AES_key_size);
+	while ((opt = getopt(argc, argv, "k:Tb:p:A:s")) != -1) {
+		switch (opt) {
+		case 'k':
+		{
+			FILE* key_file = fopen(optarg, "rb");
+			size_t key_len = (key_file != NULL) ? fread(key, 1, AES_key_size, key_file) : 0;
+			if (key_file != NULL) fclose(key_file);
+			if (key_len != AES_key_size) {
+				fprintf(stderr, "Can't load the %d byte key from %s\n", AES_key_size, optarg);
+				return 1;
+			}
+			break;
+		}
+		case 'T': return (KnownAnswerTest() == 0) ? 0 : 1;
+		case 'b': bench_len = strtol(optarg, NULL, 0); break;
+		case 'p': baud = strtol(optarg, NULL, 10); break;
+		case 'A': activation_cmd = strtoul(optarg, NULL, 0); break;
+		case 's': skip_activation = 1; break;
+		default: PrintUsage(); return 2;
+		}
+	}
+	if ((argc - optind) != 1) {
+		PrintUsage();
+		return 2;
+	}
+
+	if (bench_len == 0) return EncryptImage(argv[optind], key);
+
+	if ((bench_len < 0) || (bench_len > Bench_max_bytes) || (bench_len % Flash_page_size) || (BaudToSpeed(baud) == 0)) {
+		fprintf(stderr, "Benchmark is full pages, up to %d bytes, on a supported baud rate\n", Bench_max_bytes);
+		return 2;
+	}
+	int port_fd = OpenSerialPort(argv[optind], BaudToSpeed(baud));
+	if (port_fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	if (!skip_activation && (SendCommand(port_fd, activation_cmd, NULL, 0) < 0)) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		close(port_fd);
+		return 1;
+	}
+	int result = Benchmark(port_fd, bench_len, baud);
+	close(port_fd);
+	return result;
+}
@@ -0,0 +1,853 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.3
+ *  File: BootDevSim.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Stand-in for the bootloader on a pseudo terminal, so the host tools can be run without a board.
+ *
+ * v.1.0
+ * Opens a pty, links its slave side to the name given on the command line and answers on it like UART1 of the bootloader in external controller mode.
+ * A gap of Idle_frame_ms is an idle frame: the second idle after "0xF0 0xF0" ends a message, the second idle after the last full page ends the image stream - same as on the device.
+ * Runs the update path of the bootloader: 0xb5 slot status, 0xbb and 0xb6 update (with the resume progress), the session report (0xbf) and the FLASH verify (0xb8). Other commands are ignored.
+ * The update slot is kept in RAM. Faults can be injected: a line error after some pages (-e) - the rest of the image is dropped, like after an overrun on the device - or a page written wrong (-x).
+ * The self-test (-T) runs the flasher given to it against the stand-in: plain update, line error, resumable update, verify and link address check.
+ *
+ * Note: the stand-in checks the protocol and the host side, not the timing. The idle frame is a few ms on a pty, so the flasher should be run with a bigger message gap (-m 20).
+ *
+ * v.1.1
+ * Several ports at once, one thread each, for the multi-port mode of the flasher. Every port gets the same set of nodes.
+ * Bus mode (-N): several nodes on one port, each with its address and group, like a shared RS-485 bus. Addressed frames (0xAD) are checked the way the bootloader does.
+ * Only a node addressed on its own replies. Nodes that are not addressed by an update, and every node of a group or broadcast 0xb6, sit the image out as bystanders. Plain frames are ignored on a bus.
+ * The self-test adds the multi-port mode, a single node on the bus, a group and a broadcast update, a line error on one node of a group and a group 0xb6.
+ *
+ * v.1.2
+ * 0xb8 refuses a start address past the slot before the page count check, same as the bootloader. The self-test sends two such addresses.
+ *
+ * v.1.3
+ * Cases are reported through BootTestCheck.h, shared with the other self-tests.
+ *
+ * Build: gcc -O2 -Wall -pthread -o bootdevsim BootDevSim.c
+ * Usage: bootdevsim [-e pages] [-x page] [-N 1:0,2:0,3:1] /tmp/ttySIM0 [/tmp/ttySIM1 ...]
+ *        bootdevsim [-v] -T ./bootflasher
+ *
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "BootTestCheck.h"
+
+//LOCAL CONSTANT
+#define Flash_page_size			128												//one page of FLASH - the bootloader writes the image in these steps
+#define Flash_slot_size			0x4000											//one app slot
+#define Flash_base_addr			0x08000000										//page numbers of the verify are counted from here
+#define Update_slot_addr		0x0800C000										//the stand-in runs from slot A and updates slot B
+#define Slot_record				0xB0070000										//magic, confirmed, slot A active
+#define Verify_max_pages		62
+#define Msg_start_byte			0xF0
+#define Cmd_addressed_frame		0xAD											//0xF0 0xF0 0xAD target command payload
+#define Target_group_base		0xE0
+#define Target_all_nodes		0xFF
+#define Sim_max_nodes			8
+#define Sim_max_ports			8
+#define Rx_message_max			256
+#define Idle_frame_ms			3												//a gap this long is an idle frame for the stand-in
+#define Test_image_len			5000											//the last page is padded
+#define Test_image_pages		((Test_image_len + Flash_page_size - 1) / Flash_page_size)
+
+//LOCAL TYPE
+typedef enum {
+	Sim_Wait_Start,
+	Sim_Message,
+	Sim_Programming
+} enum_Sim_State;
+
+typedef struct {
+	uint8_t addr;																//node record: address and group
+	uint8_t group;
+	int reply_enabled;															//the last frame was for this node alone
+	int bystander;																//the image on the line is for other nodes
+	enum_Sim_State state;
+	uint8_t start_cnt;															//0xF0 bytes in a row
+	uint8_t idle_cnt;
+	uint8_t msg_buf[Rx_message_max];
+	uint32_t msg_len;
+	uint8_t page_buf[Flash_page_size];
+	uint32_t page_len;
+	uint32_t prog_offset;														//where the next page goes in the slot
+	uint16_t pages_received;
+	uint16_t pages_accepted;
+	int line_error_hit;
+	uint16_t line_errors[4];													//overrun, framing, noise, parity
+	uint16_t report_pages;														//the last session report
+	uint16_t report_errors[4];
+	int resumable;
+	uint32_t image_id;															//resume progress, as in the data EEPROM of the device
+	uint32_t image_size;
+	uint32_t next_offset;
+	int line_error_after;														//fault: line error after this many pages (-1: none)
+	int corrupt_page;															//fault: this page of the slot is written wrong (-1: none)
+	uint8_t flash[Flash_slot_size];
+} Sim_Node;
+
+typedef struct {
+	const char* link_name;
+	int master_fd;
+	int slave_fd;																//kept open, so the master never sees a hang-up between two flasher runs
+	pthread_t thread;
+	pthread_mutex_t lock;														//the test changes the node between two runs
+	volatile int stop;
+	int bus;																	//more than one node: plain frames are ignored
+	int node_cnt;
+	Sim_Node nodes[Sim_max_nodes];
+} Sim_Port;
+
+static int Show_flasher_output = 0;
+
+
+//1)CRC - same as the CRC unit of the STM32 in its reset configuration (CRC-32/MPEG-2, fed with 32-bit little endian words)
+static uint32_t CrcWords(uint32_t crc, const uint8_t* data, uint32_t len) {
+	for (uint32_t i = 0; i + 3 < len; i += 4) {
+		crc ^= (uint32_t) data[i] | ((uint32_t) data[i + 1] << 8) | ((uint32_t) data[i + 2] << 16) | ((uint32_t) data[i + 3] << 24);
+		for (int b = 0; b < 32; b++) {
+			crc = (crc & 0x80000000) ? ((crc << 1) ^ 0x04C11DB7) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+
+static void PutLE16(uint8_t* dst, uint16_t value) {
+	dst[0] = value; dst[1] = value >> 8;
+}
+
+
+static void PutLE32(uint8_t* dst, uint32_t value) {
+	dst[0] = value; dst[1] = value >> 8; dst[2] = value >> 16; dst[3] = value >> 24;
+}
+
+
+static uint32_t GetLE32(const uint8_t* src) {
+	return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+
+//2)Node
+static void NodeReset(Sim_Node* node) {
+	uint8_t addr = node->addr;
+	uint8_t group = node->group;
+	memset(node, 0, sizeof(Sim_Node));
+	node->addr = addr;
+	node->group = group;
+	memset(node->flash, 0xFF, Flash_slot_size);									//erased FLASH value
+	node->line_error_after = -1;
+	node->corrupt_page = -1;
+}
+
+
+static void NodeReply(Sim_Port* port, const Sim_Node* node, uint8_t cmd, const uint8_t* payload, uint32_t payload_len) {
+	uint8_t tx_buf[3 + Rx_message_max];
+	if (!node->reply_enabled) return;											//frame was addressed to a group or to all nodes: we stay off the bus
+	tx_buf[0] = Msg_start_byte;
+	tx_buf[1] = Msg_start_byte;
+	tx_buf[2] = cmd;
+	memcpy(&tx_buf[3], payload, payload_len);
+	if (write(port->master_fd, tx_buf, 3 + payload_len) < 0) {
+		//do nothing - the host is gone, it will time out
+	}
+}
+
+
+static void NodeReportSend(Sim_Port* port, Sim_Node* node) {
+	uint8_t report[10];
+	PutLE16(&report[0], node->report_pages);
+	for (int i = 0; i < 4; i++) PutLE16(&report[2 + (2 * i)], node->report_errors[i]);
+	NodeReply(port, node, 0xbf, report, 10);
+}
+
+
+static void NodeProgrammerModeEnter(Sim_Node* node) {
+	node->state = Sim_Programming;
+	node->idle_cnt = 0;
+	node->page_len = 0;
+	node->pages_received = 0;
+	node->pages_accepted = 0;
+	node->line_error_hit = 0;
+	memset(node->line_errors, 0, sizeof(node->line_errors));
+}
+
+
+//A full page came in
+/*
+ * 1)After a line error, the rest of the image is dropped - the host sees fewer pages in the report
+ * 2)The page is written, wrong if that is the fault we inject, and the resume progress is stepped
+ *
+ * */
+static void NodePageIn(Sim_Node* node) {
+	node->pages_received++;
+	if (node->bystander) return;
+
+	//1)
+	if ((node->line_error_after >= 0) && (node->pages_received > node->line_error_after) && !node->line_error_hit) {
+		node->line_error_hit = 1;
+		node->line_errors[0]++;
+	}
+	if (node->line_error_hit || (node->prog_offset >= Flash_slot_size)) return;
+
+	//2)
+	memcpy(&node->flash[node->prog_offset], node->page_buf, Flash_page_size);
+	if ((int) (node->prog_offset / Flash_page_size) == node->corrupt_page) node->flash[node->prog_offset + 5] ^= 0x20;
+	node->prog_offset += Flash_page_size;
+	node->pages_accepted++;
+	if (node->resumable) node->next_offset = node->prog_offset;
+}
+
+
+//The image stream is over
+static void NodeSessionEnd(Sim_Port* port, Sim_Node* node) {
+	node->state = Sim_Wait_Start;
+	node->start_cnt = 0;
+	if (node->bystander) {														//the image was not for us: no report, the last one stays
+		node->bystander = 0;
+		return;
+	}
+	node->report_pages = node->line_error_hit ? node->pages_accepted : node->pages_received;
+	memcpy(node->report_errors, node->line_errors, sizeof(node->report_errors));
+	NodeReportSend(port, node);
+	if (node->resumable && (node->next_offset >= node->image_size)) {
+		node->image_id = 0;														//the full image is in: the progress is cleared
+		node->next_offset = 0;
+	}
+	node->resumable = 0;
+}
+
+
+//3)Command addressing
+/*
+ * Returns where the command is in the message, or NULL if the frame is not for this node - same as UART1CommandForThisNode of the bootloader.
+ *
+ * 1)Plain frame: it is for us, unless we are on a bus
+ * 2)Addressed frame: we check the target against the node record
+ * 3)Replies are only allowed if the frame was for this node alone
+ * 4)If another node is about to receive an image, we become a bystander for the session
+ *
+ * */
+static const uint8_t* NodeCommandForThisNode(const Sim_Port* port, Sim_Node* node) {
+	const uint8_t* command_ptr = node->msg_buf;
+	node->bystander = 0;
+
+	//1)
+	if ((node->msg_len == 0) || (command_ptr[0] != Cmd_addressed_frame)) {
+		node->reply_enabled = 1;
+		return port->bus ? NULL : command_ptr;
+	}
+	if (node->msg_len < 3) return NULL;
+
+	//2)
+	uint8_t target = command_ptr[1];
+	if (target == node->addr) {
+		node->reply_enabled = 1;												//3)
+	} else if ((target == Target_all_nodes) || ((target >= Target_group_base) && ((target - Target_group_base) == node->group))) {
+		node->reply_enabled = 0;
+	} else {
+		//4)
+		if ((command_ptr[2] == 0xbb) || (command_ptr[2] == 0xb6)) {
+			node->reply_enabled = 0;
+			node->bystander = 1;
+		}
+		return NULL;
+	}
+	return &command_ptr[2];
+}
+
+
+//4)Commands
+/*
+ * 1)Slot status: the record, then the slot the update goes to
+ * 2)Plain update: the progress is cleared
+ * 3)Resumable update: the same image ID picks up where the last session stopped, anything else starts over. The reply has the CRC of the image up to the offset.
+ * 4)Verify: one CRC per page, the reply lists the pages that don't match
+ *
+ * */
+static void NodeCommand(Sim_Port* port, Sim_Node* node) {
+	const uint8_t* command_ptr = NodeCommandForThisNode(port, node);
+	uint8_t reply[2 + (2 * Verify_max_pages)];
+
+	if (node->bystander) {														//an image for other nodes on the bus is coming: we take it off the line without writing it
+		NodeProgrammerModeEnter(node);
+		return;
+	}
+	if ((command_ptr == NULL) || (command_ptr == &node->msg_buf[node->msg_len])) return;
+	uint32_t cmd_len = node->msg_len - (command_ptr - node->msg_buf);
+
+	switch (command_ptr[0]) {
+
+	case 0xb5:
+		//1)
+		PutLE32(&reply[0], Slot_record);
+		PutLE32(&reply[4], Update_slot_addr);
+		NodeReply(port, node, 0xb5, reply, 8);
+		break;
+
+	case 0xbb:
+		//2)
+		node->resumable = 0;
+		node->image_id = 0;
+		node->next_offset = 0;
+		node->prog_offset = 0;
+		NodeProgrammerModeEnter(node);
+		break;
+
+	case 0xb6:
+	{
+		//3)
+		if (cmd_len < 9) break;
+		if (!node->reply_enabled) {												//every node resumes from its own offset, so this only works node by node
+			node->bystander = 1;
+			NodeProgrammerModeEnter(node);
+			break;
+		}
+		uint32_t image_id = GetLE32(&command_ptr[1]);
+		uint32_t image_size = GetLE32(&command_ptr[5]);
+		if ((image_size == 0) || (image_size > Flash_slot_size)) {
+			PutLE32(&reply[0], 0xFFFFFFFF);
+			NodeReply(port, node, 0xb6, reply, 4);
+			break;
+		}
+		if ((image_id != node->image_id) || (image_size != node->image_size) || (node->next_offset >= image_size)) {
+			node->image_id = image_id;
+			node->image_size = image_size;
+			node->next_offset = 0;
+		}
+		node->resumable = 1;
+		node->prog_offset = node->next_offset;
+		NodeProgrammerModeEnter(node);
+		PutLE32(&reply[0], node->next_offset);
+		PutLE32(&reply[4], CrcWords(0xFFFFFFFF, node->flash, node->next_offset));
+		NodeReply(port, node, 0xb6, reply, 8);
+		break;
+	}
+
+	case 0xbf:
+		NodeReportSend(port, node);
+		break;
+
+	case 0xb8:
+	{
+		//4)
+		if (cmd_len < 6) break;
+		uint32_t verify_addr = GetLE32(&command_ptr[1]);
+		uint8_t verify_page_cnt = command_ptr[5];
+		uint16_t mismatch_cnt = 0;
+		if ((verify_addr < Update_slot_addr) || (verify_addr >= Update_slot_addr + Flash_slot_size) || ((verify_addr % Flash_page_size) != 0) || (verify_page_cnt > Verify_max_pages)
+				|| ((verify_page_cnt * Flash_page_size) > (Update_slot_addr + Flash_slot_size - verify_addr)) || (cmd_len < 6 + (4u * verify_page_cnt))) {
+			mismatch_cnt = 0xFFFF;
+		} else {
+			for (uint8_t i = 0; i < verify_page_cnt; i++) {
+				uint32_t page_addr = verify_addr + (i * Flash_page_size);
+				if (CrcWords(0xFFFFFFFF, &node->flash[page_addr - Update_slot_addr], Flash_page_size) != GetLE32(&command_ptr[6 + (4 * i)])) {
+					PutLE16(&reply[2 + (2 * mismatch_cnt)], (page_addr - Flash_base_addr) / Flash_page_size);
+					mismatch_cnt++;
+				}
+			}
+		}
+		PutLE16(&reply[0], mismatch_cnt);
+		NodeReply(port, node, 0xb8, reply, (mismatch_cnt == 0xFFFF) ? 2 : (2 + (2 * mismatch_cnt)));
+		break;
+	}
+
+	default:
+		//do nothing - the activation command ends up here too: the stand-in is always in external controller mode
+		break;
+	}
+}
+
+
+//5)Receiver
+static void NodeRxByte(Sim_Node* node, uint8_t rx_byte) {
+	switch (node->state) {
+	case Sim_Programming:
+		node->page_buf[node->page_len++] = rx_byte;
+		if (node->page_len == Flash_page_size) {
+			NodePageIn(node);
+			node->page_len = 0;
+			node->idle_cnt = 0;
+		}
+		break;
+
+	case Sim_Message:
+		if (node->msg_len < Rx_message_max) node->msg_buf[node->msg_len++] = rx_byte;
+		break;
+
+	default:
+		node->start_cnt = (rx_byte == Msg_start_byte) ? node->start_cnt + 1 : 0;
+		if (node->start_cnt == 2) {
+			node->state = Sim_Message;
+			node->msg_len = 0;
+			node->idle_cnt = 0;
+		}
+		break;
+	}
+}
+
+
+static void NodeIdleFrame(Sim_Port* port, Sim_Node* node) {
+	switch (node->state) {
+	case Sim_Programming:
+		if (++node->idle_cnt == 2) NodeSessionEnd(port, node);				//the filler byte comes between the two idle frames
+		break;
+
+	case Sim_Message:
+		if (++node->idle_cnt == 2) {
+			node->state = Sim_Wait_Start;
+			node->start_cnt = 0;
+			NodeCommand(port, node);
+		}
+		break;
+
+	default:
+		node->start_cnt = 0;
+		break;
+	}
+}
+
+
+//6)Pseudo terminal
+/*
+ * 1)The nodes: one node 0 in group 0 (a fresh device), or the bus given as "address:group,..."
+ * 2)The pty, linked to the given name
+ *
+ * */
+static int PortOpen(Sim_Port* port, const char* link_name, const char* node_list) {
+	struct termios tty;
+
+	port->link_name = link_name;
+	port->stop = 0;
+	pthread_mutex_init(&port->lock, NULL);
+
+	//1)
+	port->bus = (node_list != NULL);
+	port->node_cnt = 0;
+	for (const char* node_ptr = node_list; (node_ptr != NULL) && (*node_ptr != '\0') && (port->node_cnt < Sim_max_nodes); ) {
+		char* end_ptr;
+		Sim_Node* node = &port->nodes[port->node_cnt++];
+		node->addr = strtoul(node_ptr, &end_ptr, 0);
+		node->group = (*end_ptr == ':') ? strtoul(end_ptr + 1, &end_ptr, 0) : 0;
+		if ((node->addr >= Target_group_base) || ((*end_ptr != ',') && (*end_ptr != '\0'))) {
+			errno = EINVAL;
+			return -1;
+		}
+		node_ptr = (*end_ptr == ',') ? end_ptr + 1 : end_ptr;
+	}
+	if (port->node_cnt == 0) {
+		port->node_cnt = 1;
+		port->nodes[0].addr = 0;
+		port->nodes[0].group = 0;
+	}
+	for (int i = 0; i < port->node_cnt; i++) NodeReset(&port->nodes[i]);
+
+	//2)
+	port->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((port->master_fd < 0) || (grantpt(port->master_fd) < 0) || (unlockpt(port->master_fd) < 0)) return -1;
+	const char* slave_name = ptsname(port->master_fd);
+	if (slave_name == NULL) return -1;
+	port->slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+	if ((port->slave_fd < 0) || (tcgetattr(port->slave_fd, &tty) < 0)) return -1;
+	cfmakeraw(&tty);
+	tcsetattr(port->slave_fd, TCSANOW, &tty);
+	unlink(link_name);
+	if (symlink(slave_name, link_name) < 0) return -1;
+	fprintf(stderr, "%s -> %s\n", link_name, slave_name);
+	return 0;
+}
+
+
+static void PortClose(Sim_Port* port) {
+	unlink(port->link_name);
+	close(port->slave_fd);
+	close(port->master_fd);
+}
+
+
+/*
+ * 1)Bytes go to every node on the port as they come - they all see the same line
+ * 2)No byte for Idle_frame_ms after some came in: idle frame
+ *
+ * */
+static void* PortThread(void* arg) {
+	Sim_Port* port = arg;
+	int rx_since_idle = 0;
+	uint8_t rx_buf[4096];
+
+	while (!port->stop) {
+		struct pollfd pfd = { port->master_fd, POLLIN, 0 };
+		if (poll(&pfd, 1, Idle_frame_ms) > 0) {
+			//1)
+			ssize_t rx_len = read(port->master_fd, rx_buf, sizeof(rx_buf));
+			if (rx_len <= 0) {
+				poll(NULL, 0, 10);
+				continue;
+			}
+			pthread_mutex_lock(&port->lock);
+			for (int node = 0; node < port->node_cnt; node++) {
+				for (ssize_t i = 0; i < rx_len; i++) NodeRxByte(&port->nodes[node], rx_buf[i]);
+			}
+			pthread_mutex_unlock(&port->lock);
+			rx_since_idle = 1;
+		} else if (rx_since_idle) {
+			//2)
+			pthread_mutex_lock(&port->lock);
+			for (int node = 0; node < port->node_cnt; node++) NodeIdleFrame(port, &port->nodes[node]);
+			pthread_mutex_unlock(&port->lock);
+			rx_since_idle = 0;
+		}
+	}
+	return NULL;
+}
+
+
+//7)Self-test
+/*
+ * Every case runs the flasher as a separate process against the stand-in and checks its exit code and the FLASH of the node.
+ *
+ * 1)Plain update with verify: PASS, the slot holds the image
+ * 2)Line error after 10 pages: the flasher must fail on the session report, nothing after page 10 is written
+ * 3)Resumable update: the first run is cut by a line error, the second one picks up at page 10 and completes the image
+ * 4)One page written wrong: the session report is fine, the verify must catch it
+ * 5)Image linked for the other slot: refused before anything is written
+ *
+ * */
+static int RunFlasher(const char* flasher_path, const char* const* args) {
+	char* argv[24];
+	int argc = 0;
+	argv[argc++] = (char*) flasher_path;
+	argv[argc++] = "-m";
+	argv[argc++] = "20";
+	argv[argc++] = "-w";
+	argv[argc++] = "20";
+	while ((*args != NULL) && (argc < 23)) argv[argc++] = (char*) *args++;
+	argv[argc] = NULL;
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (!Show_flasher_output) {
+			int null_fd = open("/dev/null", O_WRONLY);
+			dup2(null_fd, STDOUT_FILENO);
+			dup2(null_fd, STDERR_FILENO);
+		}
+		execv(flasher_path, argv);
+		_exit(127);
+	}
+	int status;
+	if ((pid < 0) || (waitpid(pid, &status, 0) < 0) || !WIFEXITED(status)) return -1;
+	return WEXITSTATUS(status);
+}
+
+
+static int WriteTestImage(const char* file_name, uint8_t* image, uint32_t link_addr) {
+	uint32_t seed = 0x12345678;
+	for (uint32_t i = 0; i < Test_image_len; i++) {
+		seed = (seed * 1103515245) + 12345;
+		image[i] = seed >> 16;
+	}
+	PutLE32(&image[0], 0x20002000);											//stack pointer
+	PutLE32(&image[4], link_addr + 0x101);										//reset vector, thumb
+	FILE* f = fopen(file_name, "wb");
+	if ((f == NULL) || (fwrite(image, 1, Test_image_len, f) != Test_image_len)) return -1;
+	fclose(f);
+	return 0;
+}
+
+
+static int FlashHolds(const Sim_Node* node, const uint8_t* image, uint32_t len) {
+	if (memcmp(node->flash, image, len) != 0) return 0;
+	for (uint32_t i = len; i < Flash_slot_size; i++) {
+		if (node->flash[i] != 0xFF) return 0;
+	}
+	return 1;
+}
+
+
+static int FlashErasedFrom(const Sim_Node* node, uint32_t offset) {
+	for (uint32_t i = offset; i < Flash_slot_size; i++) {
+		if (node->flash[i] != 0xFF) return 0;
+	}
+	return 1;
+}
+
+
+static void ResetNodes(Sim_Port* port) {
+	pthread_mutex_lock(&port->lock);
+	for (int i = 0; i < port->node_cnt; i++) NodeReset(&port->nodes[i]);
+	pthread_mutex_unlock(&port->lock);
+}
+
+
+//A frame the flasher would not send: start sequence, gap, message, gap
+static void SendTestFrame(int fd, const uint8_t* msg, uint32_t msg_len) {
+	const uint8_t start_seq[2] = { Msg_start_byte, Msg_start_byte };
+	if ((write(fd, start_seq, 2) < 0) || (poll(NULL, 0, 20) < 0) || (write(fd, msg, msg_len) < 0)) return;
+	poll(NULL, 0, 20);
+}
+
+
+static uint32_t ReadTestBytes(int fd, uint8_t* rx_buf, uint32_t rx_len, int timeout_ms) {
+	uint32_t rx_cnt = 0;
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	while ((rx_cnt < rx_len) && (poll(&pfd, 1, timeout_ms) > 0)) {
+		ssize_t n = read(fd, &rx_buf[rx_cnt], rx_len - rx_cnt);
+		if (n <= 0) break;
+		rx_cnt += n;
+	}
+	return rx_cnt;
+}
+
+
+/*
+ * 1)-5) and 12) one device, 6)-11) several devices
+ *
+ * 6)Multi-port mode: two devices in one run
+ * 7)One node on the bus (1:0, 2:0, 3:1): only node 2 is written, the other two are bystanders
+ * 8)Group 0: nodes 1 and 2 are written from one stream and polled one by one, node 3 (group 1) is not
+ * 9)Broadcast: every node is written
+ * 10)Line error on node 2 of group 0: the poll must flag it, node 1 still gets the image
+ * 11)0xb6 to group 0: nobody writes and nobody replies, the nodes take the image off the line and answer the next frame
+ * 12)0xb8 just past the slot and at the top of the address space: both must be refused (0xFFFF), the range check may not wrap around
+ *
+ * */
+static int SelfTest(const char* flasher_path) {
+	char dir_name[] = "/tmp/bootdevsim.XXXXXX";
+	char link_name[3][64];
+	char image_name[64];
+	char wrong_image_name[64];
+	static uint8_t image[Test_image_len];
+	static uint8_t wrong_image[Test_image_len];
+	static Sim_Port ports[3];													//two single devices and a bus
+	Sim_Node* node = &ports[0].nodes[0];
+	Sim_Node* bus_nodes = ports[2].nodes;
+	int fail_cnt = 0;
+	int result;
+
+	if (access(flasher_path, X_OK) < 0) {
+		fprintf(stderr, "Can't run %s: %s\n", flasher_path, strerror(errno));
+		return 1;
+	}
+	if (mkdtemp(dir_name) == NULL) return 1;
+	snprintf(image_name, sizeof(image_name), "%s/app.bin", dir_name);
+	snprintf(wrong_image_name, sizeof(wrong_image_name), "%s/app_slot_a.bin", dir_name);
+	if ((WriteTestImage(image_name, image, Update_slot_addr) < 0) || (WriteTestImage(wrong_image_name, wrong_image, 0x08008000) < 0)) {
+		fprintf(stderr, "Can't write the test images: %s\n", strerror(errno));
+		return 1;
+	}
+	for (int i = 0; i < 3; i++) {
+		snprintf(link_name[i], sizeof(link_name[i]), "%s/ttySIM%d", dir_name, i);
+		if ((PortOpen(&ports[i], link_name[i], (i == 2) ? "1:0,2:0,3:1" : NULL) < 0) || (pthread_create(&ports[i].thread, NULL, PortThread, &ports[i]) != 0)) {
+			fprintf(stderr, "Can't set up the stand-in: %s\n", strerror(errno));
+			return 1;
+		}
+	}
+
+	//1)
+	result = RunFlasher(flasher_path, (const char*[]) { "-v", image_name, link_name[0], NULL });
+	fail_cnt += CheckCase("plain update", (result == 0) && FlashHolds(node, image, Test_image_len));
+
+	//2)
+	ResetNodes(&ports[0]);
+	node->line_error_after = 10;
+	result = RunFlasher(flasher_path, (const char*[]) { "-v", image_name, link_name[0], NULL });
+	fail_cnt += CheckCase("line error flagged", (result == 1) && (node->report_pages == 10) && (node->report_errors[0] == 1)
+			&& (memcmp(node->flash, image, 10 * Flash_page_size) == 0) && FlashErasedFrom(node, 10 * Flash_page_size));
+
+	//3)
+	ResetNodes(&ports[0]);
+	node->line_error_after = 10;
+	int first_result = RunFlasher(flasher_path, (const char*[]) { "-r", image_name, link_name[0], NULL });
+	uint32_t cut_offset = node->next_offset;
+	node->line_error_after = -1;
+	result = RunFlasher(flasher_path, (const char*[]) { "-r", "-v", image_name, link_name[0], NULL });
+	fail_cnt += CheckCase("resumable update", (first_result == 1) && (cut_offset == 10 * Flash_page_size) && (result == 0)
+			&& (node->report_pages == Test_image_pages - 10) && FlashHolds(node, image, Test_image_len));
+
+	//4)
+	ResetNodes(&ports[0]);
+	node->corrupt_page = 7;
+	result = RunFlasher(flasher_path, (const char*[]) { "-v", image_name, link_name[0], NULL });
+	fail_cnt += CheckCase("verify catches page", (result == 1) && (node->report_pages == Test_image_pages));
+
+	//5)
+	ResetNodes(&ports[0]);
+	result = RunFlasher(flasher_path, (const char*[]) { wrong_image_name, link_name[0], NULL });
+	fail_cnt += CheckCase("link address check", (result == 1) && FlashErasedFrom(node, 0));
+
+	//6)
+	ResetNodes(&ports[0]);
+	ResetNodes(&ports[1]);
+	result = RunFlasher(flasher_path, (const char*[]) { "-v", image_name, link_name[0], link_name[1], NULL });
+	fail_cnt += CheckCase("multi-port", (result == 0) && FlashHolds(node, image, Test_image_len) && FlashHolds(&ports[1].nodes[0], image, Test_image_len));
+
+	//7)
+	ResetNodes(&ports[2]);
+	result = RunFlasher(flasher_path, (const char*[]) { "-a", "2", "-v", image_name, link_name[2], NULL });
+	fail_cnt += CheckCase("single node on a bus", (result == 0) && FlashHolds(&bus_nodes[1], image, Test_image_len)
+			&& FlashErasedFrom(&bus_nodes[0], 0) && FlashErasedFrom(&bus_nodes[2], 0));
+
+	//8)
+	ResetNodes(&ports[2]);
+	result = RunFlasher(flasher_path, (const char*[]) { "-a", "0xE0", "-n", "1,2", "-v", image_name, link_name[2], NULL });
+	fail_cnt += CheckCase("group update", (result == 0) && FlashHolds(&bus_nodes[0], image, Test_image_len)
+			&& FlashHolds(&bus_nodes[1], image, Test_image_len) && FlashErasedFrom(&bus_nodes[2], 0));
+
+	//9)
+	ResetNodes(&ports[2]);
+	result = RunFlasher(flasher_path, (const char*[]) { "-a", "0xFF", "-n", "1,2,3", "-v", image_name, link_name[2], NULL });
+	fail_cnt += CheckCase("broadcast update", (result == 0) && FlashHolds(&bus_nodes[0], image, Test_image_len)
+			&& FlashHolds(&bus_nodes[1], image, Test_image_len) && FlashHolds(&bus_nodes[2], image, Test_image_len));
+
+	//10)
+	ResetNodes(&ports[2]);
+	bus_nodes[1].line_error_after = 10;
+	result = RunFlasher(flasher_path, (const char*[]) { "-a", "0xE0", "-n", "1,2", image_name, link_name[2], NULL });
+	fail_cnt += CheckCase("line error in a group", (result == 1) && FlashHolds(&bus_nodes[0], image, Test_image_len)
+			&& (bus_nodes[1].report_pages == 10) && FlashErasedFrom(&bus_nodes[1], 10 * Flash_page_size));
+
+	//11)
+	ResetNodes(&ports[2]);
+	int test_fd = open(link_name[2], O_RDWR | O_NOCTTY);
+	const uint8_t group_resume[11] = { Cmd_addressed_frame, Target_group_base, 0xb6, 0x78, 0x56, 0x34, 0x12, 0x80, 0x01, 0x00, 0x00 };
+	const uint8_t node_status[3] = { Cmd_addressed_frame, 1, 0xb5 };
+	const uint8_t filler_byte = 0xFF;
+	uint8_t rx_buf[16];
+	uint32_t stray_cnt = 0;
+	uint32_t status_cnt = 0;
+	if (test_fd >= 0) {
+		struct termios tty;
+		tcgetattr(test_fd, &tty);
+		cfmakeraw(&tty);
+		tcsetattr(test_fd, TCSANOW, &tty);
+		SendTestFrame(test_fd, group_resume, sizeof(group_resume));
+		if ((write(test_fd, image, 3 * Flash_page_size) < 0) || (poll(NULL, 0, 20) < 0) || (write(test_fd, &filler_byte, 1) < 0)) {
+			//do nothing - the checks below fail
+		}
+		stray_cnt = ReadTestBytes(test_fd, rx_buf, sizeof(rx_buf), 100);		//nobody may reply to a group
+		SendTestFrame(test_fd, node_status, sizeof(node_status));
+		status_cnt = ReadTestBytes(test_fd, rx_buf, 11, 500);
+		close(test_fd);
+	}
+	fail_cnt += CheckCase("group 0xb6 bystanders", (test_fd >= 0) && (stray_cnt == 0) && (status_cnt == 11) && (rx_buf[2] == 0xb5)
+			&& FlashErasedFrom(&bus_nodes[0], 0) && FlashErasedFrom(&bus_nodes[1], 0) && (bus_nodes[0].next_offset == 0) && (bus_nodes[0].image_id == 0));
+
+	//12)
+	ResetNodes(&ports[0]);
+	const uint32_t bad_verify_addr[2] = { Update_slot_addr + Flash_slot_size, 0xFFFFFF80 };	//end of the slot, last page of the address space
+	uint32_t refused_cnt = 0;
+	test_fd = open(link_name[0], O_RDWR | O_NOCTTY);
+	if (test_fd >= 0) {
+		struct termios tty;
+		tcgetattr(test_fd, &tty);
+		cfmakeraw(&tty);
+		tcsetattr(test_fd, TCSANOW, &tty);
+		for (int i = 0; i < 2; i++) {
+			uint8_t verify_cmd[10] = { 0xb8, 0, 0, 0, 0, 1 };					//one page, the CRC does not matter
+			PutLE32(&verify_cmd[1], bad_verify_addr[i]);
+			SendTestFrame(test_fd, verify_cmd, sizeof(verify_cmd));
+			if ((ReadTestBytes(test_fd, rx_buf, 5, 500) == 5) && (rx_buf[2] == 0xb8) && (rx_buf[3] == 0xFF) && (rx_buf[4] == 0xFF)) refused_cnt++;
+		}
+		close(test_fd);
+	}
+	fail_cnt += CheckCase("verify range refused", (test_fd >= 0) && (refused_cnt == 2));
+
+	for (int i = 0; i < 3; i++) {
+		ports[i].stop = 1;
+		pthread_join(ports[i].thread, NULL);
+		PortClose(&ports[i]);
+	}
+	unlink(image_name);
+	unlink(wrong_image_name);
+	rmdir(dir_name);
+	return fail_cnt;
+}
+
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+			"Usage: bootdevsim [options] /tmp/ttySIM0 [/tmp/ttySIM1 ...]   bootloader stand-in on a pty per name\n"
+			"       bootdevsim [-v] -T ./bootflasher      runs the flasher against the stand-in\n"
+			"  -e pages      line error after this many pages of every update (the rest is dropped)\n"
+			"  -x page       write this page of the slot wrong (the verify must catch it)\n"
+			"  -N 1:0,2:0    nodes on a bus, address:group each (default: one node 0, plain frames)\n"
+			"  -v            show the output of the flasher in the self-test\n");
+}
+
+
+static volatile sig_atomic_t Stop_requested = 0;
+
+static void StopHandler(int signal_number) {
+	(void) signal_number;
+	Stop_requested = 1;
+}
+
+
+int main(int argc, char** argv) {
+	static Sim_Port ports[Sim_max_ports];
+	const char* flasher_path = NULL;
+	const char* node_list = NULL;
+	int line_error_after = -1;
+	int corrupt_page = -1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "e:x:N:vT:")) != -1) {
+		switch (opt) {
+		case 'e': line_error_after = strtol(optarg, NULL, 0); break;
+		case 'x': corrupt_page = strtol(optarg, NULL, 0); break;
+		case 'N': node_list = optarg; break;
+		case 'v': Show_flasher_output = 1; break;
+		case 'T': flasher_path = optarg; break;
+		default: PrintUsage(); return 2;
+		}
+	}
+	if (flasher_path != NULL) return (SelfTest(flasher_path) == 0) ? 0 : 1;
+	int port_cnt = argc - optind;
+	if ((port_cnt < 1) || (port_cnt > Sim_max_ports)) {
+		PrintUsage();
+		return 2;
+	}
+
+	for (int i = 0; i < port_cnt; i++) {
+		if (PortOpen(&ports[i], argv[optind + i], node_list) < 0) {
+			fprintf(stderr, "Can't open the pty on %s: %s\n", argv[optind + i], strerror(errno));
+			return 1;
+		}
+		for (int node = 0; node < ports[i].node_cnt; node++) {
+			ports[i].nodes[node].line_error_after = line_error_after;
+			ports[i].nodes[node].corrupt_page = corrupt_page;
+		}
+	}
+	signal(SIGINT, StopHandler);
+	signal(SIGTERM, StopHandler);
+	for (int i = 0; i < port_cnt; i++) pthread_create(&ports[i].thread, NULL, PortThread, &ports[i]);
+	while (!Stop_requested) pause();
+	for (int i = 0; i < port_cnt; i++) {
+		ports[i].stop = 1;
+		pthread_join(ports[i].thread, NULL);
+		PortClose(&ports[i]);
+	}
+	return 0;
+}
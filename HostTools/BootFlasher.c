@@ -0,0 +1,924 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.13
+ *  File: BootFlasher.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Host side flasher for the bootloader on UART1.
+ *
+ * v.1.0
+ * Runs the command sequence of the bootloader (0xc3 activation, 0xb5 slot check, 0xbb or 0xb6 update) and streams the image page by page.
+ * Every message is sent as "0xF0 0xF0", a gap, then the command and its payload, then another gap: the bootloader ends a message on its second idle frame.
+ * The image stream is closed by a gap, one filler byte and another gap. The bootloader replies with the number of pages it got (0xbf), which we check against what we sent.
+ * Reports the achieved bytes/s. Optionally verifies the FLASH afterwards with per page CRCs (0xb8).
+ *
+ * v.1.1
+ * Multi-port mode for production: several ports on the command line are flashed in parallel, one thread per port.
+ * The image and its page CRCs are prepared once and shared (read-only) by all threads. Progress is shown per port, pass/fail is listed at the end.
+ *
+ * v.1.2
+ * Addressed frames (-a) for nodes on a shared RS-485 bus. A group or broadcast target programs every matching node with one image stream.
+ * The nodes listed with -n are checked before (0xb5) and polled one by one after the stream (0xbf, then 0xb8 with -v).
+ *
+ * v.1.3
+ * Link speed-up (-B): after the activation, the bootloader is asked to change its baud rate (0xbd) and we follow once it has acknowledged.
+ * The slot status request that comes next is the first frame on the new rate - it confirms the rate on the bootloader side.
+ *
+ * v.1.4
+ * RTS/CTS flow control on the port (-c) for bootloaders built with uart1_flow_control. The image is then streamed without page gaps.
+ *
+ * v.1.5
+ * The session report (0xbf) carries the line errors the bootloader saw (overrun, framing, noise, parity). They are printed with the result.
+ * After a line error, the bootloader drops the rest of the image and reports fewer pages: a resumable update (-r) picks up from there on the next run.
+ *
+ * v.1.6
+ * Session statistics (-S): after the update, the statistics of the session are polled (0xb9) and printed as one CSV line on stdout, one per device.
+ *
+ * v.1.7
+ * Activation command (-A) for bootloaders with another one in their boot config. The boot config itself is set with BootConfigTool.c.
+ *
+ * v.1.8
+ * Image tag (-t) for bootloaders built with image_signed: the tag made by BootSign.c is sent after the session report and the verify (0xbe).
+ * The bootloader only switches to the new slot if the tag matches. A tag that doesn't match erases the slot - the update has to be run again.
+ *
+ * v.1.9
+ * Encrypted images from BootCrypt.c (image_encrypted) are recognised by their header. The nonce in the header is sent with 0xb3 right before the update starts, the rest is streamed as usual.
+ * The link address, the resume CRC and the verify (-v) all need the plain image, so they are skipped (or refused) for encrypted images. Use a tag (-t) instead.
+ *
+ * v.1.10
+ * Big-endian images (-R): the bootloader is asked to byte swap every word of the image (0xb1) before the update. The image is sent as it is.
+ * The link address, the page CRCs and the resume CRC are taken from the swapped image - that is what ends up in the FLASH.
+ *
+ * v.1.11
+ * IRQ latency (-L) for bootloaders built with irq_latency_probe: polled after the update (0xb0) and printed as one CSV line on stdout, like the statistics.
+ *
+ * v.1.12
+ * PrintResult only takes the session - the options were never used there.
+ * BootDevSim.c runs this flasher against a bootloader stand-in on a pty (bootdevsim -T ./bootflasher).
+ *
+ * v.1.13
+ * The stream is closed with the second gap after the filler byte, as it should be. Without it, the first node poll (0xbf) after a group or broadcast update came right after the filler.
+ * The nodes were still in programmer mode and took the poll as part of the image - the first node always failed.
+ *
+ * Build: gcc -O2 -Wall -pthread -o bootflasher BootFlasher.c
+ * Usage: bootflasher [options] image.bin /dev/ttyUSB0 [/dev/ttyUSB1 ...]
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+//LOCAL CONSTANT
+#define Flash_page_size			128												//one page of FLASH - the bootloader writes the image in these steps
+#define Flash_slot_size			0x4000											//one app slot
+#define Flash_verify_max_pages	62												//page CRCs that fit into one 0xb8 command
+#define Msg_start_byte			0xF0
+#define Reply_timeout_ms		2000
+#define Cmd_addressed_frame		0xAD											//0xF0 0xF0 0xAD target command payload
+#define Target_group_base		0xE0											//targets from here on are groups, 0xFF is every node
+#define Max_nodes				0xE0
+#define Session_stats_size		36												//struct_Session_Stats of the bootloader
+#define IRQ_latency_size		36												//struct_IRQ_Latency of the bootloader
+#define IRQ_latency_buckets		14
+#define Image_tag_size			32												//HMAC-SHA256 of the image
+#define Crypt_header_magic		"BENC"											//encrypted image: the magic and the nonce, then the image
+#define Crypt_nonce_size		12
+
+//one image, read and padded once. Read-only after loading.
+typedef struct {
+	uint8_t* data;
+	uint8_t* flash_data;														//the image as it lands in the FLASH - data with its words byte swapped for -R
+	uint32_t len;																//padded to a full page with 0xFF
+	uint32_t image_id;															//CRC of the full image - used as ID for resumable updates
+	uint32_t* page_crc;															//CRC of every page on its own - for 0xb8
+	int encrypted;																//data is the encrypted image, the CRCs are of the encrypted image as well
+	uint8_t nonce[Crypt_nonce_size];											//sent with 0xb3
+} Flash_Image;
+
+typedef struct {
+	long baud;
+	long link_baud;																//baud rate we ask for with 0xbd - 0 keeps the starting rate
+	unsigned page_gap_us;														//gap after every page - 0 streams the image in one go
+	unsigned msg_gap_ms;														//gap that closes a message on the bootloader side
+	unsigned prog_entry_ms;														//time the bootloader needs to switch to programmer mode after 0xbb
+	int skip_activation;
+	int resumable;
+	int verify;
+	int force;
+	int flow_control;															//RTS/CTS - the bootloader holds us while the FLASH is busy
+	int target;																	//-1: plain frames, otherwise the target byte of addressed frames
+	uint8_t poll_nodes[Max_nodes];												//nodes to check before and after a group or broadcast update
+	int poll_node_cnt;
+	int stats;																	//poll the session statistics (0xb9) after the update
+	int byte_swap;																//big-endian image: the bootloader swaps the words (0xb1)
+	int irq_latency;															//poll the IRQ latency (0xb0) after the update
+	uint8_t activation_cmd;														//0xc3 unless the boot config says otherwise
+	const uint8_t* image_tag;													//sent with 0xbe after the update - NULL for bootloaders without image_signed
+} Flash_Options;
+
+//one device - one thread in multi-port mode
+typedef struct {
+	const char* port_name;
+	int target;																	//target of the frames we send right now
+	const Flash_Options* options;
+	const Flash_Image* image;
+	pthread_t thread;
+	int result;
+	volatile int done;
+	volatile uint32_t pages_total;												//read by the progress display while the thread runs
+	int fd;
+	long baud;																	//baud rate the port runs on right now
+	uint32_t update_slot_addr;
+	uint32_t start_offset;
+	volatile uint32_t pages_sent;
+	uint32_t pages_reported;
+	uint16_t line_errors[4];													//overrun, framing, noise, parity - from the session report
+	int report_received;
+	uint8_t stats[Session_stats_size];
+	int stats_received;
+	uint8_t irq_latency[IRQ_latency_size];
+	int irq_latency_received;
+	double stream_seconds;
+	const char* fail_reason;
+} Flash_Session;
+
+
+//1)Time in seconds
+static double NowSeconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+
+static void SleepMs(unsigned ms) {
+	struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+}
+
+
+//2)CRC - same as the CRC unit of the STM32 in its reset configuration (CRC-32/MPEG-2, fed with 32-bit little endian words)
+static uint32_t CrcWords(uint32_t crc, const uint8_t* data, uint32_t len) {
+	for (uint32_t i = 0; i + 3 < len; i += 4) {
+		crc ^= (uint32_t) data[i] | ((uint32_t) data[i + 1] << 8) | ((uint32_t) data[i + 2] << 16) | ((uint32_t) data[i + 3] << 24);
+		for (int b = 0; b < 32; b++) {
+			crc = (crc & 0x80000000) ? ((crc << 1) ^ 0x04C11DB7) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+
+static void PutLE32(uint8_t* dst, uint32_t value) {
+	dst[0] = value; dst[1] = value >> 8; dst[2] = value >> 16; dst[3] = value >> 24;
+}
+
+
+static uint16_t GetLE16(const uint8_t* src) {
+	return src[0] | (src[1] << 8);
+}
+
+
+static uint32_t GetLE32(const uint8_t* src) {
+	return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+
+//3)Load the image and pad it to full pages
+static int LoadImage(const char* file_name, Flash_Image* image, int byte_swap) {
+	uint8_t header[4 + Crypt_nonce_size];
+	FILE* f = fopen(file_name, "rb");
+	if (f == NULL) return -1;
+	fseek(f, 0, SEEK_END);
+	long file_len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	image->encrypted = 0;
+	if ((file_len > (long) sizeof(header)) && (fread(header, 1, sizeof(header), f) == sizeof(header)) && (memcmp(header, Crypt_header_magic, 4) == 0)) {
+		image->encrypted = 1;													//BootCrypt.c output: the header is not part of the image
+		memcpy(image->nonce, &header[4], Crypt_nonce_size);
+		file_len -= sizeof(header);
+	} else {
+		fseek(f, 0, SEEK_SET);
+	}
+	if ((file_len <= 0) || (file_len > Flash_slot_size)) {
+		fclose(f);
+		errno = EFBIG;
+		return -1;
+	}
+
+	image->len = (file_len + Flash_page_size - 1) / Flash_page_size * Flash_page_size;
+	image->data = malloc(image->len);
+	memset(image->data, 0xFF, image->len);										//erased FLASH value
+	if (fread(image->data, 1, file_len, f) != (size_t) file_len) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	image->image_id = CrcWords(0xFFFFFFFF, image->data, image->len);
+	image->flash_data = image->data;
+	if (byte_swap) {
+		image->flash_data = malloc(image->len);
+		for (uint32_t i = 0; i < image->len; i += 4) {
+			PutLE32(&image->flash_data[i], __builtin_bswap32(GetLE32(&image->data[i])));	//what REV does on the bootloader side
+		}
+	}
+	image->page_crc = malloc((image->len / Flash_page_size) * sizeof(uint32_t));
+	for (uint32_t page = 0; page < (image->len / Flash_page_size); page++) {
+		image->page_crc[page] = CrcWords(0xFFFFFFFF, &image->flash_data[page * Flash_page_size], Flash_page_size);
+	}
+	return 0;
+}
+
+
+//4)Serial port
+static speed_t BaudToSpeed(long baud) {
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	default: return 0;
+	}
+}
+
+
+static int OpenSerialPort(const char* port_name, long baud, int flow_control) {
+	int port_fd = open(port_name, O_RDWR | O_NOCTTY);
+	if (port_fd < 0) return -1;
+
+	struct termios tty;
+	if (tcgetattr(port_fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, BaudToSpeed(baud));
+		cfsetospeed(&tty, BaudToSpeed(baud));
+		tty.c_cflag |= CLOCAL | CREAD;
+		tty.c_cflag &= ~CRTSCTS;
+		if (flow_control) tty.c_cflag |= CRTSCTS;
+		tty.c_cc[VMIN] = 0;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(port_fd, TCSANOW, &tty);
+		tcflush(port_fd, TCIOFLUSH);
+	}
+	return port_fd;
+}
+
+
+static int SetPortSpeed(int port_fd, long baud) {
+	struct termios tty;
+	if (tcgetattr(port_fd, &tty) != 0) return -1;
+	cfsetispeed(&tty, BaudToSpeed(baud));
+	cfsetospeed(&tty, BaudToSpeed(baud));
+	return tcsetattr(port_fd, TCSANOW, &tty);
+}
+
+
+static int WriteAll(int fd, const uint8_t* data, uint32_t len) {
+	while (len > 0) {
+		ssize_t written = write(fd, data, len);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		data += written;
+		len -= written;
+	}
+	return 0;
+}
+
+
+//5)Send a command
+/*
+ * 1)Start sequence, then a gap - the first idle frame
+ * 2)Command and payload, then a gap - the second idle frame ends the message
+ *
+ * */
+static int SendCommand(Flash_Session* session, const Flash_Options* options, uint8_t cmd, const uint8_t* payload, uint32_t payload_len) {
+	uint8_t msg_buf[256];
+	uint32_t msg_len = 0;
+	const uint8_t start_seq[2] = { Msg_start_byte, Msg_start_byte };
+
+	if (payload_len > sizeof(msg_buf) - 3) return -1;
+	if (session->target >= 0) {
+		msg_buf[msg_len++] = Cmd_addressed_frame;
+		msg_buf[msg_len++] = session->target;
+	}
+	msg_buf[msg_len++] = cmd;
+	if (payload_len) memcpy(&msg_buf[msg_len], payload, payload_len);
+	msg_len += payload_len;
+
+	//1)
+	if (WriteAll(session->fd, start_seq, 2) < 0) return -1;
+	tcdrain(session->fd);
+	SleepMs(options->msg_gap_ms);
+
+	//2)
+	if (WriteAll(session->fd, msg_buf, msg_len) < 0) return -1;
+	tcdrain(session->fd);
+	SleepMs(options->msg_gap_ms);
+	return 0;
+}
+
+
+//6)Wait for bytes or a reply
+static int ReadBytes(Flash_Session* session, uint8_t* rx_buf, uint32_t rx_len, unsigned timeout_ms) {
+	double deadline = NowSeconds() + (timeout_ms / 1000.0);
+	uint32_t rx_cnt = 0;
+
+	while ((rx_cnt < rx_len) && (NowSeconds() < deadline)) {
+		struct pollfd pfd = { session->fd, POLLIN, 0 };
+		int wait_ms = (int) ((deadline - NowSeconds()) * 1000) + 1;
+		if (poll(&pfd, 1, wait_ms) <= 0) continue;
+		ssize_t n = read(session->fd, &rx_buf[rx_cnt], rx_len - rx_cnt);
+		if (n > 0) rx_cnt += n;
+	}
+	return (rx_cnt == rx_len) ? 0 : -1;
+}
+
+
+/*
+ * Replies are 0xF0 0xF0, the command, then a fixed size payload. Anything before the header is skipped.
+ *
+ * */
+static int ReadReply(Flash_Session* session, uint8_t cmd, uint8_t* payload, uint32_t payload_len, unsigned timeout_ms) {
+	double deadline = NowSeconds() + (timeout_ms / 1000.0);
+	uint8_t header[3] = {0};
+
+	while (NowSeconds() < deadline) {
+		uint8_t rx_byte;
+		if (ReadBytes(session, &rx_byte, 1, (unsigned) ((deadline - NowSeconds()) * 1000) + 1) < 0) break;
+		header[0] = header[1];
+		header[1] = header[2];
+		header[2] = rx_byte;
+		if ((header[0] == Msg_start_byte) && (header[1] == Msg_start_byte) && (header[2] == cmd)) {
+			return ReadBytes(session, payload, payload_len, Reply_timeout_ms);
+		}
+	}
+	return -1;
+}
+
+
+//7)Stream the image
+/*
+ * 1)Send the pages from the start offset, with the page gap if there is one
+ * 2)Close the stream: gap, filler byte, gap
+ *
+ * Note: without a page gap, the whole image goes to the kernel in one write, the bootloader ping-pong buffer takes care of the rest.
+ *
+ * */
+static int StreamImage(Flash_Session* session, const Flash_Options* options, const Flash_Image* image, int show_progress) {
+	uint32_t page_cnt = (image->len - session->start_offset) / Flash_page_size;
+	double stream_start = NowSeconds();
+	session->pages_total = page_cnt;
+
+	//1)
+	for (uint32_t page = 0; page < page_cnt; page++) {
+		if (WriteAll(session->fd, &image->data[session->start_offset + (page * Flash_page_size)], Flash_page_size) < 0) {
+			session->fail_reason = "write failed";
+			return -1;
+		}
+		if (options->page_gap_us != 0) {
+			tcdrain(session->fd);
+			usleep(options->page_gap_us);
+		}
+		session->pages_sent = page + 1;
+		if (show_progress) {
+			fprintf(stderr, "\r%s: page %u/%u (%u%%)", session->port_name, page + 1, page_cnt, (page + 1) * 100 / page_cnt);
+		}
+	}
+	tcdrain(session->fd);
+	session->stream_seconds = NowSeconds() - stream_start;
+	if (show_progress) fputc('\n', stderr);
+
+	//2)
+	const uint8_t filler_byte = 0xFF;
+	SleepMs(options->msg_gap_ms);
+	WriteAll(session->fd, &filler_byte, 1);
+	tcdrain(session->fd);
+	SleepMs(options->msg_gap_ms);												//the session only ends on this idle frame - a group poll sent right away would be taken as image
+	return 0;
+}
+
+
+//Session report: the bootloader tells us how many pages it got and how many line errors it saw
+static int CheckSessionReport(Flash_Session* session) {
+	uint8_t report[10];
+	if (ReadReply(session, 0xbf, report, 10, Reply_timeout_ms) < 0) {
+		session->fail_reason = "no session report";
+		return -1;
+	}
+	session->pages_reported = report[0] | (report[1] << 8);
+	for (int i = 0; i < 4; i++) {
+		session->line_errors[i] = report[2 + (2 * i)] | (report[3 + (2 * i)] << 8);
+	}
+	session->report_received = 1;
+	if (session->pages_reported != session->pages_sent) {
+		session->fail_reason = (session->line_errors[0] | session->line_errors[1] | session->line_errors[3]) ? "line errors - image dropped from the first error on"
+				: "page count mismatch";
+		return -1;
+	}
+	return 0;
+}
+
+
+//8)Verify the image with per page CRCs
+static int VerifyImage(Flash_Session* session, const Flash_Options* options, const Flash_Image* image) {
+	uint32_t page_cnt = image->len / Flash_page_size;
+	int bad_page_total = 0;
+
+	for (uint32_t first_page = 0; first_page < page_cnt; first_page += Flash_verify_max_pages) {
+		uint8_t chunk_pages = ((page_cnt - first_page) > Flash_verify_max_pages) ? Flash_verify_max_pages : (page_cnt - first_page);
+		uint8_t payload[5 + (4 * Flash_verify_max_pages)];
+		uint8_t reply[2 + (2 * Flash_verify_max_pages)];
+
+		PutLE32(&payload[0], session->update_slot_addr + (first_page * Flash_page_size));
+		payload[4] = chunk_pages;
+		for (uint8_t i = 0; i < chunk_pages; i++) {
+			PutLE32(&payload[5 + (4 * i)], image->page_crc[first_page + i]);
+		}
+
+		if ((SendCommand(session, options, 0xb8, payload, 5 + (4 * chunk_pages)) < 0) || (ReadReply(session, 0xb8, reply, 2, Reply_timeout_ms) < 0)) {
+			session->fail_reason = "no verify reply";
+			return -1;
+		}
+		uint16_t bad_page_cnt = reply[0] | (reply[1] << 8);
+		if (bad_page_cnt == 0xFFFF) {
+			session->fail_reason = "verify request rejected";
+			return -1;
+		}
+		if (bad_page_cnt > chunk_pages) {
+			session->fail_reason = "verify reply not valid";
+			return -1;
+		}
+		if (bad_page_cnt != 0) {
+			uint8_t bad_pages[2 * Flash_verify_max_pages];
+			if (ReadBytes(session, bad_pages, 2 * bad_page_cnt, Reply_timeout_ms) < 0) {
+				session->fail_reason = "verify reply cut";
+				return -1;
+			}
+			for (uint16_t i = 0; i < bad_page_cnt; i++) {
+				fprintf(stderr, "%s: FLASH page %u does not match\n", session->port_name, bad_pages[2 * i] | (bad_pages[(2 * i) + 1] << 8));
+			}
+			bad_page_total += bad_page_cnt;
+		}
+	}
+
+	if (bad_page_total != 0) {
+		session->fail_reason = "verify failed";
+		return -1;
+	}
+	return 0;
+}
+
+
+//Image tag
+/*
+ * The reply is a single byte: 1 if the tag matched and the slot has been switched.
+ * A group or broadcast update sends the tag to the nodes one by one - every node checks its own copy of the image.
+ *
+ * */
+static int SendImageTag(Flash_Session* session, const Flash_Options* options) {
+	int node_cnt = (options->target >= Target_group_base) ? options->poll_node_cnt : 1;
+	int fail_cnt = 0;
+	uint8_t tag_result;
+
+	for (int node = 0; node < node_cnt; node++) {
+		char node_name[16] = "";
+		if (options->target >= Target_group_base) {
+			session->target = options->poll_nodes[node];
+			snprintf(node_name, sizeof(node_name), " on node %d", session->target);
+		}
+		if ((SendCommand(session, options, 0xbe, options->image_tag, Image_tag_size) < 0) || (ReadReply(session, 0xbe, &tag_result, 1, Reply_timeout_ms) < 0)) {
+			fprintf(stderr, "%s: no reply to the image tag%s\n", session->port_name, node_name);
+			fail_cnt++;
+		} else if (tag_result != 1) {
+			fprintf(stderr, "%s: image tag rejected%s - the update slot has been erased\n", session->port_name, node_name);
+			fail_cnt++;
+		}
+	}
+
+	session->target = options->target;
+	if (fail_cnt != 0) {
+		session->fail_reason = "image tag rejected";
+		return -1;
+	}
+	return 0;
+}
+
+
+//Poll the nodes after a group or broadcast update
+static int PollNodes(Flash_Session* session, const Flash_Options* options, const Flash_Image* image) {
+	int fail_cnt = 0;
+
+	for (int node = 0; node < options->poll_node_cnt; node++) {
+		session->target = options->poll_nodes[node];
+		session->fail_reason = NULL;
+		session->report_received = 0;
+		if ((SendCommand(session, options, 0xbf, NULL, 0) < 0) || (CheckSessionReport(session) < 0)
+				|| (options->verify && (VerifyImage(session, options, image) < 0))) {
+			fprintf(stderr, "%s: node %d FAIL (%s)\n", session->port_name, session->target, session->fail_reason ? session->fail_reason : strerror(errno));
+			if (session->report_received && (session->pages_reported != session->pages_sent)) {
+				fprintf(stderr, "%s: node %d reported %u pages, sent %u\n", session->port_name, session->target, session->pages_reported, session->pages_sent);
+			}
+			fail_cnt++;
+		} else {
+			fprintf(stderr, "%s: node %d PASS\n", session->port_name, session->target);
+		}
+	}
+
+	session->target = options->target;
+	session->report_received = 0;
+	if (fail_cnt != 0) {
+		session->fail_reason = "some of the nodes failed";
+		return -1;
+	}
+	session->fail_reason = NULL;
+	return 0;
+}
+
+
+//Baud rate change
+/*
+ * The bootloader acknowledges on the old rate, then switches. We follow as soon as we have the reply.
+ * The next frame we send must come within the probation time of the bootloader (2 seconds), otherwise it goes back to the old rate.
+ *
+ * Note: a group or broadcast target gets no reply, so we just give the nodes the message gap to switch.
+ *
+ * */
+static int SwitchBaud(Flash_Session* session, const Flash_Options* options) {
+	uint8_t payload[4];
+	uint8_t reply[4];
+
+	PutLE32(payload, options->link_baud);
+	if (SendCommand(session, options, 0xbd, payload, 4) < 0) {
+		session->fail_reason = strerror(errno);
+		return -1;
+	}
+	if (options->target < Target_group_base) {
+		if (ReadReply(session, 0xbd, reply, 4, Reply_timeout_ms) < 0) {
+			session->fail_reason = "no reply to baud rate change";
+			return -1;
+		}
+		if (GetLE32(reply) != (uint32_t) options->link_baud) {
+			session->fail_reason = "baud rate rejected by the bootloader";
+			return -1;
+		}
+	} else {
+		SleepMs(options->msg_gap_ms);
+	}
+	if (SetPortSpeed(session->fd, options->link_baud) < 0) {
+		session->fail_reason = "can't set the new baud rate on the port";
+		return -1;
+	}
+	session->baud = options->link_baud;
+	SleepMs(options->msg_gap_ms);
+	return 0;
+}
+
+
+//9)One device, start to end
+/*
+ * 1)Activate the external controller (0xc3 or -A), then change the baud rate if asked (0xbd)
+ * 2)Ask for the slot status (0xb5) - this also tells us that the link works. The image must be linked for the update slot.
+ * 3)Start the update: 0xbb, or 0xb6 with the image ID if it is resumable. An encrypted image sends its nonce first (0xb3), a big-endian one the byte swap (0xb1).
+ * 4)Stream the image
+ * 5)Check the session report and verify, if asked. After a group or broadcast update, we do this node by node.
+ * 6)Send the image tag (image_signed) - the slot is switched only after this
+ *
+ * Note: a group or broadcast target gets no replies. The nodes given with -n are asked one by one.
+ * Note: the bootloader stays on the new baud rate until it reboots.
+ *
+ * */
+static int FlashDevice(Flash_Session* session, const Flash_Options* options, const Flash_Image* image, int show_progress) {
+	uint8_t reply[8];
+
+	session->target = options->target;
+	session->baud = options->baud;
+	session->fd = OpenSerialPort(session->port_name, options->baud, options->flow_control);
+	if (session->fd < 0) {
+		session->fail_reason = strerror(errno);
+		return -1;
+	}
+
+	//1)
+	if (!options->skip_activation) {
+		if (SendCommand(session, options, options->activation_cmd, NULL, 0) < 0) goto fail_io;
+	}
+	if ((options->link_baud != 0) && (options->link_baud != session->baud)) {
+		if (SwitchBaud(session, options) < 0) goto fail;
+	}
+
+	//2)
+	int node_cnt = (options->target >= Target_group_base) ? options->poll_node_cnt : 1;	//only single nodes reply - a group is checked node by node
+	for (int node = 0; node < node_cnt; node++) {
+		if (options->target >= Target_group_base) session->target = options->poll_nodes[node];
+		if ((SendCommand(session, options, 0xb5, NULL, 0) < 0) || (ReadReply(session, 0xb5, reply, 8, Reply_timeout_ms) < 0)) {
+			session->fail_reason = "no reply to slot status - is the bootloader in external controller mode?";
+			goto fail;
+		}
+		if ((node != 0) && (session->update_slot_addr != GetLE32(&reply[4]))) {
+			session->fail_reason = "the nodes don't update the same slot - flash them in groups by slot";
+			goto fail;
+		}
+		session->update_slot_addr = GetLE32(&reply[4]);
+	}
+	session->target = options->target;
+	uint32_t image_reset_vector = GetLE32(&image->flash_data[4]);
+	if (!image->encrypted && ((image_reset_vector < session->update_slot_addr) || (image_reset_vector >= session->update_slot_addr + Flash_slot_size)) && !options->force) {
+		session->fail_reason = "image is not linked for the update slot";
+		goto fail;
+	}
+
+	//3)
+	session->start_offset = 0;
+	if (image->encrypted && (SendCommand(session, options, 0xb3, image->nonce, Crypt_nonce_size) < 0)) goto fail_io;
+	if (options->byte_swap) {
+		uint8_t session_options = 0x01;											//byte swap
+		if (SendCommand(session, options, 0xb1, &session_options, 1) < 0) goto fail_io;
+	}
+	if (options->resumable && (options->target >= Target_group_base)) {
+		session->fail_reason = "resumable updates are node by node - no group or broadcast target";
+		goto fail;
+	} else if (options->resumable) {
+		uint8_t payload[8];
+		PutLE32(&payload[0], image->image_id);
+		PutLE32(&payload[4], image->len);
+		if ((SendCommand(session, options, 0xb6, payload, 8) < 0) || (ReadReply(session, 0xb6, reply, 8, Reply_timeout_ms) < 0)) {
+			session->fail_reason = "no reply to resumable update";
+			goto fail;
+		}
+		session->start_offset = GetLE32(&reply[0]);
+		if ((session->start_offset > image->len) || (session->start_offset % Flash_page_size)) {
+			session->fail_reason = "update rejected";
+			goto fail;
+		}
+		if (!image->encrypted && (GetLE32(&reply[4]) != CrcWords(0xFFFFFFFF, image->flash_data, session->start_offset))) {	//the bootloader has the CRC of the plain image
+			session->fail_reason = "resume CRC does not match the image";
+			goto fail;
+		}
+		if (show_progress && session->start_offset) fprintf(stderr, "%s: resuming at offset 0x%x\n", session->port_name, session->start_offset);
+	} else {
+		if (SendCommand(session, options, 0xbb, NULL, 0) < 0) goto fail_io;
+		SleepMs(options->prog_entry_ms);											//no reply to 0xbb - we give the bootloader time to set up the DMA
+	}
+
+	//4)
+	if (StreamImage(session, options, image, show_progress) < 0) goto fail;
+
+	//5)
+	if (options->target >= Target_group_base) {
+		if (PollNodes(session, options, image) < 0) goto fail;
+	} else {
+		if (CheckSessionReport(session) < 0) goto fail;
+		if (options->stats) {
+			if ((SendCommand(session, options, 0xb9, NULL, 0) < 0) || (ReadReply(session, 0xb9, session->stats, Session_stats_size, Reply_timeout_ms) < 0)) {
+				fprintf(stderr, "%s: no reply to the statistics request\n", session->port_name);	//not a failure - the image is in
+			} else {
+				session->stats_received = 1;
+			}
+		}
+		if (options->irq_latency) {
+			if ((SendCommand(session, options, 0xb0, NULL, 0) < 0) || (ReadReply(session, 0xb0, session->irq_latency, IRQ_latency_size, Reply_timeout_ms) < 0)) {
+				fprintf(stderr, "%s: no reply to the IRQ latency request - bootloader built without irq_latency_probe?\n", session->port_name);
+			} else {
+				session->irq_latency_received = 1;
+			}
+		}
+		if (options->verify && (VerifyImage(session, options, image) < 0)) goto fail;
+	}
+
+	//6)
+	if ((options->image_tag != NULL) && (SendImageTag(session, options) < 0)) goto fail;
+
+	close(session->fd);
+	return 0;
+
+fail_io:
+	session->fail_reason = strerror(errno);
+fail:
+	close(session->fd);
+	return -1;
+}
+
+
+//10)Multi-port mode
+/*
+ * Every port gets its own thread running FlashDevice. The threads share the image and the options, both read-only.
+ * The main thread only draws the progress of all ports until every thread is done.
+ *
+ * Note: the threads spend their time waiting on the serial ports, so the total time is roughly the time of the slowest device.
+ *
+ * */
+static void* FlashDeviceThread(void* arg) {
+	Flash_Session* session = arg;
+	session->result = FlashDevice(session, session->options, session->image, 0);
+	session->done = 1;
+	return NULL;
+}
+
+
+static void ShowProgress(const Flash_Session* sessions, int session_cnt) {
+	fputc('\r', stderr);
+	for (int i = 0; i < session_cnt; i++) {
+		uint32_t pages_total = sessions[i].pages_total;
+		if (sessions[i].done) {
+			fprintf(stderr, "[%s %s] ", sessions[i].port_name, (sessions[i].result < 0) ? "FAIL" : "done");
+		} else if (pages_total == 0) {
+			fprintf(stderr, "[%s ---] ", sessions[i].port_name);
+		} else {
+			fprintf(stderr, "[%s %3u%%] ", sessions[i].port_name, sessions[i].pages_sent * 100 / pages_total);
+		}
+	}
+}
+
+
+static void PrintResult(const Flash_Session* session) {
+	if (session->stream_seconds > 0) {
+		uint32_t stream_bytes = session->pages_sent * Flash_page_size;
+		fprintf(stderr, "%s: %u bytes in %.2f s, %.0f bytes/s (line limit %ld bytes/s)\n", session->port_name, stream_bytes,
+				session->stream_seconds, stream_bytes / session->stream_seconds, session->baud / 10);
+	}
+	if (session->report_received && (session->pages_sent != session->pages_reported)) {
+		fprintf(stderr, "%s: PAGE COUNT MISMATCH - sent %u, bootloader reported %u\n", session->port_name, session->pages_sent, session->pages_reported);
+	}
+	if (session->report_received && (session->line_errors[0] | session->line_errors[1] | session->line_errors[2] | session->line_errors[3])) {
+		fprintf(stderr, "%s: line errors at %ld baud - %u overrun, %u framing, %u noise, %u parity\n", session->port_name, session->baud,
+				session->line_errors[0], session->line_errors[1], session->line_errors[2], session->line_errors[3]);
+	}
+	if (session->stats_received) {
+		const uint8_t* stats = session->stats;
+		printf("STATS,%s,%ld,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", session->port_name, session->baud,
+				GetLE32(&stats[0]), GetLE32(&stats[4]) / 1000,									//bytes, session time in ms
+				GetLE16(&stats[16]), GetLE16(&stats[18]), GetLE16(&stats[20]),					//pages received, written, skipped
+				GetLE32(&stats[8]), GetLE16(&stats[22]), GetLE32(&stats[12]), GetLE16(&stats[24]),	//erase total and max, program total and max (us)
+				GetLE16(&stats[26]),															//smallest buffer slack in bytes
+				GetLE16(&stats[28]), GetLE16(&stats[30]), GetLE16(&stats[32]), GetLE16(&stats[34]));	//overrun, framing, noise, parity
+	}
+	if (session->irq_latency_received) {
+		const uint8_t* latency = session->irq_latency;
+		printf("LATENCY,%s,%s,%u,%u", session->port_name, latency[6] ? "ram" : "flash", GetLE32(&latency[0]), GetLE16(&latency[4]));	//build, samples, max us
+		for (int i = 0; i < IRQ_latency_buckets; i++) {
+			printf(",%u", GetLE16(&latency[8 + (2 * i)]));								//0 us, 1 us, 2-3 us, 4-7 us ... 4096 us and above
+		}
+		printf("\n");
+	}
+	if (session->result < 0) {
+		fprintf(stderr, "%s: FAIL (%s)\n", session->port_name, session->fail_reason);
+	} else {
+		fprintf(stderr, "%s: PASS\n", session->port_name);
+	}
+}
+
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+			"Usage: bootflasher [options] image.bin /dev/ttyUSB0 [/dev/ttyUSB1 ...]\n"
+			"  several ports are flashed in parallel\n"
+			"  image.bin may be the .enc file of bootcrypt (bootloader built with image_encrypted)\n"
+			"  -b baud       UART1 baud rate (default 57600)\n"
+			"  -B baud       switch the bootloader to this baud rate after the activation (up to 1000000)\n"
+			"  -g us         gap after every page in microseconds (default 0)\n"
+			"  -m ms         gap that closes a message (default 10)\n"
+			"  -w ms         wait after 0xbb before streaming (default 100)\n"
+			"  -r            resumable update (0xb6), continues an interrupted update of the same image\n"
+			"  -s            skip the activation (bootloader already in external controller mode)\n"
+			"  -A byte       activation command (default 0xc3)\n"
+			"  -t file.sig   send the image tag made by bootsign (bootloader built with image_signed)\n"
+			"  -R            big-endian image: the bootloader byte swaps every word (0xb1)\n"
+			"  -v            verify the FLASH with per page CRCs after the update\n"
+			"  -f            flash even if the image is not linked for the update slot\n"
+			"  -c            RTS/CTS flow control (bootloader built with uart1_flow_control)\n"
+			"  -a target     addressed frames: node 0x00-0xDF, group 0xE0 + group number, 0xFF all nodes\n"
+			"  -n 1,2,...    nodes to check before and after a group or broadcast update\n"
+			"  -S            poll the session statistics (0xb9) and print them on stdout:\n"
+			"                STATS,port,baud,bytes,ms,pages rx,written,skipped,erase us total,max,program us total,max,min slack,overrun,framing,noise,parity\n"
+			"  -L            poll the IRQ latency of the session (0xb0, bootloader built with irq_latency_probe) and print it on stdout:\n"
+			"                LATENCY,port,ram|flash,samples,max us,then the number of samples at 0 us, 1 us, 2-3 us, 4-7 us ... 4096 us and above\n");
+}
+
+
+int main(int argc, char** argv) {
+	Flash_Options options = { 57600, 0, 0, 10, 100, 0, 0, 0, 0, 0, -1, {0}, 0, 0, 0, 0, 0xc3, NULL };
+	Flash_Image image;
+	static uint8_t image_tag[Image_tag_size];
+	const char* tag_file_name = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:B:g:m:w:rsvfca:n:SA:t:RL")) != -1) {
+		switch (opt) {
+		case 'b': options.baud = strtol(optarg, NULL, 10); break;
+		case 'B': options.link_baud = strtol(optarg, NULL, 10); break;
+		case 'g': options.page_gap_us = strtoul(optarg, NULL, 10); break;
+		case 'm': options.msg_gap_ms = strtoul(optarg, NULL, 10); break;
+		case 'w': options.prog_entry_ms = strtoul(optarg, NULL, 10); break;
+		case 'r': options.resumable = 1; break;
+		case 's': options.skip_activation = 1; break;
+		case 'v': options.verify = 1; break;
+		case 'f': options.force = 1; break;
+		case 'c': options.flow_control = 1; break;
+		case 'S': options.stats = 1; break;
+		case 'R': options.byte_swap = 1; break;
+		case 'L': options.irq_latency = 1; break;
+		case 'A': options.activation_cmd = strtoul(optarg, NULL, 0); break;
+		case 't': tag_file_name = optarg; break;
+		case 'a': options.target = strtol(optarg, NULL, 0) & 0xFF; break;
+		case 'n':
+			for (char* node = strtok(optarg, ","); (node != NULL) && (options.poll_node_cnt < Max_nodes); node = strtok(NULL, ",")) {
+				options.poll_nodes[options.poll_node_cnt++] = strtol(node, NULL, 0);
+			}
+			break;
+		default: PrintUsage(); return 2;
+		}
+	}
+	if ((argc - optind) < 2) {
+		PrintUsage();
+		return 2;
+	}
+	if ((options.target >= Target_group_base) && (options.poll_node_cnt == 0)) {
+		fprintf(stderr, "A group or broadcast target needs the list of nodes to check (-n)\n");
+		return 2;
+	}
+	if ((BaudToSpeed(options.baud) == 0) || ((options.link_baud != 0) && (BaudToSpeed(options.link_baud) == 0))) {
+		fprintf(stderr, "Unsupported baud rate\n");
+		return 2;
+	}
+	if (tag_file_name != NULL) {
+		FILE* tag_file = fopen(tag_file_name, "rb");
+		size_t tag_len = (tag_file != NULL) ? fread(image_tag, 1, Image_tag_size, tag_file) : 0;
+		if (tag_file != NULL) fclose(tag_file);
+		if (tag_len != Image_tag_size) {
+			fprintf(stderr, "Can't load the %d byte image tag from %s\n", Image_tag_size, tag_file_name);
+			return 1;
+		}
+		options.image_tag = image_tag;
+	}
+	if (LoadImage(argv[optind], &image, options.byte_swap) < 0) {
+		fprintf(stderr, "Can't load %s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	if (image.encrypted && options.verify) {
+		fprintf(stderr, "An encrypted image can't be verified with page CRCs - use a tag (-t) instead\n");
+		return 2;
+	}
+
+	int session_cnt = argc - optind - 1;
+	Flash_Session* sessions = calloc(session_cnt, sizeof(Flash_Session));
+	for (int i = 0; i < session_cnt; i++) {
+		sessions[i].port_name = argv[optind + 1 + i];
+		sessions[i].options = &options;
+		sessions[i].image = &image;
+	}
+
+	//one port: no threads, plain progress
+	if (session_cnt == 1) {
+		sessions[0].result = FlashDevice(&sessions[0], &options, &image, 1);
+		PrintResult(&sessions[0]);
+		return (sessions[0].result < 0) ? 1 : 0;
+	}
+
+	//several ports: one thread each
+	double start_time = NowSeconds();
+	for (int i = 0; i < session_cnt; i++) {
+		if (pthread_create(&sessions[i].thread, NULL, FlashDeviceThread, &sessions[i]) != 0) {
+			sessions[i].result = -1;
+			sessions[i].fail_reason = "can't start thread";
+			sessions[i].done = 1;
+		}
+	}
+
+	int done_cnt = 0;
+	while (done_cnt < session_cnt) {
+		SleepMs(200);
+		ShowProgress(sessions, session_cnt);
+		done_cnt = 0;
+		for (int i = 0; i < session_cnt; i++) done_cnt += sessions[i].done;
+	}
+	fputc('\n', stderr);
+
+	int fail_cnt = 0;
+	for (int i = 0; i < session_cnt; i++) {
+		if (sessions[i].thread) pthread_join(sessions[i].thread, NULL);
+		PrintResult(&sessions[i]);
+		if (sessions[i].result < 0) fail_cnt++;
+	}
+	fprintf(stderr, "%d devices in %.2f s: %d PASS, %d FAIL\n", session_cnt, NowSeconds() - start_time, session_cnt - fail_cnt, fail_cnt);
+	return (fail_cnt != 0) ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.0
+ *  File: BootLogDecoder.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Host side decoder for the tokenized log of the bootloader (bootloader built with "log_tokenized").
+ *
+ * v.1.0
+ * Reads the UART2 log - from the ST-Link virtual COM port or from a captured file - and rebuilds the text using BootLogTokens.def.
+ * Frames are [0xA5][token][number of arguments][arguments as 32-bit little endian words].
+ * Anything that is not a valid frame is skipped until the next sync byte.
+ *
+ * Build: gcc -O2 -Wall -o bootlogdecode BootLogDecoder.c
+ * Usage: bootlogdecode [/dev/ttyACM0 [baud]]     (reads stdin if no port is given)
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+//LOCAL CONSTANT
+#define Log_frame_sync_byte		0xA5
+#define Log_frame_max_args		4
+
+#define BOOT_LOG_TOKEN(token, format) format,
+static const char* const Log_format_table[] = {
+#include "../BootLogTokens.def"
+};
+#undef BOOT_LOG_TOKEN
+
+static const unsigned Log_token_count = sizeof(Log_format_table) / sizeof(Log_format_table[0]);
+
+
+//1)Count the conversions in a format string
+static unsigned CountFormatArgs(const char* format) {
+	unsigned arg_cnt = 0;
+	for (const char* c = format; *c != '\0'; c++) {
+		if (*c != '%') continue;
+		if (c[1] == '%') {
+			c++;																		//"%%" is not a conversion
+		} else {
+			arg_cnt++;
+		}
+	}
+	return arg_cnt;
+}
+
+
+//2)Open the serial port in raw mode
+static int OpenSerialPort(const char* port_name, speed_t baud) {
+	int port_fd = open(port_name, O_RDONLY | O_NOCTTY);
+	if (port_fd < 0) return -1;
+
+	struct termios tty;
+	if (tcgetattr(port_fd, &tty) == 0) {												//not a tty (e.g. a capture file) - we just read it
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, baud);
+		cfsetospeed(&tty, baud);
+		tty.c_cc[VMIN] = 1;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(port_fd, TCSANOW, &tty);
+	}
+	return port_fd;
+}
+
+
+static speed_t BaudToSpeed(long baud) {
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	default: return 0;
+	}
+}
+
+
+//3)Decoder state machine
+/*
+ * 1)Wait for the sync byte
+ * 2)Check the token and the argument count against the table - a mismatch means we locked onto a data byte, so we resync
+ * 3)Collect the arguments
+ * 4)Print
+ *
+ * */
+int main(int argc, char** argv) {
+	int in_fd = STDIN_FILENO;
+
+	if (argc > 1) {
+		speed_t baud = BaudToSpeed((argc > 2) ? strtol(argv[2], NULL, 10) : 115200);
+		if (baud == 0) {
+			fprintf(stderr, "Unsupported baud rate\n");
+			return 2;
+		}
+		in_fd = OpenSerialPort(argv[1], baud);
+		if (in_fd < 0) {
+			fprintf(stderr, "Can't open %s: %s\n", argv[1], strerror(errno));
+			return 1;
+		}
+	}
+
+	enum { Wait_sync, Wait_token, Wait_arg_cnt, Wait_args } decoder_state = Wait_sync;
+	uint8_t token = 0;
+	uint8_t arg_cnt = 0;
+	uint8_t arg_bytes[4 * Log_frame_max_args];
+	uint8_t arg_byte_cnt = 0;
+	unsigned long skipped_bytes = 0;
+	uint8_t rx_buf[256];
+	ssize_t rx_len;
+
+	while ((rx_len = read(in_fd, rx_buf, sizeof(rx_buf))) > 0) {
+		for (ssize_t i = 0; i < rx_len; i++) {
+			uint8_t rx_byte = rx_buf[i];
+
+			switch (decoder_state) {
+			//1)
+			case Wait_sync:
+				if (rx_byte == Log_frame_sync_byte) {
+					decoder_state = Wait_token;
+				} else {
+					skipped_bytes++;
+				}
+				break;
+
+			//2)
+			case Wait_token:
+				if (rx_byte < Log_token_count) {
+					token = rx_byte;
+					decoder_state = Wait_arg_cnt;
+				} else {
+					skipped_bytes += 2;
+					decoder_state = (rx_byte == Log_frame_sync_byte) ? Wait_token : Wait_sync;
+				}
+				break;
+
+			case Wait_arg_cnt:
+				if ((rx_byte <= Log_frame_max_args) && (rx_byte == CountFormatArgs(Log_format_table[token]))) {
+					arg_cnt = rx_byte;
+					arg_byte_cnt = 0;
+					decoder_state = (arg_cnt == 0) ? Wait_sync : Wait_args;
+				} else {
+					skipped_bytes += 3;
+					decoder_state = (rx_byte == Log_frame_sync_byte) ? Wait_token : Wait_sync;
+					break;
+				}
+				if (decoder_state == Wait_sync) {
+					fputs(Log_format_table[token], stdout);								//4) no arguments
+					fflush(stdout);
+				}
+				break;
+
+			//3)
+			case Wait_args:
+				arg_bytes[arg_byte_cnt++] = rx_byte;
+				if (arg_byte_cnt == (4 * arg_cnt)) {
+					uint32_t args[Log_frame_max_args] = {0};
+					for (uint8_t a = 0; a < arg_cnt; a++) {
+						args[a] = (uint32_t) arg_bytes[4 * a] | ((uint32_t) arg_bytes[4 * a + 1] << 8) |
+								((uint32_t) arg_bytes[4 * a + 2] << 16) | ((uint32_t) arg_bytes[4 * a + 3] << 24);
+					}
+					//4)
+					printf(Log_format_table[token], args[0], args[1], args[2], args[3]);
+					fflush(stdout);
+					decoder_state = Wait_sync;
+				}
+				break;
+			}
+		}
+	}
+
+	if (skipped_bytes != 0) fprintf(stderr, "%lu bytes skipped while resynchronising\n", skipped_bytes);
+	return 0;
+}
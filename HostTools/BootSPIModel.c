@@ -0,0 +1,527 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.1
+ *  File: BootSPIModel.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Host model of the SPI1 slave transport (spi1_transport), to check the DMA and ready line handshake without a board.
+ *
+ * v.1.0
+ * Steps the transport in 100 ns ticks. The slave side follows the bootloader line by line where it matters:
+ * SPI1TransactionEnd for the commands, the channel 2 DMA IRQ (HT/TC flags, ready line LOW), the NSS IRQ (two transactions without a page end the session),
+ * the ping-pong handover of the external controller (SessionRxHalfToFLASH, then Machine_Code_Page_Received back to None) and the chunks of SPI1TxStream.
+ * The EXTI IRQ of the NSS has a higher priority (2) than the DMA IRQ (3), same as in BootIRQ_Control.c - if both are pending, the NSS edge is served first.
+ * The master follows the rules in the readme: it only starts a transaction on a HIGH ready line and holds NSS LOW for a few us after the last clock.
+ * Every case checks that the pages end up in the FLASH in order, that the DMA never writes into a half the controller still owns, that no page flag is lost and that the session only ends on the filler.
+ * Two cases break a rule of the master on purpose: the model must catch them.
+ *
+ * Note: the FLASH time is the datasheet typical (3.2 ms for the erase and each half-page write), the IRQ latencies are estimates for the ram_update_path build. None of it is measured.
+ *
+ * v.1.1
+ * Cases are reported through BootTestCheck.h, shared with the other self-tests.
+ *
+ * Build: gcc -O2 -Wall -o bootspimodel BootSPIModel.c
+ * Usage: bootspimodel -T
+ *        bootspimodel [-k sck_khz] [-h nss_hold_ns] [-d dma_irq_latency_ns] [-w page_write_us] [-p pages] [-i]
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "BootTestCheck.h"
+
+//LOCAL CONSTANT
+#define Flash_page_size			128
+#define Rx_half_pages			1												//Dev_Rx_half_pages with spi1_transport, on every part
+#define Rx_half_size			(Rx_half_pages * Flash_page_size)
+#define Rx_buf_size				(2 * Rx_half_size)								//DMA_transfer_width_UART1
+#define SPI1_stream_chunk		0x8000											//same as in BootSPIDriver_STM32L0x3.h
+#define Msg_start_byte			0xF0
+#define Tick_ns					100
+#define Max_pages				512
+#define Readback_len			0x28000											//the app section of a category 5 part: 0x8008000 to 0x8030000
+#define Sim_timeout_ticks		(60LL * 1000 * 1000 * 10)						//60 s
+
+//LOCAL TYPE
+typedef enum {
+	None,
+	First,
+	Second
+} enum_First_Second_Selector;
+
+typedef enum {
+	Action_None,
+	Action_Programmer_Mode_Enter,												//UART1ProgrammerModeEnter: clock switch, then SPI1DMAEnable
+	Action_Page_Written,														//the end of SessionRxHalfToFLASH: the page is in, the ready line goes HIGH
+	Action_Page_Flag_Clear,														//back in the controller: Machine_Code_Page_Received = None
+	Action_Session_End
+} enum_Controller_Action;
+
+typedef struct {
+	const char* name;
+	uint32_t sck_khz;
+	uint32_t nss_hold_ns;														//last clock to NSS HIGH
+	uint32_t master_reaction_ns;												//NSS HIGH (or the ready line going HIGH) to the next sample of the ready line
+	uint32_t dma_irq_latency_ns;
+	uint32_t nss_irq_latency_ns;
+	uint32_t page_write_us;														//erase and two half-page writes
+	uint32_t mode_enter_us;
+	uint32_t loop_ns;															//one pass of the controller
+	uint32_t page_cnt;
+	int ignore_ready;															//fault: the master clocks without looking at the ready line
+} Model_Params;
+
+typedef struct {
+	//slave
+	uint8_t rx_buf[Rx_buf_size];												//Rx_Message_buf
+	uint16_t cndtr;																//DMA1_Channel2->CNDTR - 16 bits, as on the device
+	int rxdmaen;
+	int circular;
+	int ready;																	//PA8
+	int flag_ht;
+	int flag_tc;
+	int64_t dma_irq_at;															//-1: not pending
+	int64_t nss_irq_at;
+	int programmer_mode;														//UART1_DMA_active
+	enum_First_Second_Selector page_received;									//Machine_Code_Page_Received
+	int idle_cnt;																//Idle_frame_counter
+	int message_received;														//UART1_Message_Received
+	uint16_t rx_message_len;
+	int half_owned[2];															//the half is full and not in the FLASH yet
+	enum_First_Second_Selector half_in_write;
+	int64_t busy_until;
+	enum_Controller_Action action;
+	uint8_t command;
+	//master
+	int64_t nss_low_at;
+	int64_t first_page_at;
+	int filler_sent;
+	//results
+	uint8_t flash[Max_pages * Flash_page_size];
+	uint32_t flash_pages;
+	uint32_t pages_received;
+	uint32_t overrun_cnt;
+	uint32_t flag_lost_cnt;
+	int session_ended;
+	int session_end_early;
+	int64_t session_end_at;
+} Model_State;
+
+
+//1)Image
+static void MakeImage(uint8_t* image, uint32_t len) {
+	uint32_t seed = 0x2468ACE1;
+	for (uint32_t i = 0; i < len; i++) {
+		seed = (seed * 1103515245) + 12345;
+		image[i] = seed >> 16;
+	}
+}
+
+
+//2)Slave side
+static void DMARxByte(Model_State* state, const Model_Params* params, int64_t now, uint8_t rx_byte) {
+	/*
+	 * The DMA on channel 2 stores what the SPI1 received, if RXDMAEN is set.
+	 *
+	 * 1)Normal mode (commands): the buffer fills up, then the DMA stops
+	 * 2)Circular mode (machine code): HT at the middle, TC at the end, then the DMA is back at the start. A half the controller still owns must not be touched.
+	 *
+	 * */
+
+	if (!state->rxdmaen || (state->cndtr == 0)) return;
+	uint16_t rx_pos = Rx_buf_size - state->cndtr;
+
+	//1)
+	if (!state->circular) {
+		state->rx_buf[rx_pos] = rx_byte;
+		state->cndtr--;
+		return;
+	}
+
+	//2)
+	if (state->half_owned[rx_pos / Rx_half_size]) state->overrun_cnt++;
+	state->rx_buf[rx_pos] = rx_byte;
+	state->cndtr--;
+	if ((rx_pos + 1) == Rx_half_size) {
+		state->flag_ht = 1;
+		state->half_owned[0] = 1;
+	} else if (state->cndtr == 0) {
+		state->flag_tc = 1;
+		state->half_owned[1] = 1;
+		state->cndtr = Rx_buf_size;												//circular reload
+	} else {
+		return;
+	}
+	if (state->dma_irq_at < 0) state->dma_irq_at = now + (params->dma_irq_latency_ns / Tick_ns);
+}
+
+
+//DMA1_Channel2_3_IRQHandler, spi1_transport part
+static void DMAIRQ(Model_State* state) {
+	if (state->page_received != None) state->flag_lost_cnt++;				//the controller has not picked up the last page yet: it is overwritten
+	if (state->flag_ht) {
+		if (state->flag_tc) state->flag_lost_cnt++;							//both halves in one IRQ: only the first one is seen
+		state->page_received = First;
+	} else if (state->flag_tc) {
+		state->page_received = Second;
+	}
+	state->ready = 0;															//SPI1ReadyLow
+	state->pages_received++;
+	state->idle_cnt = 0;
+	state->flag_ht = 0;															//IFCR CGIF2
+	state->flag_tc = 0;
+}
+
+
+//SPI1TransactionEnd
+static void TransactionEnd(Model_State* state) {
+	uint16_t rx_len = Rx_buf_size - state->cndtr;
+
+	if (!state->rxdmaen) return;
+	if ((rx_len >= 3) && (state->rx_buf[0] == Msg_start_byte) && (state->rx_buf[1] == Msg_start_byte)) {
+		state->rxdmaen = 0;
+		state->ready = 0;
+		state->rx_message_len = rx_len;
+		state->message_received = 1;
+	} else {
+		state->cndtr = Rx_buf_size;												//noise: we start from the beginning of the buffer
+	}
+}
+
+
+//EXTI4_15_IRQHandler, line 15
+static void NSSIRQ(Model_State* state, const Model_Params* params) {
+	if (state->programmer_mode) {
+		state->idle_cnt++;
+		if (state->idle_cnt >= 2) {
+			state->message_received = 1;
+			state->idle_cnt = 0;
+			if (!state->filler_sent || (state->pages_received < params->page_cnt)) state->session_end_early = 1;
+		}
+	} else {
+		TransactionEnd(state);
+	}
+}
+
+
+static void ServeIRQs(Model_State* state, const Model_Params* params, int64_t now) {
+	int nss_due = (state->nss_irq_at >= 0) && (state->nss_irq_at <= now);
+	int dma_due = (state->dma_irq_at >= 0) && (state->dma_irq_at <= now);
+
+	if (nss_due) {																//priority 2 before priority 3
+		state->nss_irq_at = -1;
+		NSSIRQ(state, params);
+	} else if (dma_due) {
+		state->dma_irq_at = -1;
+		DMAIRQ(state);
+	}
+}
+
+
+/*
+ * One pass of UART1_External_Boot_Controller, or the end of what it was busy with.
+ *
+ * 1)Command mode: the message is in, the start sequence is dropped (SPI1RxMessage). 0xbb enters the programmer mode.
+ * 2)Programmer mode: the session ends on the flag of the NSS IRQ, a page flag starts the FLASH write of that half
+ * 3)The write is done: the page goes into the FLASH, the ready line is released, then the flag is cleared - in this order, as on the device
+ *
+ * */
+static void Controller(Model_State* state, const Model_Params* params, int64_t now) {
+	if (now < state->busy_until) return;
+
+	//3)
+	switch (state->action) {
+	case Action_Programmer_Mode_Enter:											//SPI1DMAEnable
+		state->cndtr = Rx_buf_size;
+		state->circular = 1;
+		state->rxdmaen = 1;
+		state->programmer_mode = 1;
+		state->idle_cnt = 0;
+		state->page_received = None;
+		state->message_received = 0;
+		state->ready = 1;
+		break;
+
+	case Action_Page_Written:
+	{
+		uint32_t half = (state->half_in_write == First) ? 0 : 1;
+		if (state->flash_pages < Max_pages) {
+			memcpy(&state->flash[state->flash_pages * Flash_page_size], &state->rx_buf[half * Rx_half_size], Rx_half_size);
+			state->flash_pages += Rx_half_pages;
+		}
+		state->half_owned[half] = 0;
+		state->ready = 1;														//BootLinkFlowRelease
+		state->action = Action_Page_Flag_Clear;
+		state->busy_until = now + (params->loop_ns / Tick_ns);
+		return;
+	}
+
+	case Action_Page_Flag_Clear:
+		if (state->page_received != state->half_in_write) state->flag_lost_cnt++;	//a new flag came in while we were writing - clearing it drops that page
+		state->page_received = None;
+		break;
+
+	case Action_Session_End:
+		state->session_ended = 1;
+		state->session_end_at = now;
+		break;
+
+	default:
+		break;
+	}
+	state->action = Action_None;
+	if (state->session_ended) return;
+
+	//1)
+	if (!state->programmer_mode) {
+		if (state->message_received) {
+			state->message_received = 0;
+			state->command = state->rx_buf[2];									//after the memmove of the start sequence, the command is the first byte
+			if (state->command == 0xbb) {
+				state->action = Action_Programmer_Mode_Enter;
+				state->busy_until = now + (params->mode_enter_us * 1000LL / Tick_ns);
+			} else {
+				state->cndtr = Rx_buf_size;										//SPI1RxMessage again
+				state->rxdmaen = 1;
+				state->ready = 1;
+			}
+		}
+		return;
+	}
+
+	//2)
+	if (state->message_received) {
+		state->action = Action_Session_End;
+		state->busy_until = now + (params->loop_ns / Tick_ns);
+	} else if (state->page_received != None) {
+		state->half_in_write = state->page_received;
+		state->ready = 0;														//BootLinkFlowHold
+		state->action = Action_Page_Written;
+		state->busy_until = now + (params->page_write_us * 1000LL / Tick_ns);
+	} else {
+		state->busy_until = now + (params->loop_ns / Tick_ns);
+	}
+}
+
+
+//3)Update session
+/*
+ * 1)The master: a noise transaction, the 0xbb command, the pages one transaction each, then the filler transaction
+ * 2)Each tick: the master, the IRQs, the controller
+ * 3)Checks
+ *
+ * Note: before each transaction, the master samples the ready line once every master_reaction_ns and starts on HIGH (unless the fault says otherwise).
+ *
+ * */
+static int RunSession(const Model_Params* params, Model_State* state, int verbose) {
+	static uint8_t image[Max_pages * Flash_page_size];
+	const uint8_t noise[1] = { 0x00 };
+	const uint8_t update_cmd[3] = { Msg_start_byte, Msg_start_byte, 0xbb };
+	const uint8_t filler[1] = { 0xFF };
+	int64_t byte_ticks = (8LL * 1000 * 1000 * 1000 / params->sck_khz / 1000) / Tick_ns;
+	int64_t reaction_ticks = params->master_reaction_ns / Tick_ns;
+	uint32_t transaction_cnt = params->page_cnt + 3;
+	uint32_t transaction = 0;
+	uint32_t tx_pos = 0;
+	int64_t next_sample = 0;
+	int64_t nss_high_at = -1;
+	int nss_low = 0;
+
+	if (byte_ticks < 1) byte_ticks = 1;
+	if (params->page_cnt > Max_pages) return -1;
+	memset(state, 0, sizeof(Model_State));
+	state->cndtr = Rx_buf_size;													//SPI1RxMessage: listening
+	state->rxdmaen = 1;
+	state->ready = 1;
+	state->dma_irq_at = -1;
+	state->nss_irq_at = -1;
+	state->first_page_at = -1;
+	state->half_in_write = None;
+	MakeImage(image, params->page_cnt * Flash_page_size);
+
+	//2)
+	for (int64_t now = 0; (now < Sim_timeout_ticks) && !state->session_ended; now++) {
+
+		//1)
+		if (transaction < transaction_cnt) {
+			const uint8_t* tx_data = (transaction == 0) ? noise : (transaction == 1) ? update_cmd
+					: (transaction == transaction_cnt - 1) ? filler : &image[(transaction - 2) * Flash_page_size];
+			uint32_t tx_len = (transaction == 1) ? 3 : ((transaction == 0) || (transaction == transaction_cnt - 1)) ? 1 : Flash_page_size;
+
+			if (!nss_low && (nss_high_at < 0) && (now >= next_sample)) {
+				if (state->ready || params->ignore_ready) {
+					nss_low = 1;
+					tx_pos = 0;
+					state->nss_low_at = now;
+					if ((transaction == 2) && (state->first_page_at < 0)) state->first_page_at = now;
+				} else {
+					next_sample = now + reaction_ticks;
+				}
+			} else if (nss_low && (tx_pos < tx_len) && (((now - state->nss_low_at) % byte_ticks) == (byte_ticks - 1))) {
+				DMARxByte(state, params, now, tx_data[tx_pos++]);
+				if (tx_pos == tx_len) nss_high_at = now + (params->nss_hold_ns / Tick_ns);
+			} else if (nss_low && (nss_high_at >= 0) && (now >= nss_high_at)) {
+				nss_low = 0;
+				nss_high_at = -1;
+				if (state->nss_irq_at < 0) state->nss_irq_at = now + (params->nss_irq_latency_ns / Tick_ns);
+				if (transaction == transaction_cnt - 1) state->filler_sent = 1;
+				transaction++;
+				next_sample = now + reaction_ticks;
+			}
+		}
+
+		ServeIRQs(state, params, now);
+		Controller(state, params, now);
+	}
+
+	//3)
+	int pass = state->session_ended && !state->session_end_early && (state->overrun_cnt == 0) && (state->flag_lost_cnt == 0)
+			&& (state->pages_received == params->page_cnt) && (state->flash_pages == params->page_cnt)
+			&& (memcmp(state->flash, image, params->page_cnt * Flash_page_size) == 0);
+	if (verbose) {
+		double stream_s = (state->session_end_at - state->first_page_at) * (Tick_ns / 1e9);
+		printf("%s: %u pages at %u kHz SCK, NSS hold %u ns, DMA IRQ %u ns\n", params->name, params->page_cnt, params->sck_khz, params->nss_hold_ns, params->dma_irq_latency_ns);
+		printf("  session %s%s, %u pages received, %u in the FLASH, %u overruns, %u page flags lost\n", state->session_ended ? "ended" : "TIMED OUT",
+				state->session_end_early ? " EARLY" : "", state->pages_received, state->flash_pages, state->overrun_cnt, state->flag_lost_cnt);
+		if (state->session_ended && (stream_s > 0)) {
+			printf("  %.0f bytes/s (line limit %.0f bytes/s)\n", params->page_cnt * Flash_page_size / stream_s, params->sck_khz * 1000.0 / 8);
+		}
+	}
+	return pass ? 0 : 1;
+}
+
+
+//4)Readback
+/*
+ * SPI1TxStream: the header (command and length) in one transaction, then the block in transactions of SPI1_stream_chunk bytes at most.
+ * Every transaction goes through the 16 bit CNDTR of channel 3. The master reads exactly the length of the header, chunk by chunk.
+ *
+ * Returns the number of block bytes the master got right, or -1 if the transactions did not add up.
+ *
+ * */
+static long Readback(const uint8_t* block, uint32_t stream_len, uint32_t chunk_max, uint32_t* transaction_cnt) {
+	static uint8_t master_buf[Readback_len];
+	uint32_t got = 0;
+
+	*transaction_cnt = 1;														//the header
+	while (stream_len - got > 0) {
+		uint32_t chunk_len = ((stream_len - got) > chunk_max) ? chunk_max : (stream_len - got);
+		uint16_t cndtr = chunk_len;												//DMA1_Channel3->CNDTR = tx_len
+		uint32_t master_len = ((stream_len - got) > SPI1_stream_chunk) ? SPI1_stream_chunk : (stream_len - got);	//the master clocks its own chunk size
+		if (cndtr == 0) return -1;												//a length of 0x10000 is a zero CNDTR: the DMA does not run
+		for (uint32_t i = 0; i < master_len; i++) {
+			master_buf[got + i] = (i < cndtr) ? block[got + i] : 0x00;			//past the end of the DMA, the SPI1 sends the last byte again - don't-care, but wrong
+		}
+		got += master_len;
+		(*transaction_cnt)++;
+		if (chunk_len != cndtr) break;											//the length was cut
+	}
+	if (got != stream_len) return -1;
+	long good = 0;
+	while (((uint32_t) good < stream_len) && (master_buf[good] == block[good])) good++;
+	return good;
+}
+
+
+//5)Self-test
+/*
+ * 1)Update at 4 MHz and at 16 MHz SCK, and with the FLASH at twice the typical time: every page in the FLASH, no overrun, no lost flag, the session ends on the filler
+ * 2)The master ignores the ready line: the model must see the overrun
+ * 3)NSS goes HIGH right after the last clock while the DMA IRQ is late: the master sees a ready line that is still HIGH and overruns the buffer,
+ *   and the NSS IRQ of each page comes before its DMA IRQ, so the filler never makes two transactions without a page - the model must see both
+ * 4)Readback of the category 5 app section (160 kB): header plus 5 transactions of 32 kB, the block arrives complete
+ * 5)The same in one transaction (v1.2 of the driver): the 16 bit CNDTR cuts it - the check must fail
+ *
+ * */
+static const Model_Params Nominal_params = {
+	"nominal", 4000, 5000, 2000, 1000, 1000, 9600, 200, 2000, 48, 0
+};
+
+
+static int SelfTest(void) {
+	static Model_State state;
+	static uint8_t block[Readback_len];
+	Model_Params params;
+	uint32_t transaction_cnt;
+	int fail_cnt = 0;
+
+	//1)
+	params = Nominal_params;
+	fail_cnt += CheckCase("update 4 MHz", RunSession(&params, &state, 0) == 0);
+	params.sck_khz = 16000;
+	fail_cnt += CheckCase("update 16 MHz", RunSession(&params, &state, 0) == 0);
+	params = Nominal_params;
+	params.page_write_us *= 2;
+	fail_cnt += CheckCase("update slow FLASH", RunSession(&params, &state, 0) == 0);
+
+	//2)
+	params = Nominal_params;
+	params.ignore_ready = 1;
+	fail_cnt += CheckCase("ready ignored is caught", (RunSession(&params, &state, 0) != 0) && (state.overrun_cnt != 0));
+
+	//3)
+	params = Nominal_params;
+	params.nss_hold_ns = 0;
+	params.dma_irq_latency_ns = 3000;
+	fail_cnt += CheckCase("no NSS hold is caught", (RunSession(&params, &state, 0) != 0) && (state.overrun_cnt != 0) && !state.session_ended);
+
+	//4)
+	MakeImage(block, Readback_len);
+	long good = Readback(block, Readback_len, SPI1_stream_chunk, &transaction_cnt);
+	fail_cnt += CheckCase("readback 160 kB in chunks", (good == Readback_len) && (transaction_cnt == 1 + (Readback_len / SPI1_stream_chunk)));
+
+	//5)
+	good = Readback(block, Readback_len, Readback_len, &transaction_cnt);
+	fail_cnt += CheckCase("one transaction is caught", good != Readback_len);
+
+	return fail_cnt;
+}
+
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+			"Usage: bootspimodel -T                 self-test of the SPI1 transport model\n"
+			"       bootspimodel [options]          one update session, with the result and the throughput\n"
+			"  -k kHz        SCK of the master (default 4000)\n"
+			"  -h ns         NSS hold after the last clock (default 5000)\n"
+			"  -d ns         DMA IRQ latency (default 1000)\n"
+			"  -w us         FLASH time of one page (default 9600)\n"
+			"  -p pages      pages in the image (default 48, up to 512)\n"
+			"  -i            the master ignores the ready line\n");
+}
+
+
+int main(int argc, char** argv) {
+	static Model_State state;
+	Model_Params params = Nominal_params;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "Tk:h:d:w:p:i")) != -1) {
+		switch (opt) {
+		case 'T': return (SelfTest() == 0) ? 0 : 1;
+		case 'k': params.sck_khz = strtoul(optarg, NULL, 0); break;
+		case 'h': params.nss_hold_ns = strtoul(optarg, NULL, 0); break;
+		case 'd': params.dma_irq_latency_ns = strtoul(optarg, NULL, 0); break;
+		case 'w': params.page_write_us = strtoul(optarg, NULL, 0); break;
+		case 'p': params.page_cnt = strtoul(optarg, NULL, 0); break;
+		case 'i': params.ignore_ready = 1; break;
+		default: PrintUsage(); return 2;
+		}
+	}
+	if ((params.sck_khz == 0) || (params.page_cnt == 0) || (params.page_cnt > Max_pages)) {
+		PrintUsage();
+		return 2;
+	}
+	params.name = "session";
+	int result = RunSession(&params, &state, 1);
+	CheckCase(params.name, result == 0);
+	return result;
+}
@@ -0,0 +1,429 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.2
+ *  File: BootSign.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Host side tool for signed images (image_signed).
+ *
+ * v.1.0
+ * Makes the tag of an image: HMAC-SHA256 with the key of the bootloader over the image padded to full pages with 0xFF - the bytes the bootloader hashes on its side.
+ * The tag goes into image.bin.sig (32 bytes), the flasher sends it with -t.
+ * Uses the SHA-256 of the bootloader itself (BootSHA256.c), so the reference test (-T) checks the very same code that runs on the device.
+ * The benchmark (-b) has the bootloader hash a block of its app section (0xb4), prints the time and the cycles per byte, then reads the block back (0xb7) and checks the digest.
+ *
+ * Note: the key file is 32 raw bytes. Without -k, the development key of BootImageAuth.c is used.
+ *
+ * v.1.1
+ * Big-endian images (-R): the tag is made over the image with its words byte swapped, same as the bootloader hashes it after the swap (0xb1).
+ *
+ * v.1.2
+ * The reference test reports through BootTestCheck.h, like the other self-tests.
+ *
+ * Build: gcc -O2 -Wall -I.. -o bootsign BootSign.c ../BootSHA256.c
+ * Usage: bootsign [-k key.bin] [-R] image.bin
+ *        bootsign -T
+ *        bootsign -b 4096 [-p baud] [-A activation] [-s] /dev/ttyUSB0
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BootSHA256.h"
+#include "BootTestCheck.h"
+
+//LOCAL CONSTANT
+#define Flash_page_size			128												//the bootloader hashes whole pages
+#define Flash_slot_size			0x4000											//one app slot
+#define Msg_start_byte			0xF0
+#define Msg_gap_ms				10												//gap that closes a message on the bootloader side
+#define Reply_timeout_ms		2000
+#define App_section_start		0x08008000										//the benchmark hashes from here
+#define Bench_max_bytes			4096											//Bench_max_bytes of the bootloader (BootBench.h)
+
+static const uint8_t Dev_key[HMAC_key_size] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+};
+
+
+//1)Hex helpers
+static void HexString(const uint8_t* src, size_t len, char* dst) {
+	for (size_t i = 0; i < len; i++) sprintf(&dst[2 * i], "%02x", src[i]);
+}
+
+
+static size_t HexBytes(const char* src, uint8_t* dst) {
+	size_t len = 0;
+	while (src[0] && src[1]) {
+		unsigned byte;
+		sscanf(src, "%2x", &byte);
+		dst[len++] = byte;
+		src += 2;
+	}
+	return len;
+}
+
+
+//2)Reference test
+/*
+ * 1)SHA-256 vectors of FIPS 180-4: "abc", the two block message and a million 'a' fed in odd chunks
+ * 2)HMAC-SHA256 vectors of RFC 4231, cases 1 and 4 - their keys are shorter than 32 bytes, zero padding them gives the same HMAC
+ * 3)Streaming: the same message fed in every split must give the same digest as in one go
+ *
+ * */
+static int ReferenceTest(void) {
+	struct_SHA256_Ctx ctx;
+	uint8_t digest[SHA256_digest_size];
+	int fail_cnt = 0;
+
+	//1)
+	SHA256Init(&ctx);
+	SHA256Update(&ctx, (const uint8_t*) "abc", 3);
+	SHA256Final(&ctx, digest);
+	fail_cnt += CheckBytes("sha256 abc", digest, SHA256_digest_size, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+	const char* two_block_msg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	SHA256Init(&ctx);
+	SHA256Update(&ctx, (const uint8_t*) two_block_msg, strlen(two_block_msg));
+	SHA256Final(&ctx, digest);
+	fail_cnt += CheckBytes("sha256 448 bit", digest, SHA256_digest_size, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+	uint8_t a_chunk[1000];
+	memset(a_chunk, 'a', sizeof(a_chunk));
+	SHA256Init(&ctx);
+	for (uint32_t fed = 0; fed < 1000000; ) {
+		uint32_t chunk_len = 1 + (fed % 997);
+		if (chunk_len > (1000000 - fed)) chunk_len = 1000000 - fed;
+		SHA256Update(&ctx, a_chunk, chunk_len);
+		fed += chunk_len;
+	}
+	SHA256Final(&ctx, digest);
+	fail_cnt += CheckBytes("sha256 million a", digest, SHA256_digest_size, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+	//2)
+	uint8_t key[HMAC_key_size];
+	uint8_t msg[64];
+	HexBytes("0102030405060708090a0b0c0d0e0f10111213141516171819", key);		//25 byte key
+	memset(&key[25], 0, HMAC_key_size - 25);
+	memset(msg, 0xcd, 50);
+	HMACSHA256Start(&ctx, key);
+	SHA256Update(&ctx, msg, 50);
+	HMACSHA256Finish(&ctx, key, digest);
+	fail_cnt += CheckBytes("hmac rfc4231 case 4", digest, SHA256_digest_size, "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b");
+
+	memset(key, 0x0b, 20);
+	memset(&key[20], 0, HMAC_key_size - 20);
+	HMACSHA256Start(&ctx, key);
+	SHA256Update(&ctx, (const uint8_t*) "Hi There", 8);
+	HMACSHA256Finish(&ctx, key, digest);
+	fail_cnt += CheckBytes("hmac rfc4231 case 1", digest, SHA256_digest_size, "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+
+	//3)
+	uint8_t stream_msg[300];
+	uint8_t one_go_digest[SHA256_digest_size];
+	for (int i = 0; i < (int) sizeof(stream_msg); i++) stream_msg[i] = i * 7;
+	HMACSHA256Start(&ctx, Dev_key);
+	SHA256Update(&ctx, stream_msg, sizeof(stream_msg));
+	HMACSHA256Finish(&ctx, Dev_key, one_go_digest);
+	int split_fail_cnt = 0;
+	for (int split = 1; split < (int) sizeof(stream_msg); split++) {
+		HMACSHA256Start(&ctx, Dev_key);
+		SHA256Update(&ctx, stream_msg, split);
+		SHA256Update(&ctx, &stream_msg[split], sizeof(stream_msg) - split);
+		HMACSHA256Finish(&ctx, Dev_key, digest);
+		if (memcmp(digest, one_go_digest, SHA256_digest_size) != 0) split_fail_cnt++;
+	}
+	fail_cnt += CheckCase("streaming splits", split_fail_cnt == 0);
+
+	return fail_cnt;
+}
+
+
+//3)Tag of an image
+static int SignImage(const char* image_name, const uint8_t* key, int byte_swap) {
+	FILE* image_file = fopen(image_name, "rb");
+	if (image_file == NULL) {
+		fprintf(stderr, "Can't open %s: %s\n", image_name, strerror(errno));
+		return 1;
+	}
+	uint8_t* image_data = malloc(Flash_slot_size + 1);
+	size_t image_len = fread(image_data, 1, Flash_slot_size + 1, image_file);
+	fclose(image_file);
+	if ((image_len == 0) || (image_len > Flash_slot_size)) {
+		fprintf(stderr, "%s: image must be 1 to %d bytes\n", image_name, Flash_slot_size);
+		free(image_data);
+		return 1;
+	}
+	size_t padded_len = (image_len + Flash_page_size - 1) / Flash_page_size * Flash_page_size;
+	memset(&image_data[image_len], 0xFF, padded_len - image_len);				//same padding as the flasher
+	if (byte_swap) {
+		for (size_t i = 0; i < padded_len; i += 4) {
+			uint32_t image_word;
+			memcpy(&image_word, &image_data[i], 4);
+			image_word = __builtin_bswap32(image_word);
+			memcpy(&image_data[i], &image_word, 4);
+		}
+	}
+
+	struct_SHA256_Ctx ctx;
+	uint8_t image_tag[SHA256_digest_size];
+	char tag_hex[(2 * SHA256_digest_size) + 1];
+	HMACSHA256Start(&ctx, key);
+	SHA256Update(&ctx, image_data, padded_len);
+	HMACSHA256Finish(&ctx, key, image_tag);
+	free(image_data);
+
+	char sig_name[4096];
+	snprintf(sig_name, sizeof(sig_name), "%s.sig", image_name);
+	FILE* sig_file = fopen(sig_name, "wb");
+	if ((sig_file == NULL) || (fwrite(image_tag, 1, SHA256_digest_size, sig_file) != SHA256_digest_size)) {
+		fprintf(stderr, "Can't write %s: %s\n", sig_name, strerror(errno));
+		if (sig_file != NULL) fclose(sig_file);
+		return 1;
+	}
+	fclose(sig_file);
+	HexString(image_tag, SHA256_digest_size, tag_hex);
+	printf("%s: %zu bytes (%zu padded), tag %s -> %s\n", image_name, image_len, padded_len, tag_hex, sig_name);
+	return 0;
+}
+
+
+//4)Serial port
+static void SleepMs(unsigned ms) {
+	struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+}
+
+
+static speed_t BaudToSpeed(long baud) {
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	default: return 0;
+	}
+}
+
+
+static int OpenSerialPort(const char* port_name, speed_t baud) {
+	int port_fd = open(port_name, O_RDWR | O_NOCTTY);
+	if (port_fd < 0) return -1;
+
+	struct termios tty;
+	if (tcgetattr(port_fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, baud);
+		cfsetospeed(&tty, baud);
+		tty.c_cc[VMIN] = 0;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(port_fd, TCSANOW, &tty);
+	}
+	tcflush(port_fd, TCIOFLUSH);
+	return port_fd;
+}
+
+
+static int ReadBytes(int port_fd, uint8_t* dst, size_t len) {
+	size_t rx_cnt = 0;
+	while (rx_cnt < len) {
+		struct pollfd pfd = { port_fd, POLLIN, 0 };
+		if (poll(&pfd, 1, Reply_timeout_ms) <= 0) return -1;
+		ssize_t rx_len = read(port_fd, dst + rx_cnt, len - rx_cnt);
+		if (rx_len <= 0) return -1;
+		rx_cnt += rx_len;
+	}
+	return 0;
+}
+
+
+static uint32_t GetLE32(const uint8_t* src) {
+	return (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+
+static void PutLE32(uint8_t* dst, uint32_t value) {
+	dst[0] = value; dst[1] = value >> 8; dst[2] = value >> 16; dst[3] = value >> 24;
+}
+
+
+//5)Commands
+/*
+ * 1)Start sequence, a gap, the command and its payload, another gap - the bootloader ends a message on its second idle frame
+ * 2)Replies are 0xF0 0xF0, the command, then the payload. Anything before the header is skipped.
+ *
+ * */
+static int SendCommand(int port_fd, uint8_t cmd, const uint8_t* payload, size_t payload_len) {
+	const uint8_t start_seq[2] = { Msg_start_byte, Msg_start_byte };
+	uint8_t msg_buf[16];
+
+	//1)
+	msg_buf[0] = cmd;
+	if (payload_len) memcpy(&msg_buf[1], payload, payload_len);
+	if (write(port_fd, start_seq, 2) != 2) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+	if (write(port_fd, msg_buf, 1 + payload_len) != (ssize_t) (1 + payload_len)) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+	return 0;
+}
+
+
+static int ReadReply(int port_fd, uint8_t cmd, uint8_t* payload, size_t payload_len) {
+	uint8_t header[3] = {0};
+
+	//2)
+	while ((header[0] != Msg_start_byte) || (header[1] != Msg_start_byte) || (header[2] != cmd)) {
+		header[0] = header[1];
+		header[1] = header[2];
+		if (ReadBytes(port_fd, &header[2], 1) < 0) return -1;
+	}
+	return ReadBytes(port_fd, payload, payload_len);
+}
+
+
+//6)Hash benchmark on the device
+/*
+ * 1)0xb4 with the number of bytes: the reply is the time in us, the core clock and the digest
+ * 2)Cycles per byte from the time and the clock
+ * 3)Read the same block back (0xb7) and check the digest against ours
+ *
+ * Note: the time comes from TIM6 on the device (1 us steps), so short blocks are coarse. 4096 bytes is the most the bootloader takes.
+ *
+ * */
+static int Benchmark(int port_fd, uint16_t bench_len) {
+	uint8_t payload[8];
+	uint8_t bench_reply[8 + SHA256_digest_size];
+	uint8_t stream_len[4];
+	uint8_t flash_block[Bench_max_bytes];
+	uint8_t host_digest[SHA256_digest_size];
+	struct_SHA256_Ctx ctx;
+
+	//1)
+	payload[0] = bench_len;
+	payload[1] = bench_len >> 8;
+	if ((SendCommand(port_fd, 0xb4, payload, 2) < 0) || (ReadReply(port_fd, 0xb4, bench_reply, sizeof(bench_reply)) < 0)) {
+		fprintf(stderr, "No reply to 0xb4 - is the bootloader built with image_signed and in external controller mode?\n");
+		return 1;
+	}
+
+	//2)
+	uint32_t bench_time_us = GetLE32(&bench_reply[0]);
+	uint32_t core_clock = GetLE32(&bench_reply[4]);
+	printf("%u bytes in %u us at %u Hz", bench_len, bench_time_us, core_clock);
+	if (bench_time_us != 0) {
+		printf(": %.0f bytes/s, %.1f cycles/byte\n", bench_len * 1e6 / bench_time_us, (double) bench_time_us * (core_clock / 1e6) / bench_len);
+	} else {
+		printf("\n");
+	}
+
+	//3)
+	PutLE32(&payload[0], App_section_start);
+	PutLE32(&payload[4], bench_len);
+	if ((SendCommand(port_fd, 0xb7, payload, 8) < 0) || (ReadReply(port_fd, 0xb7, stream_len, 4) < 0)
+			|| (GetLE32(stream_len) != bench_len) || (ReadBytes(port_fd, flash_block, bench_len) < 0)) {
+		fprintf(stderr, "Readback (0xb7) failed - digest not checked\n");
+		return 1;
+	}
+	SHA256Init(&ctx);
+	SHA256Update(&ctx, flash_block, bench_len);
+	SHA256Final(&ctx, host_digest);
+	if (memcmp(host_digest, &bench_reply[8], SHA256_digest_size) != 0) {
+		fprintf(stderr, "DIGEST MISMATCH - the SHA-256 on the device is broken\n");
+		return 1;
+	}
+	printf("digest matches the host\n");
+	return 0;
+}
+
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+			"Usage: bootsign [-k key.bin] [-R] image.bin     writes the tag of the image into image.bin.sig\n"
+			"       bootsign -T                         reference test of the SHA-256 and the HMAC\n"
+			"       bootsign -b bytes [options] /dev/ttyUSB0   hash benchmark on the device (0xb4)\n"
+			"  -k key.bin    32 byte key (default: the development key)\n"
+			"  -R            big-endian image, tag over the byte swapped words (flasher -R)\n"
+			"  -p baud       UART1 baud rate (default 57600)\n"
+			"  -A byte       activation command (default 0xc3)\n"
+			"  -s            skip the activation (bootloader already in external controller mode)\n");
+}
+
+
+int main(int argc, char** argv) {
+	uint8_t key[HMAC_key_size];
+	long baud = 57600;
+	uint8_t activation_cmd = 0xc3;
+	int skip_activation = 0;
+	int byte_swap = 0;
+	long bench_len = 0;
+	int opt;
+
+	memcpy(key, Dev_key, HMAC_key_size);
+	while ((opt = getopt(argc, argv, "k:Tb:p:A:sR")) != -1) {
+		switch (opt) {
+		case 'k':
+		{
+			FILE* key_file = fopen(optarg, "rb");
+			size_t key_len = (key_file != NULL) ? fread(key, 1, HMAC_key_size, key_file) : 0;
+			if (key_file != NULL) fclose(key_file);
+			if (key_len != HMAC_key_size) {
+				fprintf(stderr, "Can't load the %d byte key from %s\n", HMAC_key_size, optarg);
+				return 1;
+			}
+			break;
+		}
+		case 'T': return (ReferenceTest() == 0) ? 0 : 1;
+		case 'b': bench_len = strtol(optarg, NULL, 0); break;
+		case 'p': baud = strtol(optarg, NULL, 10); break;
+		case 'A': activation_cmd = strtoul(optarg, NULL, 0); break;
+		case 's': skip_activation = 1; break;
+		case 'R': byte_swap = 1; break;
+		default: PrintUsage(); return 2;
+		}
+	}
+	if ((argc - optind) != 1) {
+		PrintUsage();
+		return 2;
+	}
+
+	if (bench_len == 0) return SignImage(argv[optind], key, byte_swap);
+
+	if ((bench_len < 0) || (bench_len > Bench_max_bytes) || (BaudToSpeed(baud) == 0)) {
+		fprintf(stderr, "Benchmark is 1 to %d bytes on a supported baud rate\n", Bench_max_bytes);
+		return 2;
+	}
+	int port_fd = OpenSerialPort(argv[optind], BaudToSpeed(baud));
+	if (port_fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	if (!skip_activation && (SendCommand(port_fd, activation_cmd, NULL, 0) < 0)) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		close(port_fd);
+		return 1;
+	}
+	int result = Benchmark(port_fd, bench_len);
+	close(port_fd);
+	return result;
+}
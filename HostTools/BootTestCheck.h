@@ -0,0 +1,43 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Header version: 1.0
+ *  File: BootTestCheck.h
+ *  Modified from: N/A
+ *  Change history: N/A
+ *
+ * Check and report of the self-tests (-T) of the host tools: one line per case, the name of the case, then PASS or FAIL.
+ * Every tool with a self-test includes this, so the reports read the same and every check adds to the fail count the same way.
+ */
+
+#ifndef INC_BOOTTESTCHECK_H_
+#define INC_BOOTTESTCHECK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define Check_name_width			32
+#define Check_hex_max				128												//64 bytes - the longest reference vector of the tests
+
+//1)One case: returns 1 on a fail, so the fails of a test can be summed up
+static inline int CheckCase(const char* test_name, int pass) {
+	printf("%-*s %s\n", Check_name_width, test_name, pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
+
+
+//2)Bytes against the hex string of a reference vector - on a fail, both are printed
+static inline int CheckBytes(const char* test_name, const uint8_t* result, size_t len, const char* expected_hex) {
+	char result_hex[Check_hex_max + 1] = "";
+	for (size_t i = 0; (i < len) && ((2 * i) < Check_hex_max); i++) {
+		snprintf(&result_hex[2 * i], 3, "%02x", result[i]);
+	}
+	int fail = CheckCase(test_name, strcmp(result_hex, expected_hex) == 0);
+	if (fail) printf("  got      %s\n  expected %s\n", result_hex, expected_hex);
+	return fail;
+}
+
+#endif /* INC_BOOTTESTCHECK_H_ */
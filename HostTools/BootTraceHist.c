@@ -0,0 +1,303 @@
+/*
+ *  Created on: 19 Oct 2026
+ *  Author: BalazsFarkas
+ *  Project: STM32_Bootloader
+ *  Processor: Linux host
+ *  Program version: 1.0
+ *  File: BootTraceHist.c
+ *  Modified from: N/A
+ *  Change history:
+ *
+ * Host side tool for the trace ring of the bootloader (bootloader built with "boot_trace").
+ *
+ * v.1.0
+ * Asks the bootloader for its trace ring (0xba) on UART1 - or reads a saved dump - and pairs the enter and exit events of every trace point.
+ * Prints the count, min/avg/max and a log2 histogram of the latencies per trace point, named using BootTracePoints.def.
+ * The dump is [write index LE16][number of events LE16][Trace_ring_size events LE32], an event is TIM6 (1 us) in bits 15:0, trace point in bits 22:16, exit in bit 31.
+ *
+ * Note: the bootloader must already be in external controller mode (0xc3). The ring is emptied by every dump.
+ * Note: a latency is the time between an enter and its exit, IRQs of higher priority included.
+ *
+ * Build: gcc -O2 -Wall -o boottracehist BootTraceHist.c
+ * Usage: boottracehist [-b baud] [-o dump.bin] /dev/ttyUSB0
+ *        boottracehist -f dump.bin
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+//LOCAL CONSTANT
+#define Msg_start_byte			0xF0
+#define Msg_gap_ms				10												//gap that closes a message on the bootloader side
+#define Reply_timeout_ms		2000
+#define Trace_ring_size			128												//same as in BootTrace.h
+#define Trace_dump_size			(4 + (4 * Trace_ring_size))
+#define Hist_bucket_cnt			17												//0 us, then 1, 2-3, 4-7 ... 32768-65535 us
+
+#define BOOT_TRACE_POINT(point, name) name,
+static const char* const Trace_point_names[] = {
+#include "../BootTracePoints.def"
+};
+#undef BOOT_TRACE_POINT
+
+static const unsigned Trace_point_count = sizeof(Trace_point_names) / sizeof(Trace_point_names[0]);
+
+//latencies of one trace point
+typedef struct {
+	int enter_pending;
+	uint16_t enter_time;
+	unsigned long count;
+	unsigned long total_us;
+	unsigned min_us;
+	unsigned max_us;
+	unsigned long hist[Hist_bucket_cnt];
+} Trace_Stats;
+
+
+//1)Serial port
+static void SleepMs(unsigned ms) {
+	struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+}
+
+
+static speed_t BaudToSpeed(long baud) {
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	default: return 0;
+	}
+}
+
+
+static int OpenSerialPort(const char* port_name, speed_t baud) {
+	int port_fd = open(port_name, O_RDWR | O_NOCTTY);
+	if (port_fd < 0) return -1;
+
+	struct termios tty;
+	if (tcgetattr(port_fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, baud);
+		cfsetospeed(&tty, baud);
+		tty.c_cc[VMIN] = 0;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(port_fd, TCSANOW, &tty);
+	}
+	tcflush(port_fd, TCIOFLUSH);
+	return port_fd;
+}
+
+
+static int ReadBytes(int port_fd, uint8_t* dst, size_t len) {
+	size_t rx_cnt = 0;
+	while (rx_cnt < len) {
+		struct pollfd pfd = { port_fd, POLLIN, 0 };
+		if (poll(&pfd, 1, Reply_timeout_ms) <= 0) return -1;
+		ssize_t rx_len = read(port_fd, dst + rx_cnt, len - rx_cnt);
+		if (rx_len <= 0) return -1;
+		rx_cnt += rx_len;
+	}
+	return 0;
+}
+
+
+//2)Ask the bootloader for the ring
+/*
+ * 1)Send the start sequence, a gap, the command, another gap - the bootloader ends a message on its second idle frame
+ * 2)Skip everything until the reply header (0xF0 0xF0 0xba), then read the length (LE32) and the ring
+ *
+ * */
+static int RequestDump(int port_fd, uint8_t* dump) {
+	const uint8_t start_seq[2] = { Msg_start_byte, Msg_start_byte };
+	const uint8_t cmd = 0xba;
+	uint8_t header[3] = {0};
+	uint8_t len_bytes[4];
+
+	//1)
+	if (write(port_fd, start_seq, 2) != 2) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+	if (write(port_fd, &cmd, 1) != 1) return -1;
+	tcdrain(port_fd);
+	SleepMs(Msg_gap_ms);
+
+	//2)
+	while ((header[0] != Msg_start_byte) || (header[1] != Msg_start_byte) || (header[2] != cmd)) {
+		header[0] = header[1];
+		header[1] = header[2];
+		if (ReadBytes(port_fd, &header[2], 1) < 0) return -1;
+	}
+	if (ReadBytes(port_fd, len_bytes, 4) < 0) return -1;
+	uint32_t dump_len = len_bytes[0] | (len_bytes[1] << 8) | (len_bytes[2] << 16) | ((uint32_t) len_bytes[3] << 24);
+	if (dump_len != Trace_dump_size) {
+		fprintf(stderr, "Dump of %u bytes, expected %u - is the ring size the same as in BootTrace.h?\n", dump_len, Trace_dump_size);
+		return -1;
+	}
+	return ReadBytes(port_fd, dump, Trace_dump_size);
+}
+
+
+//3)Pair the events and fill the histograms
+/*
+ * 1)Find the oldest event: at the write index if the ring is full, at 0 otherwise
+ * 2)An enter is kept until its exit comes. TIM6 is 16 bits, so the latency is taken modulo 65536 us.
+ * 3)An exit without an enter (its enter was overwritten) and an enter followed by another enter (lost exit) are dropped
+ *
+ * */
+static unsigned long BuildHistograms(const uint8_t* dump, Trace_Stats* stats) {
+	uint16_t write_idx = dump[0] | (dump[1] << 8);
+	uint16_t event_cnt = dump[2] | (dump[3] << 8);
+	unsigned long dropped = 0;
+
+	if ((write_idx >= Trace_ring_size) || (event_cnt > Trace_ring_size)) return 0;
+
+	//1)
+	uint16_t read_idx = (event_cnt == Trace_ring_size) ? write_idx : 0;
+
+	for (uint16_t i = 0; i < event_cnt; i++) {
+		const uint8_t* e = &dump[4 + (4 * read_idx)];
+		uint32_t event = e[0] | (e[1] << 8) | (e[2] << 16) | ((uint32_t) e[3] << 24);
+		uint16_t time_stamp = event & 0xFFFF;
+		uint8_t point = (event >> 16) & 0x7F;
+		int is_exit = (event >> 31) & 1;
+		read_idx = (read_idx + 1) % Trace_ring_size;
+
+		if (point >= Trace_point_count) {
+			dropped++;
+			continue;
+		}
+		Trace_Stats* s = &stats[point];
+
+		//2)
+		if (!is_exit) {
+			if (s->enter_pending) dropped++;									//3)
+			s->enter_pending = 1;
+			s->enter_time = time_stamp;
+		} else if (s->enter_pending) {
+			unsigned latency = (uint16_t) (time_stamp - s->enter_time);
+			unsigned bucket = 0;
+			while ((bucket < (Hist_bucket_cnt - 1)) && ((1u << bucket) <= latency)) bucket++;
+			s->enter_pending = 0;
+			s->hist[bucket]++;
+			s->total_us += latency;
+			if ((s->count == 0) || (latency < s->min_us)) s->min_us = latency;
+			if (latency > s->max_us) s->max_us = latency;
+			s->count++;
+		} else {
+			dropped++;															//3)
+		}
+	}
+	return dropped;
+}
+
+
+//4)Print
+static void PrintHistograms(const Trace_Stats* stats) {
+	for (unsigned point = 0; point < Trace_point_count; point++) {
+		const Trace_Stats* s = &stats[point];
+		if (s->count == 0) continue;
+
+		unsigned long bucket_max = 0;
+		for (unsigned b = 0; b < Hist_bucket_cnt; b++) {
+			if (s->hist[b] > bucket_max) bucket_max = s->hist[b];
+		}
+
+		printf("%s: %lu calls, min %u us, avg %lu us, max %u us\n", Trace_point_names[point], s->count, s->min_us, s->total_us / s->count, s->max_us);
+		for (unsigned b = 0; b < Hist_bucket_cnt; b++) {
+			if (s->hist[b] == 0) continue;
+			unsigned low = (b == 0) ? 0 : (1u << (b - 1));
+			unsigned high = (b == 0) ? 0 : ((1u << b) - 1);
+			int bar_len = (int) ((s->hist[b] * 40 + bucket_max - 1) / bucket_max);
+			printf("  %5u-%-5u us |%.*s %lu\n", low, high, bar_len, "########################################", s->hist[b]);
+		}
+	}
+}
+
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+			"Usage: boottracehist [-b baud] [-o dump.bin] /dev/ttyUSB0\n"
+			"       boottracehist -f dump.bin\n"
+			"  -b baud       UART1 baud rate (default 57600)\n"
+			"  -o file       save the raw dump as well\n"
+			"  -f file       read a saved dump instead of asking the bootloader\n");
+}
+
+
+int main(int argc, char** argv) {
+	long baud = 57600;
+	const char* save_name = NULL;
+	const char* load_name = NULL;
+	uint8_t dump[Trace_dump_size];
+	Trace_Stats stats[Trace_point_count];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:o:f:")) != -1) {
+		switch (opt) {
+		case 'b': baud = strtol(optarg, NULL, 10); break;
+		case 'o': save_name = optarg; break;
+		case 'f': load_name = optarg; break;
+		default: PrintUsage(); return 2;
+		}
+	}
+
+	if (load_name != NULL) {
+		FILE* dump_file = fopen(load_name, "rb");
+		if ((dump_file == NULL) || (fread(dump, 1, Trace_dump_size, dump_file) != Trace_dump_size)) {
+			fprintf(stderr, "Can't read a dump from %s\n", load_name);
+			return 1;
+		}
+		fclose(dump_file);
+	} else {
+		if ((argc - optind) < 1) {
+			PrintUsage();
+			return 2;
+		}
+		if (BaudToSpeed(baud) == 0) {
+			fprintf(stderr, "Unsupported baud rate\n");
+			return 2;
+		}
+		int port_fd = OpenSerialPort(argv[optind], BaudToSpeed(baud));
+		if (port_fd < 0) {
+			fprintf(stderr, "Can't open %s: %s\n", argv[optind], strerror(errno));
+			return 1;
+		}
+		if (RequestDump(port_fd, dump) < 0) {
+			fprintf(stderr, "No trace dump - is the bootloader built with boot_trace and in external controller mode?\n");
+			close(port_fd);
+			return 1;
+		}
+		close(port_fd);
+	}
+
+	if (save_name != NULL) {
+		FILE* dump_file = fopen(save_name, "wb");
+		if ((dump_file == NULL) || (fwrite(dump, 1, Trace_dump_size, dump_file) != Trace_dump_size)) {
+			fprintf(stderr, "Can't save the dump to %s\n", save_name);
+			return 1;
+		}
+		fclose(dump_file);
+	}
+
+	memset(stats, 0, sizeof(stats));
+	unsigned long dropped = BuildHistograms(dump, stats);
+	PrintHistograms(stats);
+	if (dropped != 0) fprintf(stderr, "%lu events without a pair (overwritten by the ring or cut by the dump)\n", dropped);
+	return 0;
+}
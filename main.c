@@ -4,7 +4,7 @@
  *  Project: STM32_Bootloader
  *  Processor: STM32L053R8
  *  Compiler: ARM-GCC (STM32 IDE)
- *  Program version: 1.0
+ *  Program version: 1.18
  *  File: main.c
  *  Hardware description/pin distribution: UART Tx on Pa9, Rx on PA10
  *  Modified from: N/A
@@ -26,13 +26,49 @@
   * This is a rework of the previously written UART driver.
   *
   * v1.0: Bootloader for STM32L0xx.
-  * Uses UART1 Rx to receive data from master device. (Not Tx included on the STM32 side!)
+  * Uses UART1 Rx to receive data from master device. UART1 Tx only sends short replies to status commands.
   * Uses DMA for machine code reception.
   * Uses half-page FLASH burst to update app.
   * If for 5 seconds, not external controller request arrives, bootloader transitions to app.
   * App is to be stored at address 0x8008000 - look for "App_Section_Start_Addr" int eh code to modify it.
   * App and master controller are not provided.
   *
+  * v1.1: printf is funnelled into a ring buffer that is drained by DMA on UART2. Writers never block, overflow is counted in Log_dropped_bytes.
+  *
+  * v1.2: Optional Stop mode during the boot window (boot_wait_stop_mode). USART1 wakes the mcu on the start bit, LPTIM1 counts the seconds.
+  *
+  * v1.3: Clock profiles. The bootloader idles on MSI and only runs the PLL while programming.
+  *
+  * v1.4: A/B app slots with rollback. Resumable updates: the update progress is kept in data EEPROM, a lost link only pauses the update.
+  *
+  * v1.5: Addressed frames for several nodes on one RS-485 bus (uart1_rs485 for the driver enable). Activation (0xc3) can target one node, a group or all.
+  *
+  * v1.6: UART1 baud rate can be raised at runtime (0xbd, up to 1 Mbaud). A rate that does not work falls back to the old one after a timeout.
+  *
+  * v1.7: Optional auto baud rate detection in the boot window (uart1_auto_baud). The bootloader runs on whatever rate the activating host uses.
+  *
+  * v1.8: Optional RTS/CTS flow control on UART1 (uart1_flow_control). The host is held while the FLASH is busy, so the image can be streamed without page gaps.
+  *
+  * v1.9: Optional SPI1 slave transport instead of the UART1 (spi1_transport). Same commands, NSS ends a message, PA8 tells the master when to clock.
+  *
+  * v1.10: Line errors (overrun, framing, noise, parity) on UART1 are counted and sent with the session report. The image is not written past a line error.
+  *
+  * v1.11: Session statistics (bytes, pages, FLASH erase and program times, buffer slack, line errors, duration), polled with 0xb9. Replaces the 8-bit page counter.
+  *
+  * v1.12: Boot config record in data EEPROM (0xbc): boot window, activation command, UART1 baud rate, app base and fast boot policy. Compiled defaults without a record.
+  *
+  * v1.13: Optional signed images (image_signed). Pages are hashed (HMAC-SHA256) on their way into the FLASH, the new slot is only switched to after a matching tag (0xbe).
+  *
+  * v1.14: Optional encrypted images (image_encrypted). Pages are decrypted (AES-128 CTR) in the Rx buffer before they are written, the nonce comes with 0xb3.
+  *
+  * v1.15: Per session byte swap for big-endian images (0xb1). Whole pages are swapped with REV, then written by half-pages like any other image.
+  *
+  * v1.16: Optional RAM update path (ram_update_path). The Rx IRQs, the vector table and the NVM routines run from RAM, so the Rx IRQs are served while the FLASH is busy. IRQ latency probe on TIM22 (irq_latency_probe, 0xb0).
+  *
+  * v1.17: Device traits (BootDeviceTraits_STM32L0xx.h). Page size, memory layout and the Rx buffer come from the part the build is for. Category 5 parts (L07x/L08x) get a 1 kB half on the UART1.
+  *
+  * v1.18: Optional startup without the HAL (bare_metal_startup). No SysTick (HAL_InitTick is overridden), the LED and the UART2 of the log are set up on the registers.
+  *
   ******************************************************************************
   */
 /* USER CODE END Header */
@@ -47,6 +83,10 @@
 #include "BootAppManager.h"
 #include "BootExternalController.h"
 #include "BootClockDriver_STM32L0x3.h"
+#include "BootLogDriver_STM32L0x3.h"
+#include "BootLogTokens.h"
+#include "BootCRCDriver_STM32L0x3.h"
+#include "BootLink.h"
 
 /* USER CODE END Includes */
 
@@ -77,6 +117,11 @@ void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
 static void MX_USART2_UART_Init(void);
 /* USER CODE BEGIN PFP */
+#ifdef bare_metal_startup
+static void BootGPIOInit(void);
+static void MX_GPIO_Init(void) __attribute__((unused));								//generated, but not called in the bare-metal build
+static void MX_USART2_UART_Init(void) __attribute__((unused));
+#endif
 
 /* USER CODE END PFP */
 
@@ -85,23 +130,18 @@ static void MX_USART2_UART_Init(void);
 
 
 //printf transition
+//Note: printf only copies into the log ring buffer. The DMA on UART2 Tx sends it out in the background.
 int _write(int file, char *ptr, int len)
 {
-	int DataIdx;
-	for (DataIdx = 0; DataIdx < len; DataIdx++) {
-		HAL_UART_Transmit(&huart2, (uint8_t *)ptr++, 1, 100);
-	}
-	return len;
+	return BootLogWrite((uint8_t *)ptr, len);
 }
 
-uint32_t Rx_Message_buf [64];															//buffer is 64 times 4 bytes / 1 word
+uint32_t Rx_Message_buf [Dev_Rx_buf_words];												//two halves of Dev_Rx_half_pages pages - 64 words on the L053
 
 uint8_t* Rx_Message_buf_ptr;
 
 uint16_t DMA_transfer_width_UART1;
 
-uint8_t page_counter;
-
 uint8_t seconds_counter;
 
 enum_Yes_No_Selector UART1_Message_Received;
@@ -115,6 +155,32 @@ enum_Yes_No_Selector UART1_DMA_active;													//indicator for DMA activity
 																						//Note: UART messaging must not occur while DMA is active!!!
 
 uint32_t flash_page_addr;
+uint16_t Last_Session_Page_Cnt;														//pages received in the last programming session
+enum_Yes_No_Selector UART1_Reply_Enabled = Yes;											//no replies on frames for more than one node
+enum_Yes_No_Selector Update_Bystander = No;											//an image for other nodes is on the bus
+enum_Yes_No_Selector Update_Resumable;													//the update in progress is tracked in data EEPROM (0xb6)
+enum_Yes_No_Selector Update_Byte_Swap = No;												//the words of the image are big-endian - every page is swapped before it is written (0xb1)
+
+uint32_t Log_dropped_bytes;
+
+enum_Yes_No_Selector UART1_Stop_Mode_Wait;												//we only use Stop mode in the boot window
+
+uint32_t UART1_baud_rate = 57600;														//UART1 baud rate - BRR is calculated from this
+uint32_t UART1_Fallback_baud_rate = 57600;												//UART1 baud rate before the last change (0xbd)
+enum_Yes_No_Selector UART1_Baud_Probation = No;											//a new baud rate is waiting for its first frame
+struct_Session_Stats Session_Stats;														//statistics of the current programming session - line errors included
+struct_Session_Stats Last_Session_Stats;												//the same for the last session - sent with the session report and 0xb9
+enum_Yes_No_Selector UART1_Line_Error_Hit = No;											//nothing is written into the FLASH after a line error
+enum_Yes_No_Selector UART1_Auto_Baud = No;												//the boot window locks onto the baud rate of the host
+
+enum_Clock_Profile Current_Clock_Profile;
+
+struct_Boot_Config Boot_Config;															//boot config in use - from data EEPROM or the compiled defaults
+uint32_t App_Slot_Start_Addr[2];														//slot A at the app base, slot B halfway to the end of the FLASH
+uint32_t App_Slot_Size;
+#ifdef irq_latency_probe
+struct_IRQ_Latency IRQ_Latency;															//IRQ latency seen by TIM22 during the last programming session (0xb0)
+#endif
 
 /* USER CODE END 0 */
 
@@ -125,7 +191,7 @@ uint32_t flash_page_addr;
 int main(void)
 {
   /* USER CODE BEGIN 1 */
-
+																						//Note: with bare_metal_startup, the HAL_Init below does not start SysTick - see HAL_InitTick in USER CODE 4
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -141,39 +207,91 @@ int main(void)
 //  SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+#ifdef ram_update_path
+  BootVectorTableRAM();																	//vector table in RAM - before any of our IRQs is enabled
+#endif
   SysClockConfig();
   TIM6Config();
+  BootCRCInit();																		//CRC unit - boot config record, update progress and image checks
+  enum_Yes_No_Selector Boot_Config_Stored = LoadBootConfig();							//boot window, activation, baud rate and slots - before anything uses them
+  UART1_baud_rate = Boot_Config.baud_rate;
+  UART1_Fallback_baud_rate = Boot_Config.baud_rate;
+#ifdef boot_wait_stop_mode
+  BootLPTIM1_INT();																		//LPTIM1 init - counts the boot window in Stop mode
+  BootLPTIM1IRQPriorEnable();															//LPTIM1 IRQ
+#else
   BootTIM2_INT();																		//TIM2 init
   BootTIM2IRQPriorEnable();																//TIM2 IRQ
-  UART1Config();																		//UART1 init
-  UART1IRQPriorEnable();																//UART1 IRQ - enable is done at a different place
+#endif
+  BootLinkConfig();																		//UART1 (or SPI1) init
+  BootLinkIRQPriorEnable();																//UART1 (or SPI1 NSS) IRQ - enable is done at a different place
   BootDMAInit();																		//DMA init
   BootDMAIRQPriorEnable();																//DMA IRQ - enable is done at a different place
+#ifdef irq_latency_probe
+  BootTIM22IRQPriorEnable();															//TIM22 IRQ - enable is done when programming starts
+#endif
 
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
+  /* USER CODE BEGIN 2 */
+																						//Note: MX_GPIO_Init and MX_USART2_UART_Init are set to "Do Not Generate Function Call" (Project Manager - Advanced Settings), they are called here
+#ifdef bare_metal_startup
+  BootGPIOInit();																		//LED off - what MX_GPIO_Init did that we use
+  BootLogUART2Config();																	//UART2 Tx for the log
+#else
   MX_GPIO_Init();
   MX_USART2_UART_Init();
-  /* USER CODE BEGIN 2 */
+#endif
+  BootLogDMAIRQPriorEnable();															//Log DMA IRQ
+  BootLogInit();																		//printf to UART2 through DMA - needs UART2 and DMA init done
 
-  flash_page_addr = App_Section_Start_Addr;												//we define the base address where the app is supposed to be
+  flash_page_addr = App_Slot_Start_Addr[GetUpdateSlot()];								//we define the base address where the app is supposed to be - the slot we are not running from
   	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  							//mind, the app's machine code has all the placing information. We need to respect it, otherwise we won't find and run the app.
 
   UART1_Message_Received = No;															//we reset the message received flag
   UART1_Message_Started = No;															//we reset the message started flag
   Machine_Code_Page_Received = None;
   UART1_DMA_active = No;
-  page_counter = 0;
   Rx_Message_buf_ptr = Rx_Message_buf;													//we place the buffer loading pointer to the buffer
-  DMA_transfer_width_UART1 = 256;														//DMA transfer width is the entirety of the Rx buffer
-  memset(Rx_Message_buf, 0, 64);														//we erase the buffer
+  DMA_transfer_width_UART1 = Dev_Rx_buf_size;											//DMA transfer width is the entirety of the Rx buffer
+  memset(Rx_Message_buf, 0, sizeof(Rx_Message_buf));									//we erase the buffer
 
   enum_Yes_No_Selector External_Controller_Mode = No;									//this is a local variable that should be wiped upon reset
 
   seconds_counter = 0;
+  UART1_Stop_Mode_Wait = Yes;
+  UART1_Auto_Baud = Yes;
+  Update_Resumable = No;
+
+  BootLogInfo(LogTok_Bootloader_running);
+  if (Boot_Config_Stored == No) {
+	  BootLogInfo(LogTok_Boot_config_default);
+  } else {
+	  //do nothing
+  }
+  BootLogInfo(LogTok_Boot_config, Boot_Config.boot_window_sec, Boot_Config.activation_cmd, Boot_Config.baud_rate, Boot_Config.app_base_addr);
+
+  if (FastBootAllowed() == Yes) {														//power-on reset with a confirmed app: we don't wait for the external controller
+	  BootLogInfo(LogTok_Fast_boot);
+	  BootLogInfo(LogTok_Deinit_drivers);
+	  BootLinkDeinit();
+#ifdef boot_wait_stop_mode
+	  BootLPTIM1_DEINT();
+#else
+	  BootTIM2_DEINT();
+#endif
+	  BootLogInfo(LogTok_Jumping_to_app);
+	  GoToApp();																		//FastBootAllowed has already checked the app, so we don't come back
+  } else {
+	  //do nothing
+  }
 
-  printf("Bootloader running...\r\n");
+#ifdef uart1_auto_baud
+  SysClockProfile(Clock_Profile_HSI16);												//the auto baud rate detection has only 5 bit times to correct the BRR - MSI is too slow for that on high rates
+#else
+  SysClockProfile(Clock_Profile_MSI);													//we idle on MSI until the external controller asks for an update
+#endif
 
   /* USER CODE END 2 */
 
@@ -183,18 +301,29 @@ int main(void)
   {
 
 
-	//The following segment ensures that we only switch to external control if a certain byte (0xc3) is received on the UART1 bus.
-	//If there is no byte received, a TIM2 IRQ will deinitialize the bootloader and start the app after a certain number of cycles (set in the IRQ header)
+	//The following segment ensures that we only switch to external control if a certain byte (0xc3, or the one in the boot config) is received on the UART1 bus.
+	//If there is no byte received, a TIM2 IRQ will deinitialize the bootloader and start the app after a certain number of cycles (the boot window of the boot config)
 
 	if (External_Controller_Mode == No) {												//if we are not in external controller mode
 
-		UART1RxMessage();																//we listen to the UART bus for the external control byte
+		BootLinkRxMessage();															//we listen to the UART bus for the external control byte
 
-		if (Rx_Message_buf[0] == 0xc3) {
+		uint8_t* command_ptr = UART1CommandForThisNode();								//plain or addressed frame - NULL if it was for another node
 
-		  printf("External controller activated...\r\n");
+		if ((command_ptr != NULL) && (*command_ptr == Boot_Config.activation_cmd)) {
+
+		  BootLogInfo(LogTok_External_controller_active);
 		  External_Controller_Mode = Yes;												//this flag will be reset upon reboot only
+		  UART1_Stop_Mode_Wait = No;													//from here, we stay on full clock
+		  UART1_Auto_Baud = No;														//we keep the rate the activation came in on
+#ifdef uart1_auto_baud
+		  SysClockProfile(Clock_Profile_MSI);											//we idle on MSI from here - the UART1 runs on HSI16, so the rate is kept
+#endif
+#ifdef boot_wait_stop_mode
+		  BootLPTIM1_DEINT();															//we completely shut off the LPTIM1 timer and its IRQ
+#else
 		  BootTIM2_DEINT();																//we completely shut off the TIM2 timer and its IRQ
+#endif
 		  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  	  		//Note: TIM2 IRQ governs the automatic transition to the app if there is no command byte received
 
 		} else {
@@ -342,6 +471,35 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
+#ifdef bare_metal_startup
+//GPIO setup without the HAL
+static void BootGPIOInit(void) {
+	/*
+	 * The part of MX_GPIO_Init the bootloader keeps: LD2 (PA5) as a push-pull output, driven LOW.
+	 *
+	 * Note: the user button (B1, PC13) is left out. The bootloader never reads it, and its EXTI line would share the EXTI4_15 IRQ with the NSS of the SPI1 (spi1_transport).
+	 * Note: GPIOC and GPIOH are not clocked either - nothing is on them.
+	 * */
+
+	RCC->IOPENR |= (1<<0);																//PORTA
+	GPIOA->BSRR |= (1<<21);																//PA5 LOW before it becomes an output
+	GPIOA->MODER &= ~(1<<11);															//PA5 is a GPIO output
+																						//OTYPER, OSPEEDR and PUPDR stay at their reset values: push/pull, low speed, no pull resistors
+}
+
+//Tick setup without SysTick
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority) {
+	/*
+	 * Overrides the weak HAL_InitTick of the HAL. The generated HAL_Init is left in main - it is outside the USER CODE - and is called as before, only SysTick is not started.
+	 * What is left of HAL_Init is the FLASH prefetch setup and HAL_MspInit (SYSCFG and PWR clocks), a handful of register writes.
+	 *
+	 * Note: nothing in the bootloader needs a tick (delays are on TIM6), so HAL_GetTick stays at 0. HAL_Delay must not be called.
+	 * */
+
+	(void) TickPriority;
+	return HAL_OK;
+}
+#endif
 
 /* USER CODE END 4 */
 
@@ -51,11 +51,34 @@ extern "C" {
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
 
+//#define boot_wait_stop_mode														//the boot window is spent in Stop mode, USART1 start bit and LPTIM1 wake the mcu up
+//#define uart1_auto_baud															//UART1 locks onto the baud rate of the host on the first 0xF0 of every message in the boot window
+//#define uart1_flow_control														//RTS/CTS on UART1: CTS on PA11, RTS on PA12 - the host is held while the FLASH is busy. Not with uart1_rs485.
+//#define image_signed															//pages are hashed (HMAC-SHA256) on their way into the FLASH, the slot is only switched after a matching tag (0xbe). See BootImageAuth.c.
+//#define image_encrypted															//images come encrypted (AES-128 CTR), every page is decrypted in the Rx buffer before it is written. Nonce with 0xb3. See BootImageCrypt.c.
+//#define boot_trace																//TIM6 time stamped enter/exit events of the hot paths in a RAM ring, dumped with 0xba (see BootTrace.h)
+//#define spi1_transport															//SPI1 slave instead of the UART1: NSS PA15, SCK PB3, MISO PB4, MOSI PB5, ready line PA8. Not with the uart1_ options or boot_wait_stop_mode.
+//#define uart1_rs485																//UART1 drives an RS-485 transceiver: driver enable on PA12 (USART1_DE)
+//#define ram_update_path															//the UART1/SPI1 Rx IRQs, the vector table and the NVM routines run from RAM: the Rx IRQs are served while the FLASH is busy. See BootIRQ_Control.c.
+//#define irq_latency_probe														//TIM22 IRQ measures the IRQ latency during programming, read with 0xb0
+//#define bare_metal_startup														//no SysTick, MX_GPIO_Init or MX_USART2_UART_Init: the LED and the UART2 of the log are set up on the registers
+
+#include "BootDeviceTraits_STM32L0xx.h"												//after the flags: the Rx buffer size depends on the transport
+
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
 /* USER CODE BEGIN EM */
 
+#ifdef ram_update_path
+#define __RAM_UPDATE_PATH			__attribute__((section(".RamFunc")))			//must keep on running while the FLASH is busy
+#else
+#define __RAM_UPDATE_PATH
+#endif
+
+#define IRQ_latency_buckets			14												//0 us, 1 us, 2-3 us, 4-7 us ... 4096 us and above
+
+
 typedef enum {
 	No,
 	Yes
@@ -68,6 +91,48 @@ typedef enum {
 	Second
 } enum_First_Second_Selector;
 
+
+typedef struct {
+	uint16_t overrun;
+	uint16_t framing;
+	uint16_t noise;
+	uint16_t parity;
+} struct_Line_Error_Counter;
+
+
+typedef struct {
+	uint32_t bytes_received;
+	uint32_t session_time_us;
+	uint32_t erase_time_total_us;
+	uint32_t program_time_total_us;												//both half-page writes of every page
+	uint16_t pages_received;
+	uint16_t pages_written;
+	uint16_t pages_skipped;														//received but not written: bystander, past the end of the slot or after a line error
+	uint16_t erase_time_max_us;
+	uint16_t program_time_max_us;
+	uint16_t min_slack_bytes;													//smallest free part of the ping-pong buffer after a page was written
+	struct_Line_Error_Counter line_errors;
+} struct_Session_Stats;
+
+
+typedef struct {
+	uint8_t boot_window_sec;
+	uint8_t activation_cmd;														//command that activates the external controller in the boot window (0xc3)
+	uint8_t fast_boot_policy;
+	uint8_t reserved;
+	uint32_t baud_rate;															//UART1 baud rate after reset
+	uint32_t app_base_addr;														//start of slot A - slot B starts halfway to the end of the FLASH
+} struct_Boot_Config;
+
+
+typedef struct {
+	uint32_t samples;
+	uint16_t max_us;
+	uint8_t update_path_in_ram;												//1 if the build has the RAM update path
+	uint8_t reserved;
+	uint16_t histogram[IRQ_latency_buckets];									//bucket n counts the latencies that are n bits long
+} struct_IRQ_Latency;
+
 /* USER CODE END EM */
 
 /* Exported functions prototypes ---------------------------------------------*/